@@ -26,6 +26,12 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -246,6 +252,24 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The file is memory-mapped read-only and the node descriptors point into
+   * the mapping instead of being copied, so the descriptor data is shared
+   * through the page cache by every process that loads the same file.
+   * Only valid for binary descriptors stored in CV_8U cv::Mat (FORB).
+   * @param filename
+   * @return true iff the file was loaded
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file (see loadFromBinaryFile)
+   * @param filename
+   * @return true iff the file was written
+   */
+  bool saveToBinaryFile(const std::string &filename) const;
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -293,6 +317,42 @@ protected:
   /// Pointer to descriptor
   typedef const TDescriptor *pDescriptor;
 
+  /// Node of the packed tree used by transform(). Nodes are stored in
+  /// breadth-first order, so the children of a node occupy adjacent slots
+  /// and their descriptors are contiguous in memory
+  struct FlatNode
+  {
+    /// Slot of the first child
+    uint32_t first_child;
+    /// Number of children (0 if the node is a word)
+    uint32_t n_children;
+    /// Id of the node in m_nodes
+    uint32_t node_id;
+    /// Word id if the node is a word
+    uint32_t word_id;
+  };
+
+  /// Header of the binary vocabulary file. It is followed by the packed tree
+  /// (descriptors, FlatNodes and weights in slot order, root excluded) at the
+  /// given offsets, so that the tree can be used in place
+  struct BinaryHeader
+  {
+    /// "DBOW2BIN"
+    char magic[8];
+    /// Format version
+    uint32_t version;
+    /// Branching factor, depth levels, scoring and weighting types
+    int32_t k, L, scoring, weighting;
+    /// Bytes per descriptor
+    uint32_t desc_len;
+    /// Number of nodes, root excluded
+    uint64_t nodes;
+    /// Number of children of the root (they take the first slots)
+    uint32_t root_children;
+    /// Offsets from the start of the file of each array
+    uint64_t descriptors_offset, nodes_offset, weights_offset;
+  };
+
   /// Tree node
   struct Node 
   {
@@ -401,6 +461,24 @@ protected:
    * @param features
    */
   void setNodeWeights(const vector<vector<TDescriptor> > &features);
+
+  /**
+   * Unmaps the binary file the descriptors point to, if any, and drops the
+   * packed tree. The nodes must have been cleared before
+   */
+  void releaseMapping();
+
+  /**
+   * Builds the packed tree used by transform() from m_nodes. Only binary
+   * descriptors stored in continuous CV_8U cv::Mat of F::L bytes (a multiple
+   * of 8) can be packed; otherwise transform() walks m_nodes
+   */
+  void buildFlatTree();
+
+  /**
+   * Hamming distance between two packed binary descriptors of F::L bytes
+   */
+  static inline int flatDistance(const unsigned char *a, const unsigned char *b);
   
 protected:
 
@@ -425,6 +503,29 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Binary file mapped by loadFromBinaryFile (NULL if none)
+  void *m_mapped_data;
+
+  /// Size of the mapping
+  size_t m_mapped_size;
+
+  /// Descriptors of the packed tree, F::L bytes per slot (NULL if not built).
+  /// They live in m_flat_descriptor_storage or in the mapped binary file
+  const unsigned char *m_flat_descriptors;
+
+  /// Nodes of the packed tree, one per slot
+  const FlatNode *m_flat_nodes;
+
+  /// Number of slots of the packed tree
+  uint32_t m_flat_size;
+
+  /// Number of children of the root, which take slots [0, m_flat_root_children)
+  uint32_t m_flat_root_children;
+
+  /// Storage of the packed tree when it is not mapped
+  cv::Mat m_flat_descriptor_storage;
+  std::vector<FlatNode> m_flat_node_storage;
   
 };
 
@@ -434,7 +535,9 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
   : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
+  m_scoring_object(NULL), m_mapped_data(NULL), m_mapped_size(0),
+  m_flat_descriptors(NULL), m_flat_nodes(NULL), m_flat_size(0),
+  m_flat_root_children(0)
 {
   createScoringObject();
 }
@@ -443,7 +546,10 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
+  (const std::string &filename): m_scoring_object(NULL),
+  m_mapped_data(NULL), m_mapped_size(0),
+  m_flat_descriptors(NULL), m_flat_nodes(NULL), m_flat_size(0),
+  m_flat_root_children(0)
 {
   load(filename);
 }
@@ -452,7 +558,10 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
+  (const char *filename): m_scoring_object(NULL),
+  m_mapped_data(NULL), m_mapped_size(0),
+  m_flat_descriptors(NULL), m_flat_nodes(NULL), m_flat_size(0),
+  m_flat_root_children(0)
 {
   load(filename);
 }
@@ -516,7 +625,9 @@ void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
   const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+  : m_scoring_object(NULL), m_mapped_data(NULL), m_mapped_size(0),
+  m_flat_descriptors(NULL), m_flat_nodes(NULL), m_flat_size(0),
+  m_flat_root_children(0)
 {
   *this = voc;
 }
@@ -527,6 +638,10 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
 {
   delete m_scoring_object;
+
+  m_words.clear();
+  m_nodes.clear();
+  releaseMapping();
 }
 
 // --------------------------------------------------------------------------
@@ -545,9 +660,19 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   
   this->m_nodes.clear();
   this->m_words.clear();
+  this->releaseMapping();
   
   this->m_nodes = voc.m_nodes;
   this->createWords();
+
+  // the descriptors of a mapped vocabulary do not own their data
+  if(voc.m_mapped_data)
+  {
+    for(size_t i = 0; i < this->m_nodes.size(); ++i)
+      this->m_nodes[i].descriptor = this->m_nodes[i].descriptor.clone();
+  }
+
+  this->buildFlatTree();
   
   return *this;
 }
@@ -560,6 +685,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  releaseMapping();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -583,6 +709,8 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 
   // and set the weight of each node of the tree
   setNodeWeights(training_features);
+
+  buildFlatTree();
   
 }
 
@@ -1252,6 +1380,46 @@ void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature,
   const int nid_level = m_L - levelsup;
   if(nid_level <= 0 && nid != NULL) *nid = 0; // root    //nid != NULL是指传入的这个nid指针是有效的指针
 
+  // 有紧凑存储的树时，同一个父节点的子节点描述子在内存中是连续的，每一层只访问几条cache line
+  if(m_flat_nodes != NULL)
+  {
+    const unsigned char *f = feature.data;
+    uint32_t first = 0;
+    uint32_t n = m_flat_root_children;
+    uint32_t best = 0;
+    int current_level = 0;
+
+    do
+    {
+      ++current_level;
+
+      // 与原来的实现一样，距离相同时取第一个子节点
+      best = first;
+      int best_d = flatDistance(f, m_flat_descriptors + (size_t)first * F::L);
+      for(uint32_t slot = first + 1; slot < first + n; ++slot)
+      {
+        int d = flatDistance(f, m_flat_descriptors + (size_t)slot * F::L);
+        if(d < best_d)
+        {
+          best_d = d;
+          best = slot;
+        }
+      }
+
+      if(nid != NULL && current_level == nid_level)
+        *nid = m_flat_nodes[best].node_id;
+
+      first = m_flat_nodes[best].first_child;
+      n = m_flat_nodes[best].n_children;
+
+    } while(n > 0);
+
+    // 权重可能被stopWords修改，所以从m_nodes中读取
+    word_id = m_flat_nodes[best].word_id;
+    weight = m_nodes[m_flat_nodes[best].node_id].weight;
+    return;
+  }
+
   NodeId final_id = 0; // root
   int current_level = 0;
 
@@ -1377,6 +1545,7 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
 
     m_words.clear();
     m_nodes.clear();
+    releaseMapping();
 
     string s;
     getline(f,s);
@@ -1467,6 +1636,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    buildFlatTree();
+
     return true;
 
 }
@@ -1500,6 +1671,289 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+    // 二进制文件直接保存紧凑存储的树，加载时映射后就可以直接使用
+    if(m_flat_nodes == NULL)
+    {
+        std::cerr << "Vocabulary saving failure: the tree can not be packed!" << endl;
+        return false;
+    }
+
+    // 计算各个数组在文件中的偏移，描述子按64字节对齐
+    const uint64_t N = m_flat_size;
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "DBOW2BIN", 8);
+    header.version = 2;
+    header.k = m_k;
+    header.L = m_L;
+    header.scoring = m_scoring;
+    header.weighting = m_weighting;
+    header.desc_len = F::L;
+    header.nodes = N;
+    header.root_children = m_flat_root_children;
+    header.descriptors_offset = (sizeof(BinaryHeader) + 63) & ~(uint64_t)63;
+    header.nodes_offset = (header.descriptors_offset + N * F::L + 7) & ~(uint64_t)7;
+    header.weights_offset = header.nodes_offset + N * sizeof(FlatNode);
+
+    std::vector<char> buffer(header.weights_offset + N * sizeof(double), 0);
+    memcpy(&buffer[0], &header, sizeof(header));
+    memcpy(&buffer[header.descriptors_offset], m_flat_descriptors, N * F::L);
+    memcpy(&buffer[header.nodes_offset], m_flat_nodes, N * sizeof(FlatNode));
+
+    double *weights = (double*)&buffer[header.weights_offset];
+    for(uint64_t i = 0; i < N; ++i)
+        weights[i] = m_nodes[m_flat_nodes[i].node_id].weight;
+
+    ofstream f(filename.c_str(), ios_base::out | ios_base::binary);
+    if(!f.is_open())
+        return false;
+    f.write(&buffer[0], buffer.size());
+    return f.good();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinaryHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    // 只读共享映射，多个进程加载同一个文件时共用page cache中的同一份数据
+    const size_t size = st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    const char *base = (const char*)data;
+    const BinaryHeader *header = (const BinaryHeader*)base;
+    const uint64_t N = header->nodes;
+
+    bool bOk = memcmp(header->magic, "DBOW2BIN", 8) == 0 && header->version == 2 &&
+        header->desc_len == (uint32_t)F::L && F::L % 8 == 0 &&
+        header->k >= 0 && header->k <= 20 && header->L >= 1 && header->L <= 10 &&
+        header->scoring >= 0 && header->scoring <= 5 &&
+        header->weighting >= 0 && header->weighting <= 3 &&
+        N > 0 && N < 0xffffffffu &&
+        header->root_children > 0 && header->root_children <= N &&
+        header->descriptors_offset % 8 == 0 && header->nodes_offset % 8 == 0 &&
+        header->weights_offset % 8 == 0 &&
+        // 偏移量来自文件，先和文件大小比较再做减法，避免 offset + N*size 溢出后通过检查
+        // N < 2^32，所以 N 乘以元素大小不会溢出
+        header->descriptors_offset <= size && N * F::L <= size - header->descriptors_offset &&
+        header->nodes_offset <= size && N * sizeof(FlatNode) <= size - header->nodes_offset &&
+        header->weights_offset <= size && N * sizeof(double) <= size - header->weights_offset;
+
+    // 检查没有通过时不使用文件中的偏移量，指针不会指到映射之外
+    const unsigned char *descriptors = (const unsigned char*)(base + (bOk ? header->descriptors_offset : 0));
+    const FlatNode *nodes = (const FlatNode*)(base + (bOk ? header->nodes_offset : 0));
+    const double *weights = (const double*)(base + (bOk ? header->weights_offset : 0));
+
+    // 先检查树的结构：每个节点id只出现一次，每个槽位只有一个父节点，且子节点总在父节点之后
+    std::vector<uint32_t> vSlotParent;
+    uint32_t nWords = 0;
+    if(bOk)
+    {
+        vSlotParent.assign(N, 0xffffffffu);
+        std::vector<bool> vbSeen(N + 1, false);
+        for(uint32_t slot = 0; slot < header->root_children; ++slot)
+            vSlotParent[slot] = 0;
+
+        for(uint64_t slot = 0; slot < N && bOk; ++slot)
+        {
+            const FlatNode &fn = nodes[slot];
+            bOk = vSlotParent[slot] != 0xffffffffu &&
+                fn.node_id >= 1 && fn.node_id <= N && !vbSeen[fn.node_id] &&
+                (fn.n_children == 0 ||
+                 (fn.first_child > slot && fn.first_child + (uint64_t)fn.n_children <= N));
+            if(!bOk)
+                break;
+            vbSeen[fn.node_id] = true;
+
+            if(fn.n_children == 0)
+                ++nWords;
+            for(uint32_t c = fn.first_child; c < fn.first_child + fn.n_children && bOk; ++c)
+            {
+                bOk = vSlotParent[c] == 0xffffffffu;
+                vSlotParent[c] = fn.node_id;
+            }
+        }
+    }
+
+    if(!bOk)
+    {
+        std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+        munmap(data, size);
+        return false;
+    }
+
+    m_words.clear();
+    m_nodes.clear();
+    releaseMapping();
+
+    m_k = header->k;
+    m_L = header->L;
+    m_scoring = (ScoringType)header->scoring;
+    m_weighting = (WeightingType)header->weighting;
+    createScoringObject();
+
+    // 节点个数已知，一次分配好，m_words中的指针之后不会失效
+    m_nodes.resize(N + 1);
+    m_nodes[0].id = 0;
+    m_words.assign(nWords, NULL);
+
+    // 按槽位顺序处理，每个父节点的子节点顺序与保存时相同
+    for(uint64_t slot = 0; slot < N; ++slot)
+    {
+        const FlatNode &fn = nodes[slot];
+        Node &node = m_nodes[fn.node_id];
+        node.id = fn.node_id;
+        node.parent = vSlotParent[slot];
+        m_nodes[node.parent].children.push_back(fn.node_id);
+
+        // 描述子直接指向映射的内存，不拷贝
+        node.descriptor = cv::Mat(1, F::L, CV_8U, (void*)(descriptors + slot * F::L));
+        node.weight = weights[slot];
+
+        if(fn.n_children == 0)
+        {
+            if(fn.word_id >= nWords || m_words[fn.word_id] != NULL)
+            {
+                std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+                m_words.clear();
+                m_nodes.clear();
+                munmap(data, size);
+                return false;
+            }
+            node.word_id = fn.word_id;
+            m_words[fn.word_id] = &node;
+        }
+    }
+
+    m_mapped_data = data;
+    m_mapped_size = size;
+
+    // 紧凑存储的树直接使用映射的内存
+    m_flat_descriptors = descriptors;
+    m_flat_nodes = nodes;
+    m_flat_size = N;
+    m_flat_root_children = header->root_children;
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::buildFlatTree()
+{
+  m_flat_descriptors = NULL;
+  m_flat_nodes = NULL;
+  m_flat_size = 0;
+  m_flat_root_children = 0;
+  m_flat_descriptor_storage.release();
+  m_flat_node_storage.clear();
+
+  if(m_nodes.size() <= 1 || m_nodes[0].children.empty() || F::L % 8 != 0)
+    return;
+
+  const size_t N = m_nodes.size() - 1;
+  for(size_t i = 1; i <= N; ++i)
+  {
+    const TDescriptor &d = m_nodes[i].descriptor;
+    if(d.type() != CV_8U || d.total() != (size_t)F::L || !d.isContinuous())
+      return;
+  }
+
+  // 广度优先遍历，每个节点的子节点放在相邻的槽位中。cv::Mat分配的内存是对齐的
+  cv::Mat descriptors(N, F::L, CV_8U);
+  std::vector<FlatNode> nodes;
+  nodes.reserve(N);
+
+  std::vector<NodeId> order;
+  order.reserve(N);
+  order.insert(order.end(), m_nodes[0].children.begin(), m_nodes[0].children.end());
+
+  for(size_t slot = 0; slot < order.size(); ++slot)
+  {
+    // 树的结构不对(例如有环)
+    if(slot >= N)
+      return;
+
+    const Node &node = m_nodes[order[slot]];
+
+    FlatNode fn;
+    fn.first_child = order.size();
+    fn.n_children = node.children.size();
+    fn.node_id = node.id;
+    fn.word_id = node.isLeaf() ? node.word_id : 0;
+    nodes.push_back(fn);
+
+    memcpy(descriptors.ptr<unsigned char>(slot), node.descriptor.data, F::L);
+    order.insert(order.end(), node.children.begin(), node.children.end());
+  }
+
+  m_flat_descriptor_storage = descriptors;
+  m_flat_node_storage.swap(nodes);
+
+  m_flat_descriptors = m_flat_descriptor_storage.data;
+  m_flat_nodes = &m_flat_node_storage[0];
+  m_flat_size = m_flat_node_storage.size();
+  m_flat_root_children = m_nodes[0].children.size();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+inline int TemplatedVocabulary<TDescriptor,F>::flatDistance(
+  const unsigned char *a, const unsigned char *b)
+{
+  int dist = 0;
+  for(int i = 0; i < F::L; i += 8)
+  {
+    uint64_t va, vb;
+    memcpy(&va, a + i, 8);
+    memcpy(&vb, b + i, 8);
+    dist += __builtin_popcountll(va ^ vb);
+  }
+  return dist;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::releaseMapping()
+{
+  if(m_mapped_data)
+  {
+    munmap(m_mapped_data, m_mapped_size);
+    m_mapped_data = NULL;
+    m_mapped_size = 0;
+  }
+
+  m_flat_descriptors = NULL;
+  m_flat_nodes = NULL;
+  m_flat_size = 0;
+  m_flat_root_children = 0;
+  m_flat_descriptor_storage.release();
+  m_flat_node_storage.clear();
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1625,6 +2079,7 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  releaseMapping();
   
   cv::FileNode fvoc = fs[name];
   
@@ -1669,6 +2124,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  buildFlatTree();
 }
 
 // --------------------------------------------------------------------------
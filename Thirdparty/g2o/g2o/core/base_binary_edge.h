@@ -90,12 +90,18 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual bool constructQuadraticFormRedirect(int vertexIndex, double* A, double* b);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::resize;
       using BaseEdge<D,E>::computeError;
 
     protected:
+      //! adds the quadratic form of the edge to the given hessian blocks and parameter vectors of the two vertices
+      template <typename AiType, typename BiType, typename AjType, typename BjType>
+      void addQuadraticForm(AiType& Ai, BiType& bi, AjType& Aj, BjType& bj);
+
       using BaseEdge<D,E>::_measurement;
       using BaseEdge<D,E>::_information;
       using BaseEdge<D,E>::_error;
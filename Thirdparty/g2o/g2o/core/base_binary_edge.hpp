@@ -57,6 +57,47 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
   VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
 
+  if (!from->fixed() || !to->fixed()) {
+#ifdef G2O_OPENMP
+    from->lockQuadraticForm();
+    to->lockQuadraticForm();
+#endif
+    addQuadraticForm(from->A(), from->b(), to->A(), to->b());
+#ifdef G2O_OPENMP
+    to->unlockQuadraticForm();
+    from->unlockQuadraticForm();
+#endif
+  }
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+bool BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticFormRedirect(int vertexIndex, double* A, double* b)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
+  if (from->fixed() && to->fixed())
+    return true;
+
+  if (vertexIndex == 0) {
+    Eigen::Map<Matrix<double, Di, Di> > fromA(A);
+    Eigen::Map<Matrix<double, Di, 1> > fromB(b);
+    addQuadraticForm(fromA, fromB, to->A(), to->b());
+  } else {
+    Eigen::Map<Matrix<double, Dj, Dj> > toA(A);
+    Eigen::Map<Matrix<double, Dj, 1> > toB(b);
+    addQuadraticForm(from->A(), from->b(), toA, toB);
+  }
+  return true;
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+template <typename AiType, typename BiType, typename AjType, typename BjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::addQuadraticForm(AiType& Ai, BiType& bi, AjType& Aj, BjType& bj)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
   // get the Jacobian of the nodes in the manifold domain
   const JacobianXiOplusType& A = jacobianOplusXi();
   const JacobianXjOplusType& B = jacobianOplusXj();
@@ -65,57 +106,47 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   bool fromNotFixed = !(from->fixed());
   bool toNotFixed = !(to->fixed());
 
-  if (fromNotFixed || toNotFixed) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-    to->lockQuadraticForm();
-#endif
-    const InformationType& omega = _information;
-    Matrix<double, D, 1> omega_r = - omega * _error;
-    if (this->robustKernel() == 0) {
-      if (fromNotFixed) {
-        Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += AtO*A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
-          else
-            _hessian.noalias() += AtO * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * omega * B;
+  const InformationType& omega = _information;
+  Matrix<double, D, 1> omega_r = - omega * _error;
+  if (this->robustKernel() == 0) {
+    if (fromNotFixed) {
+      Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+      bi.noalias() += A.transpose() * omega_r;
+      Ai.noalias() += AtO*A;
+      if (toNotFixed ) {
+        if (_hessianRowMajor) // we have to write to the block as transposed
+          _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
+        else
+          _hessian.noalias() += AtO * B;
       }
-    } else { // robust (weighted) error according to some kernel
-      double error = this->chi2();
-      Eigen::Vector3d rho;
-      this->robustKernel()->robustify(error, rho);
-      InformationType weightedOmega = this->robustInformation(rho);
-      //std::cout << PVAR(rho.transpose()) << std::endl;
-      //std::cout << PVAR(weightedOmega) << std::endl;
-
-      omega_r *= rho[1];
-      if (fromNotFixed) {
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += A.transpose() * weightedOmega * A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
-          else
-            _hessian.noalias() += A.transpose() * weightedOmega * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * weightedOmega * B;
+    } 
+    if (toNotFixed) {
+      bj.noalias() += B.transpose() * omega_r;
+      Aj.noalias() += B.transpose() * omega * B;
+    }
+  } else { // robust (weighted) error according to some kernel
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    InformationType weightedOmega = this->robustInformation(rho);
+    //std::cout << PVAR(rho.transpose()) << std::endl;
+    //std::cout << PVAR(weightedOmega) << std::endl;
+
+    omega_r *= rho[1];
+    if (fromNotFixed) {
+      bi.noalias() += A.transpose() * omega_r;
+      Ai.noalias() += A.transpose() * weightedOmega * A;
+      if (toNotFixed ) {
+        if (_hessianRowMajor) // we have to write to the block as transposed
+          _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
+        else
+          _hessian.noalias() += A.transpose() * weightedOmega * B;
       }
+    } 
+    if (toNotFixed) {
+      bj.noalias() += B.transpose() * omega_r;
+      Aj.noalias() += B.transpose() * weightedOmega * B;
     }
-#ifdef G2O_OPENMP
-    to->unlockQuadraticForm();
-    from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -32,6 +32,8 @@
 #include "sparse_block_matrix.h"
 #include "sparse_block_matrix_diagonal.h"
 #include "openmp_mutex.h"
+#include "optimizable_graph.h"
+#include "parallel_executor.h"
 #include "../../config.h"
 
 namespace g2o {
@@ -141,12 +143,41 @@ namespace g2o {
 
       virtual void multiplyHessian(double* dest, const double* src) const { _Hpp->multiplySymmetricUpperTriangle(dest, src);}
 
+      /**
+       * linearize the edges and build the Schur complement on several threads.
+       * The edges are partitioned by their landmark, the contributions to the
+       * poses are accumulated per partition and summed up afterwards, such that
+       * no locking is needed. Only used with the Schur complement, 0 (the
+       * default) builds the system on the calling thread. Takes effect with
+       * the next call to buildStructure().
+       * NOTE: linearizeOplus() of the edges must not modify the vertices, i.e.,
+       * the edges need analytic Jacobians. The BlockSolver does not take
+       * ownership of the executor.
+       */
+      void setParallelExecutor(ParallelExecutor* executor) { _parallelExecutor = executor;}
+      ParallelExecutor* parallelExecutor() const { return _parallelExecutor;}
+
     protected:
       void resize(int* blockPoseIndices, int numPoseBlocks, 
           int* blockLandmarkIndices, int numLandmarkBlocks, int totalDim);
 
       void deallocate();
 
+      //! true, if buildStructure() prepared the system for the parallel executor
+      bool useParallelExecutor() const { return _parallelExecutor && _numPartitions > 0;}
+
+      //! assign the active edges to the landmarks and the landmarks to the partitions
+      void buildParallelStructure();
+
+      //! linearize the edges of the landmarks in partition p
+      void linearizePartition(int p);
+      //! sum up the contributions of all partitions to the poses in partition p
+      void reducePosePartition(int p);
+      //! invert the landmark blocks of partition p
+      void invertLandmarkPartition(int p);
+      //! compute the rows of the Schur complement belonging to partition p
+      void schurPosePartition(int p);
+
       SparseBlockMatrix<PoseMatrixType>* _Hpp;
       SparseBlockMatrix<LandmarkMatrixType>* _Hll;
       SparseBlockMatrix<PoseLandmarkMatrixType>* _Hpl;
@@ -173,6 +204,22 @@ namespace g2o {
 
       int _numPoses, _numLandmarks;
       int _sizePoses, _sizeLandmarks;
+
+      // multi-threaded build of the system
+      ParallelExecutor* _parallelExecutor;
+      int _numPartitions;
+      std::vector<int> _partitionLandmarks;                      ///< first landmark of each partition, size _numPartitions+1
+      std::vector<int> _landmarkEdgesBegin;                      ///< first edge of each landmark in _landmarkEdges, size _numLandmarks+1
+      std::vector<std::pair<OptimizableGraph::Edge*, int> > _landmarkEdges;  ///< edges of each landmark and the index of the pose vertex in the edge
+      std::vector<OptimizableGraph::Edge*> _sequentialEdges;    ///< edges not belonging to exactly one landmark and one pose
+      std::vector<std::vector<OptimizableGraph::Edge*> > _rejectedEdges;  ///< per partition, edges not supporting constructQuadraticFormRedirect()
+      std::vector<OptimizableGraph::Vertex*> _poseVertices;
+      std::vector<int> _poseAccumulatorOffset;                   ///< offset of each pose in the accumulator of a partition
+      int _poseAccumulatorSize;
+      std::vector<double> _poseAccumulator;                      ///< per partition, hessian blocks and b of the poses
+      std::vector<JacobianWorkspace> _jacobianWorkspaces;        ///< per partition
+      std::vector<int> _partitionPoses;                          ///< first row of the Schur complement of each partition, size _numPartitions+1
+      std::vector<LandmarkVectorType, Eigen::aligned_allocator<LandmarkVectorType> > _landmarkDb;  ///< Dinv * b of each landmark
   };
 
 
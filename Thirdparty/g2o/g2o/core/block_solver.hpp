@@ -59,6 +59,9 @@ BlockSolver<Traits>::BlockSolver(LinearSolverType* linearSolver) :
   _sizePoses=0;
   _sizeLandmarks=0;
   _doSchur=true;
+  _parallelExecutor=0;
+  _numPartitions=0;
+  _poseAccumulatorSize=0;
 }
 
 template <typename Traits>
@@ -291,9 +294,104 @@ bool BlockSolver<Traits>::buildStructure(bool zeroBlocks)
   delete schurMatrixLookup;
   _Hschur->fillSparseBlockMatrixCCSTransposed(*_HschurTransposedCCS);
 
+  _numPartitions = 0;
+  if (_parallelExecutor && _numLandmarks > 0)
+    buildParallelStructure();
+
   return true;
 }
 
+template <typename Traits>
+void BlockSolver<Traits>::buildParallelStructure()
+{
+  _numPartitions = std::max(1, _parallelExecutor->numThreads());
+
+  // the poses in the order of their hessian index and their place in the accumulators
+  _poseVertices.resize(_numPoses);
+  for (size_t i = 0; i < _optimizer->indexMapping().size(); ++i) {
+    OptimizableGraph::Vertex* v = _optimizer->indexMapping()[i];
+    if (! v->marginalized())
+      _poseVertices[v->hessianIndex()] = v;
+  }
+  _poseAccumulatorOffset.resize(_numPoses);
+  _poseAccumulatorSize = 0;
+  for (int i = 0; i < _numPoses; ++i) {
+    int dim = _poseVertices[i]->dimension();
+    _poseAccumulatorOffset[i] = _poseAccumulatorSize;
+    _poseAccumulatorSize += dim * (dim + 1);
+  }
+  _poseAccumulator.resize(static_cast<size_t>(_numPartitions) * _poseAccumulatorSize);
+
+  // assign each edge between one landmark and one pose to the landmark
+  const OptimizableGraph::EdgeContainer& activeEdges = _optimizer->activeEdges();
+  std::vector<std::pair<int, int> > edgeLandmark(activeEdges.size(), std::make_pair(-1, -1));
+  _landmarkEdgesBegin.assign(_numLandmarks + 1, 0);
+  _sequentialEdges.clear();
+  for (size_t k = 0; k < activeEdges.size(); ++k) {
+    OptimizableGraph::Edge* e = activeEdges[k];
+    if (e->vertices().size() == 2) {
+      for (int i = 0; i < 2; ++i) {
+        const OptimizableGraph::Vertex* landmark = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        const OptimizableGraph::Vertex* pose = static_cast<const OptimizableGraph::Vertex*>(e->vertex(1 - i));
+        if (landmark->marginalized() && landmark->hessianIndex() >= 0 && ! pose->marginalized()) {
+          edgeLandmark[k] = std::make_pair(landmark->hessianIndex() - _numPoses, 1 - i);
+          break;
+        }
+      }
+    }
+    if (edgeLandmark[k].first < 0)
+      _sequentialEdges.push_back(e);
+    else
+      ++_landmarkEdgesBegin[edgeLandmark[k].first + 1];
+  }
+  for (int l = 0; l < _numLandmarks; ++l)
+    _landmarkEdgesBegin[l + 1] += _landmarkEdgesBegin[l];
+  _landmarkEdges.resize(_landmarkEdgesBegin[_numLandmarks]);
+  std::vector<int> landmarkFill(_landmarkEdgesBegin.begin(), _landmarkEdgesBegin.end() - 1);
+  for (size_t k = 0; k < activeEdges.size(); ++k) {
+    int l = edgeLandmark[k].first;
+    if (l >= 0)
+      _landmarkEdges[landmarkFill[l]++] = std::make_pair(activeEdges[k], edgeLandmark[k].second);
+  }
+
+  // contiguous ranges of landmarks with about the same number of edges
+  _partitionLandmarks.resize(_numPartitions + 1);
+  _partitionLandmarks[0] = 0;
+  int firstLandmark = 0;
+  for (int p = 1; p < _numPartitions; ++p) {
+    int firstEdge = static_cast<int>((static_cast<long long>(_landmarkEdges.size()) * p) / _numPartitions);
+    while (firstLandmark < _numLandmarks && _landmarkEdgesBegin[firstLandmark] < firstEdge)
+      ++firstLandmark;
+    _partitionLandmarks[p] = firstLandmark;
+  }
+  _partitionLandmarks[_numPartitions] = _numLandmarks;
+
+  _rejectedEdges.resize(_numPartitions);
+  _jacobianWorkspaces.assign(_numPartitions, _optimizer->jacobianWorkspace());
+
+  // contiguous ranges of rows of the Schur complement with about the same number of block products
+  std::vector<long long> rowProducts(_numPoses + 1, 0);
+  for (int l = 0; l < _numLandmarks; ++l) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[l];
+    for (size_t k = 0; k < landmarkColumn.size(); ++k)
+      rowProducts[landmarkColumn[k].row + 1] += landmarkColumn.size() - k;
+  }
+  for (int i = 0; i < _numPoses; ++i)
+    rowProducts[i + 1] += rowProducts[i];
+  _partitionPoses.resize(_numPartitions + 1);
+  _partitionPoses[0] = 0;
+  int firstPose = 0;
+  for (int p = 1; p < _numPartitions; ++p) {
+    long long firstProduct = (rowProducts[_numPoses] * p) / _numPartitions;
+    while (firstPose < _numPoses && rowProducts[firstPose] < firstProduct)
+      ++firstPose;
+    _partitionPoses[p] = firstPose;
+  }
+  _partitionPoses[_numPartitions] = _numPoses;
+
+  _landmarkDb.resize(_numLandmarks);
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::updateStructure(const std::vector<HyperGraph::Vertex*>& vset, const HyperGraph::EdgeSet& edges)
 {
@@ -375,58 +473,64 @@ bool BlockSolver<Traits>::solve(){
 
   //_DInvSchur->clear();
   memset (_coefficients, 0, _sizePoses*sizeof(double));
+  if (useParallelExecutor()) {
+    // each thread only writes to its own landmarks and to its own rows of the Schur complement
+    _parallelExecutor->parallelFor(_numPartitions, MemberLoopBody<BlockSolver<Traits> >(this, &BlockSolver<Traits>::invertLandmarkPartition));
+    _parallelExecutor->parallelFor(_numPartitions, MemberLoopBody<BlockSolver<Traits> >(this, &BlockSolver<Traits>::schurPosePartition));
+  } else {
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) schedule(dynamic, 10)
 # endif
-  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
-    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
-    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+    for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      // calculate inverse block for the landmark
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      db=Dinv*db;
 
-    // calculate inverse block for the landmark
-    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
-    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
-    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
-    Dinv = D->inverse();
+      assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
 
-    LandmarkVectorType  db(D->rows());
-    for (int j=0; j<D->rows(); ++j) {
-      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
-    }
-    db=Dinv*db;
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
+          it_outer != landmarkColumn.end(); ++it_outer) {
+        int i1 = it_outer->row;
 
-    assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
-    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+        const PoseLandmarkMatrixType* Bi = it_outer->block;
+        assert(Bi);
 
-    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
-        it_outer != landmarkColumn.end(); ++it_outer) {
-      int i1 = it_outer->row;
-
-      const PoseLandmarkMatrixType* Bi = it_outer->block;
-      assert(Bi);
-
-      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
-      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
-      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+        PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+        assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+        typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
 #    ifdef G2O_OPENMP
-      ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
+        ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
 #    endif
-      Bb.noalias() += (*Bi)*db;
-
-      assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
-      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
-
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
-      for (; it_inner != landmarkColumn.end(); ++it_inner) {
-        int i2 = it_inner->row;
-        const PoseLandmarkMatrixType* Bj = it_inner->block;
-        assert(Bj); 
-        while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
-          ++targetColumnIt;
-        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
-        PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
-        assert(Hi1i2);
-        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        Bb.noalias() += (*Bi)*db;
+
+        assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
+        typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+        for (; it_inner != landmarkColumn.end(); ++it_inner) {
+          int i2 = it_inner->row;
+          const PoseLandmarkMatrixType* Bj = it_inner->block;
+          assert(Bj); 
+          while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
+            ++targetColumnIt;
+          assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+          PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
+          assert(Hi1i2);
+          (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        }
       }
     }
   }
@@ -518,30 +622,50 @@ bool BlockSolver<Traits>::buildSystem()
 
   // resetting the terms for the pairwise constraints
   // built up the current system by storing the Hessian blocks in the edges and vertices
+  if (useParallelExecutor()) {
+    _parallelExecutor->parallelFor(_numPartitions, MemberLoopBody<BlockSolver<Traits> >(this, &BlockSolver<Traits>::linearizePartition));
+    _parallelExecutor->parallelFor(_numPartitions, MemberLoopBody<BlockSolver<Traits> >(this, &BlockSolver<Traits>::reducePosePartition));
+
+    // the remaining edges may share any vertex with the partitions
+    JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
+    for (int p = 0; p < _numPartitions; ++p) {
+      for (size_t k = 0; k < _rejectedEdges[p].size(); ++k) {
+        OptimizableGraph::Edge* e = _rejectedEdges[p][k];
+        e->linearizeOplus(jacobianWorkspace);
+        e->constructQuadraticForm();
+      }
+    }
+    for (size_t k = 0; k < _sequentialEdges.size(); ++k) {
+      OptimizableGraph::Edge* e = _sequentialEdges[k];
+      e->linearizeOplus(jacobianWorkspace);
+      e->constructQuadraticForm();
+    }
+  } else {
 # ifndef G2O_OPENMP
-  // no threading, we do not need to copy the workspace
-  JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
+    // no threading, we do not need to copy the workspace
+    JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
 # else
-  // if running with threads need to produce copies of the workspace for each thread
-  JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
+    // if running with threads need to produce copies of the workspace for each thread
+    JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
 # pragma omp parallel for default (shared) firstprivate(jacobianWorkspace) if (_optimizer->activeEdges().size() > 100)
 # endif
-  for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
-    OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
-    e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
-    e->constructQuadraticForm();
+    for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
+      OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
+      e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+      e->constructQuadraticForm();
 #  ifndef NDEBUG
-    for (size_t i = 0; i < e->vertices().size(); ++i) {
-      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
-      if (! v->fixed()) {
-        bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
-        if (hasANan) {
-          cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
-          break;
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        if (! v->fixed()) {
+          bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+          if (hasANan) {
+            cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+            break;
+          }
         }
       }
-    }
 #  endif
+    }
   }
 
   // flush the current system in a sparse block matrix
@@ -560,6 +684,109 @@ bool BlockSolver<Traits>::buildSystem()
 }
 
 
+template <typename Traits>
+void BlockSolver<Traits>::linearizePartition(int p)
+{
+  JacobianWorkspace& jacobianWorkspace = _jacobianWorkspaces[p];
+  double* accumulator = &_poseAccumulator[static_cast<size_t>(p) * _poseAccumulatorSize];
+  std::fill(accumulator, accumulator + _poseAccumulatorSize, 0.);
+  _rejectedEdges[p].clear();
+
+  for (int l = _partitionLandmarks[p]; l < _partitionLandmarks[p + 1]; ++l) {
+    for (int k = _landmarkEdgesBegin[l]; k < _landmarkEdgesBegin[l + 1]; ++k) {
+      OptimizableGraph::Edge* e = _landmarkEdges[k].first;
+      const int poseVertex = _landmarkEdges[k].second;
+      const int poseIndex = static_cast<OptimizableGraph::Vertex*>(e->vertex(poseVertex))->hessianIndex();
+      e->linearizeOplus(jacobianWorkspace);
+      if (poseIndex < 0) {
+        // fixed pose, only the landmark of this partition is written
+        e->constructQuadraticForm();
+        continue;
+      }
+      const int dim = _poseVertices[poseIndex]->dimension();
+      double* A = accumulator + _poseAccumulatorOffset[poseIndex];
+      if (! e->constructQuadraticFormRedirect(poseVertex, A, A + dim * dim))
+        _rejectedEdges[p].push_back(e);
+    }
+  }
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::reducePosePartition(int p)
+{
+  for (int i = _partitionPoses[p]; i < _partitionPoses[p + 1]; ++i) {
+    OptimizableGraph::Vertex* v = _poseVertices[i];
+    const int dim = v->dimension();
+    double* A = v->hessianData();
+    double* b = v->bData();
+    for (int q = 0; q < _numPartitions; ++q) {
+      const double* accumulator = &_poseAccumulator[static_cast<size_t>(q) * _poseAccumulatorSize + _poseAccumulatorOffset[i]];
+      for (int k = 0; k < dim * dim; ++k)
+        A[k] += accumulator[k];
+      for (int k = 0; k < dim; ++k)
+        b[k] += accumulator[dim * dim + k];
+    }
+  }
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::invertLandmarkPartition(int p)
+{
+  for (int landmarkIndex = _partitionLandmarks[p]; landmarkIndex < _partitionLandmarks[p + 1]; ++landmarkIndex) {
+    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+    Dinv = D->inverse();
+
+    LandmarkVectorType  db(D->rows());
+    for (int j=0; j<D->rows(); ++j) {
+      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+    }
+    _landmarkDb[landmarkIndex] = Dinv*db;
+  }
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::schurPosePartition(int p)
+{
+  // same loop as the sequential version restricted to the rows of the partition,
+  // thus each block of the Schur complement is summed up in the same order
+  typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock firstRow(_partitionPoses[p], 0);
+  const int endRow = _partitionPoses[p + 1];
+  for (int landmarkIndex = 0; landmarkIndex < _numLandmarks; ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    const LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+
+    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), firstRow);
+        it_outer != landmarkColumn.end() && it_outer->row < endRow; ++it_outer) {
+      int i1 = it_outer->row;
+
+      const PoseLandmarkMatrixType* Bi = it_outer->block;
+      assert(Bi);
+
+      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+      Bb.noalias() += (*Bi)*_landmarkDb[landmarkIndex];
+
+      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = it_outer; it_inner != landmarkColumn.end(); ++it_inner) {
+        int i2 = it_inner->row;
+        const PoseLandmarkMatrixType* Bj = it_inner->block;
+        assert(Bj);
+        while (targetColumnIt->row < i2)
+          ++targetColumnIt;
+        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+        PoseMatrixType* Hi1i2 = targetColumnIt->block;
+        assert(Hi1i2);
+        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+      }
+    }
+  }
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::setLambda(double lambda, bool backup)
 {
@@ -172,6 +172,11 @@ namespace g2o {
       virtual bool removeEdge(Edge* e);
       //! clears the graph and empties all structures.
       virtual void clear();
+      /**
+       * empties all structures like clear(), but does not delete the vertices and edges.
+       * The caller keeps the ownership and may add them again to a graph later on.
+       */
+      virtual void release();
 
       //! @returns the map <i>id -> vertex</i> where the vertices are stored
       const VertexIDMap& vertices() const {return _vertices;}
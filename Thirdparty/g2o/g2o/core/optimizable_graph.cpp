@@ -197,6 +197,13 @@ namespace g2o {
     _robustKernel = ptr;
   }
 
+  RobustKernel* OptimizableGraph::Edge::releaseRobustKernel()
+  {
+    RobustKernel* ptr = _robustKernel;
+    _robustKernel = 0;
+    return ptr;
+  }
+
   bool OptimizableGraph::Edge::resolveCaches() {
     return true;
   }
@@ -417,6 +417,11 @@ namespace g2o {
          * specify the robust kernel to be used in this edge
          */
         void setRobustKernel(RobustKernel* ptr);
+        /**
+         * removes the robust kernel from the edge without deleting it and returns it,
+         * the caller takes over the ownership
+         */
+        RobustKernel* releaseRobustKernel();
 
         //! returns the error vector cached after calling the computeError;
         virtual const double* errorData() const = 0;
@@ -437,6 +442,15 @@ namespace g2o {
          */
         virtual void constructQuadraticForm() = 0;
 
+        /**
+         * Same as constructQuadraticForm(), but the hessian block ii and the
+         * parameter vector b of the vertex with the given index are added to A
+         * and b instead of the memory of the vertex. This allows to linearize
+         * edges sharing that vertex on several threads.
+         * @return false, if the edge does not support this. Nothing is written in that case.
+         */
+        virtual bool constructQuadraticFormRedirect(int vertexIndex, double* A, double* b) { (void) vertexIndex; (void) A; (void) b; return false;}
+
         /**
          * maps the internal matrix to some external memory location,
          * you need to provide the memory before calling constructQuadraticForm
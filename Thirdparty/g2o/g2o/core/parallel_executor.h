@@ -0,0 +1,75 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_PARALLEL_EXECUTOR_H
+#define G2O_PARALLEL_EXECUTOR_H
+
+namespace g2o {
+
+  /**
+   * \brief body of a loop whose iterations are independent of each other
+   */
+  class ParallelLoopBody
+  {
+    public:
+      virtual ~ParallelLoopBody() {}
+      virtual void operator()(int i) const = 0;
+  };
+
+  /**
+   * \brief loop body calling a member function of an object for each iteration
+   */
+  template <typename T>
+  class MemberLoopBody : public ParallelLoopBody
+  {
+    public:
+      typedef void (T::*Function)(int);
+      MemberLoopBody(T* object, Function function) : _object(object), _function(function) {}
+      virtual void operator()(int i) const { (_object->*_function)(i); }
+    protected:
+      T* _object;
+      Function _function;
+  };
+
+  /**
+   * \brief runs the iterations of a loop on several threads
+   *
+   * g2o does not create any threads on its own, the application provides an
+   * implementation of this interface, e.g., on top of its own thread pool.
+   */
+  class ParallelExecutor
+  {
+    public:
+      virtual ~ParallelExecutor() {}
+      //! calls body(i) for each i in [0, n) and returns after all calls have finished
+      virtual void parallelFor(int n, const ParallelLoopBody& body) = 0;
+      //! number of threads which execute the iterations of parallelFor()
+      virtual int numThreads() const = 0;
+  };
+
+} // end namespace
+
+#endif
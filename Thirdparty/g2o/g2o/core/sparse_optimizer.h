@@ -244,6 +244,12 @@ namespace g2o {
      */
     virtual void clear();
 
+    /**
+     * removes all nodes / edges like clear() without deleting them, such that
+     * the caller may re-use the objects in a subsequent optimization.
+     */
+    virtual void release();
+
     /**
      * computes the error vectors of all edges in the activeSet, and caches them
      */
@@ -38,6 +38,7 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 namespace g2o {
 
@@ -96,7 +97,7 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
       if (_init)
         _sparseMatrix.resize(A.rows(), A.cols());
       fillSparseMatrix(A, !_init);
-      if (_init) // compute the symbolic composition once
+      if (_init && ! samePatternAsSymbolicDecomposition(A)) // compute the symbolic composition once
         computeSymbolicDecomposition(A);
       _init = false;
 
@@ -137,6 +138,39 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
     bool _writeDebug;
     SparseMatrix _sparseMatrix;
     CholeskyDecomposition _cholesky;
+    //! pattern of the matrix the current symbolic decomposition was computed for
+    std::vector<int> _symbolicBlockIndices;
+    std::vector<int> _symbolicOuterIndices;
+    std::vector<int> _symbolicInnerIndices;
+
+    /**
+     * checks whether the matrix has the same non-zero pattern as the one
+     * which was used for the last symbolic decomposition. In this case the
+     * ordering and the elimination tree can be re-used, even if init() was
+     * called in between, e.g., by re-initializing the optimization after
+     * discarding a few edges which do not change the pattern of A.
+     */
+    bool samePatternAsSymbolicDecomposition(const SparseBlockMatrix<MatrixType>& A) const
+    {
+      if (_symbolicOuterIndices.empty())
+        return false;
+      if (A.colBlockIndices() != _symbolicBlockIndices)
+        return false;
+      int cols = _sparseMatrix.cols();
+      int nnz = _sparseMatrix.nonZeros();
+      if (static_cast<int>(_symbolicOuterIndices.size()) != cols + 1 || static_cast<int>(_symbolicInnerIndices.size()) != nnz)
+        return false;
+      return std::equal(_symbolicOuterIndices.begin(), _symbolicOuterIndices.end(), _sparseMatrix.outerIndexPtr())
+        && std::equal(_symbolicInnerIndices.begin(), _symbolicInnerIndices.end(), _sparseMatrix.innerIndexPtr());
+    }
+
+    //! remember the pattern of the matrix for samePatternAsSymbolicDecomposition()
+    void storeSymbolicPattern(const SparseBlockMatrix<MatrixType>& A)
+    {
+      _symbolicBlockIndices = A.colBlockIndices();
+      _symbolicOuterIndices.assign(_sparseMatrix.outerIndexPtr(), _sparseMatrix.outerIndexPtr() + _sparseMatrix.cols() + 1);
+      _symbolicInnerIndices.assign(_sparseMatrix.innerIndexPtr(), _sparseMatrix.innerIndexPtr() + _sparseMatrix.nonZeros());
+    }
 
     /**
      * compute the symbolic decompostion of the matrix only once.
@@ -195,6 +229,7 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
         _cholesky.analyzePatternWithPermutation(_sparseMatrix, scalarP);
 
       }
+      storeSymbolicPattern(A);
       G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
       if (globalStats)
         globalStats->timeSymbolicDecomposition = get_monotonic_time() - t;
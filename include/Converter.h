@@ -171,6 +171,21 @@ public:
      * @return Eigen::Matrix<double,3,3> 转换结果
      */
     static Eigen::Matrix<double,3,3> toMatrix3d(const cv::Mat &cvMat3);
+    /**
+     * @brief 将3x1的cv::Mat(CV_32F)转换成为Eigen中的单精度向量
+     * 
+     * @param[in] cvVector 待转换的数据
+     * @return Eigen::Vector3f 转换结果
+     * @note 不做类型转换,跟踪线程中位姿、地图点坐标的热点计算直接使用,不分配堆内存
+     */
+    static Eigen::Vector3f toVector3f(const cv::Mat &cvVector);
+    /**
+     * @brief 将3x3的cv::Mat(CV_32F)转换成为Eigen中的单精度矩阵
+     * 
+     * @param[in] cvMat3 输入
+     * @return Eigen::Matrix3f 转换结果
+     */
+    static Eigen::Matrix3f toMatrix3f(const cv::Mat &cvMat3);
     /**
      * @brief 将给定的cv::Mat类型的旋转矩阵转换成以std::vector<float>类型表示的四元数
      * 
@@ -61,6 +61,12 @@ namespace ORB_SLAM2
 
 /** @} */
 
+/**
+ * @brief 去畸变查找表的采样间隔(像素)
+ * @details 查找表只在这些采样点上调用一次 cv::undistortPoints,其余位置用双线性插值
+ */
+#define UNDISTORT_MAP_STEP 4
+
 class MapPoint;
 class KeyFrame;
 
@@ -103,9 +109,10 @@ public:
      * @param[in] distCoef          相机去畸变参数
      * @param[in] bf                相机基线长度和焦距的乘积
      * @param[in] thDepth           远点和近点的深度区分阈值
+     * @param[in] pThreadPool       线程池，用来和当前线程同时提取右目图像的特征点、并行计算双目匹配；为NULL时串行计算
      *  
      */
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, ThreadPool* pThreadPool=NULL);
 
     // Constructor for RGB-D cameras.	
     /**
@@ -192,6 +199,28 @@ public:
         return mRwc.clone();
     }
 
+    /**
+     * @name 位姿的Eigen形式
+     * @details 和 mRcw、mtcw、mOw 相同,在 UpdatePoseMatrices() 中同步更新,
+     * 投影匹配、视野判断等逐点计算中使用,不分配堆内存
+     * @{
+     */
+    inline const Eigen::Matrix3f& GetRotationEigen() const
+    {
+        return mRcwEig;
+    }
+
+    inline const Eigen::Vector3f& GetTranslationEigen() const
+    {
+        return mtcwEig;
+    }
+
+    inline const Eigen::Vector3f& GetCameraCenterEigen() const
+    {
+        return mOwEig;
+    }
+    /** @} */
+
     // Check if a MapPoint is in the frustum of the camera
     // and fill variables of the MapPoint to be used by the tracking
     /**
@@ -245,8 +274,9 @@ public:
      * \n 最后对所有SAD的值进行排序, 剔除SAD值较大的匹配对，然后利用抛物线拟合得到亚像素精度的匹配 
      * \n 这里所谓的亚像素精度，就是使用这个拟合得到一个小于一个单位像素的修正量，这样可以取得更好的估计结果，计算出来的点的深度也就越准确
      * \n 匹配成功后会更新 Frame::mvuRight (ur) 和 Frame::mvDepth (Z)
+     * @param[in] pThreadPool       线程池，用来并行匹配左图的特征点；为NULL时串行匹配
      */
-    void ComputeStereoMatches();
+    void ComputeStereoMatches(ThreadPool* pThreadPool=NULL);
 
     // Associate a "right" coordinate to a keypoint if there is valid depth in the depthmap.
 	
@@ -403,8 +433,10 @@ public:
     // FRAME_GRID_ROWS 48
     // FRAME_GRID_COLS 64
 	///这个向量中存储的是每个图像网格内特征点的id（左图）
-    // CC：这是一个数组，然后数组中的元素都是std::vector
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    /// 按网格顺序 (ix*FRAME_GRID_ROWS+iy) 连续存放,同一网格内按特征点id升序
+    std::vector<std::size_t> mvGridIndices;
+    /// 网格 c 中的特征点是 mvGridIndices[mvGridCellStart[c], mvGridCellStart[c+1]),大小为 FRAME_GRID_COLS*FRAME_GRID_ROWS+1
+    std::vector<int> mvGridCellStart;
 
     /** @} */
 
@@ -457,6 +489,16 @@ public:
     */ 
     static bool mbInitialComputations;
 
+    /**
+     * @name 去畸变查找表
+     * @details 原始图像上每隔 UNDISTORT_MAP_STEP 个像素采样一次,存放去畸变后的坐标,
+     * 和图像边界一样只在 mbInitialComputations 时计算一次
+     * @{
+     */
+    static cv::Mat mUndistortMapX;
+    static cv::Mat mUndistortMapY;
+    /** @} */
+
 private:
 
     // Undistort keypoints given OpenCV distortion parameters.
@@ -475,6 +517,13 @@ private:
      */
     void ComputeImageBounds(const cv::Mat &imLeft);
 
+    /**
+     * @brief 计算去畸变查找表 mUndistortMapX 和 mUndistortMapY
+     * 
+     * @param[in] im                需要去畸变的图像,只用到它的尺寸
+     */
+    void ComputeUndistortMap(const cv::Mat &im);
+
     // Assign keypoints to the grid for speed up feature matching (called in the constructor).
     /**
      * @brief 将提取到的特征点分配到图像网格中 \n
@@ -493,6 +542,10 @@ private:
     cv::Mat mRwc; ///< Rotation from camera to world
     cv::Mat mOw;  ///< mtwc,Translation from camera to world
 
+    Eigen::Matrix3f mRcwEig; ///< 和 mRcw 相同
+    Eigen::Vector3f mtcwEig; ///< 和 mtcw 相同
+    Eigen::Vector3f mOwEig;  ///< 和 mOw 相同
+
     /** @} */
 };
 
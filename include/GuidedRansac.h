@@ -0,0 +1,151 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GUIDEDRANSAC_H
+#define GUIDEDRANSAC_H
+
+#include <vector>
+#include <cstddef>
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief PROSAC渐进采样,用于PnPsolver的RANSAC
+ * @details 匹配按描述子距离从小到大排序,前几次只在质量最好的前n个匹配中采样,
+ * 采样次数增加时n按照PROSAC的增长函数逐渐扩大到全部匹配,T_N次采样之后就和均匀采样的RANSAC一样了。
+ * 参考: Chum, Matas. Matching with PROSAC - Progressive Sample Consensus. CVPR 2005
+ */
+class ProsacSampler
+{
+public:
+    ProsacSampler();
+
+    /**
+     * @brief 设置匹配质量并从头开始采样
+     * @param[in] vDistances        每个匹配的描述子距离,下标和求解器内部的匹配下标一致,距离越小质量越好,距离相同的匹配随机排列
+     * @param[in] nMinSet           最小集的大小
+     * @param[in] nMaxIterations    T_N,也就是最大迭代次数
+     */
+    void Reset(const std::vector<int> &vDistances, int nMinSet, int nMaxIterations);
+
+    /**
+     * @brief 生成下一个最小集
+     * @param[out] vSample  最小集中匹配的下标(求解器内部的下标)
+     */
+    void Sample(std::vector<size_t> &vSample);
+
+private:
+    std::vector<size_t> mvSortedIndices;    ///< 按描述子距离升序排列的匹配下标
+    std::vector<size_t> mvAvailable;        ///< 采样时还没有被选中的下标,复用内存
+    int mnMinSet;                           ///< 最小集的大小 m
+    int mnSamples;                          ///< 已经采样的次数 t
+    int mn;                                 ///< 当前采样范围,只在前n个匹配中采样
+    double mTn;                             ///< T_n, 均匀采样T_N次时,平均有多少次的最小集全部来自前n个匹配
+    double mTnPrime;                        ///< T'_n, 采样范围扩大到n+1的采样次数
+};
+
+/**
+ * @brief SPRT(序贯概率比检验)提前结束内点检验
+ * @details 逐个检验匹配点时累计似然比 λ = Π p(x|坏模型)/p(x|好模型),超过阈值A就判定为坏模型,不再检验剩下的点。
+ * 坏模型的内点比例 δ 根据被拒绝的模型在线估计,好模型的内点比例 ε 取求解器要求的最小内点比例和目前最好模型中的较大值。
+ * 参考: Chum, Matas. Optimal Randomized RANSAC. PAMI 2008
+ */
+class SprtVerifier
+{
+public:
+    SprtVerifier();
+
+    /**
+     * @brief 设置初始参数
+     * @param[in] epsilon   好模型下一个匹配是内点的概率
+     * @param[in] delta     坏模型下一个匹配被判为内点的概率的初值
+     * @param[in] tM        计算一次模型的耗时,以检验一个匹配点的耗时为单位
+     * @param[in] nPoints   匹配点的数目,用来生成检验顺序
+     */
+    void Reset(double epsilon, double delta, double tM, size_t nPoints);
+
+    /**
+     * @brief 检验匹配点的顺序,是 0..nPoints-1 的一个随机排列
+     * @details SPRT假设点是以随机顺序到来的。特征点的下标按金字塔层和网格排列,
+     * 外点常常聚在一起(运动物体、重复纹理),按下标顺序检验时正确的模型也会被这一段外点连续拒绝
+     */
+    const std::vector<size_t> &Order() const { return mvOrder; }
+
+    /** @brief 开始检验一个新的模型 */
+    void Begin()
+    {
+        mLogLambda = 0.0;
+        mnTested = 0;
+        mnConsistent = 0;
+    }
+
+    /**
+     * @brief 记录一个匹配点的检验结果
+     * @param[in] bConsistent   这个点是否是内点
+     * @return bool             false 表示似然比超过了阈值,应当拒绝这个模型
+     */
+    bool Update(bool bConsistent)
+    {
+        mnTested++;
+        if(bConsistent)
+        {
+            mnConsistent++;
+            mLogLambda += mLogRatioInlier;
+        }
+        else
+            mLogLambda += mLogRatioOutlier;
+        return !mbActive || mLogLambda<=mLogA;
+    }
+
+    /** @brief 模型被拒绝之后调用,用这次检验过的点更新 δ 的估计 */
+    void Rejected();
+
+    /**
+     * @brief 找到了内点更多的模型之后调用
+     * @param[in] epsilon   这个模型的内点比例
+     */
+    void BetterModel(double epsilon);
+
+private:
+    /** @brief 根据 ε 和 δ 重新计算阈值A以及每个点对似然比的贡献 */
+    void UpdateThreshold();
+
+    double mEpsilon;                ///< 好模型的内点比例
+    double mDelta;                  ///< 坏模型的内点比例
+    double mTM;                     ///< 计算一次模型的相对耗时
+    double mLogA;                   ///< 阈值A的对数
+    double mLogRatioInlier;         ///< 内点对对数似然比的贡献 log(δ/ε)
+    double mLogRatioOutlier;        ///< 外点对对数似然比的贡献 log((1-δ)/(1-ε))
+    bool mbActive;                  ///< δ>=ε 时检验没有意义,不拒绝任何模型
+
+    double mLogLambda;              ///< 当前模型的对数似然比
+    int mnTested;                   ///< 当前模型已经检验的点数
+    int mnConsistent;               ///< 当前模型已经检验的内点数
+
+    long mnRejectedTested;          ///< 被拒绝的模型总共检验的点数
+    long mnRejectedConsistent;      ///< 被拒绝的模型总共检验出的内点数
+
+    std::vector<size_t> mvOrder;    ///< 检验匹配点的随机顺序
+};
+
+} //namespace ORB_SLAM
+
+#endif // GUIDEDRANSAC_H
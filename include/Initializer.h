@@ -56,10 +56,12 @@ public:
      * @param[in] ReferenceFrame        参考帧
      * @param[in] sigma                 测量误差
      * @param[in] iterations            RANSAC迭代次数
+     * @param[in] pThreadPool           线程池，用来同时计算H矩阵和F矩阵；为NULL时串行计算
      */
     Initializer(const Frame &ReferenceFrame,    
                 float sigma = 1.0,              
-                int iterations = 200);          
+                int iterations = 200,
+                ThreadPool* pThreadPool = NULL);          
 
     // Computes in parallel a fundamental matrix and a homography
     // Selects a model and tries to recover the motion and the structure from motion
@@ -311,6 +313,9 @@ private:
     /** 二维容器，外层容器的大小为迭代次数，内层容器大小为每次迭代算H或F矩阵需要的点,实际上是八对 */
     vector<vector<size_t> > mvSets; 
 
+    /** 用来并行计算H矩阵和F矩阵的线程池 */
+    ThreadPool* mpThreadPool;
+
 };
 
 } //namespace ORB_SLAM
@@ -40,8 +40,13 @@
 #include "ORBextractor.h"
 #include "Frame.h"
 #include "KeyFrameDatabase.h"
+#include "Serializer.h"
 
 #include <mutex>
+#include <map>
+#include <iostream>
+#include <memory>
+#include <atomic>
 
 namespace ORB_SLAM2
 {
@@ -82,6 +87,9 @@ public:
     cv::Mat GetStereoCenter();          ///< 获取双目相机的中心,这个只有在可视化的时候才会用到
     cv::Mat GetRotation();              ///< 获取姿态
     cv::Mat GetTranslation();           ///< 获取位置
+    Eigen::Matrix3f GetRotationEigen();     ///< 获取姿态,不分配堆内存
+    Eigen::Vector3f GetTranslationEigen();  ///< 获取位置,不分配堆内存
+    Eigen::Vector3f GetCameraCenterEigen(); ///< 获取(左目)相机的中心,不分配堆内存
 
     /**
      * @brief Bag of Words Representation
@@ -140,6 +148,12 @@ public:
      * @return     权重
      */
     int GetWeight(KeyFrame* pKF);
+    /**
+     * @brief 改变和pKF共同观测到的地图点数目,地图点增删观测的时候调用
+     * @param[in] pKF   另一个关键帧
+     * @param[in] n     共视地图点数目的变化量
+     */
+    void ChangeCovisibility(KeyFrame* pKF, int n);
 
     // ========================= Spanning tree functions =======================
     /**
@@ -279,6 +293,62 @@ public:
      */
     float ComputeSceneMedianDepth(const int q);
 
+    // Map serialization. The keypoints, descriptors, grid and feature vector are saved in a
+    // separate block by SaveFeatures(), so that a loaded map can memory-map them and only
+    // read them when the KeyFrame is used (see LoadFeatures()). Links to other KeyFrames and
+    // MapPoints are saved as ids by SaveLinks(), and resolved by LoadLinks() once every
+    // KeyFrame and MapPoint of the map has been created.
+    /**
+     * @brief 保存关键帧自身的数据:相机参数、词袋、位姿,以及SaveFeatures()写出的数据块在文件中的位置
+     * @param[in] f                 输出流
+     * @param[in] nFeaturesBegin    SaveFeatures()写出的数据块在文件中的起始位置
+     * @param[in] nFeaturesEnd      SaveFeatures()写出的数据块在文件中的结束位置
+     */
+    void Save(std::ostream &f, uint64_t nFeaturesBegin, uint64_t nFeaturesEnd);
+
+    /**
+     * @brief 保存描述子、特征点、网格和特征向量。描述子写在最前面,调用者要保证起始位置是对齐的
+     * @param[in] f 输出流
+     */
+    void SaveFeatures(std::ostream &f);
+
+    /**
+     * @brief 保存关键帧和其他关键帧、地图点之间的关系:观测到的地图点、共视图、生成树和回环边,都保存为id
+     * @param[in] f 输出流
+     */
+    void SaveLinks(std::ostream &f);
+
+    /**
+     * @brief 读取Save()保存的关键帧,词袋直接读取,不需要重新计算
+     * @details 描述子直接指向映射文件中的数据,特征点、网格和特征向量在第一次调用LoadFeatures()时才读取。
+     * 会修改Frame中和相机有关的静态变量,所以只能在跟踪第一帧之前调用
+     * @param[in] f         输入流
+     * @param[in] pMap      地图
+     * @param[in] pKFDB     关键帧数据库
+     * @param[in] pVoc      字典
+     * @param[in] pMapFile  映射的地图文件
+     * @return KeyFrame*    新建的关键帧,读取失败时为NULL
+     */
+    static KeyFrame* Load(std::istream &f, Map* pMap, KeyFrameDatabase* pKFDB, ORBVocabulary* pVoc,
+                          const std::shared_ptr<MappedFile> &pMapFile);
+
+    /**
+     * @brief 确保特征点、网格和特征向量已经读入内存
+     * @details 从地图文件加载的关键帧在第一次被使用时才从映射文件中读取这些数据,这样常驻内存只和实际用到的
+     * 关键帧数量有关。使用 mvKeys, mvKeysUn, mFeatVec, GetFeaturesInArea() 和 UnprojectStereo() 之前都要先调用,
+     * 已经读入时只是一次原子变量的读取。可以在多个线程中同时调用
+     */
+    void LoadFeatures();
+
+    /**
+     * @brief 读取SaveLinks()保存的关系,并且给地图点添加观测
+     * @param[in] f         输入流
+     * @param[in] mKFs      id到关键帧的映射
+     * @param[in] mMPs      id到地图点的映射
+     */
+    void LoadLinks(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs,
+                   const std::map<long unsigned int, MapPoint*> &mMPs);
+
     /// 比较两个int型权重的大小的比较函数
     static bool weightComp( int a, int b)
 	{
@@ -351,12 +421,13 @@ public:
     const int N;
 
     // KeyPoints, stereo coordinate and descriptors (all associated by an index)
-    // 和Frame类中的定义相同
-    const std::vector<cv::KeyPoint> mvKeys;
-    const std::vector<cv::KeyPoint> mvKeysUn;
+    // 和Frame类中的定义相同。mvKeys, mvKeysUn 和 mDescriptors 只在LoadFeatures()中被修改,其他地方不要修改
+    // 从地图文件加载的关键帧的 mDescriptors 指向只读的映射文件
+    std::vector<cv::KeyPoint> mvKeys;
+    std::vector<cv::KeyPoint> mvKeysUn;
     const std::vector<float> mvuRight; // negative value for monocular points
     const std::vector<float> mvDepth; // negative value for monocular points
-    const cv::Mat mDescriptors;
+    cv::Mat mDescriptors;
 
     //BoW
     // Vector of words to represent images 
@@ -391,11 +462,19 @@ public:
     // The following variables need to be accessed trough a mutex to be thread safe. ---- 但是大哥..protected也不是这样设计使用的啊
 protected:
 
+    /** @brief 如果连接权重变化过,重新按权重排序,调用者需要持有 mMutexConnections */
+    void SortConnectedKeyFrames();
+
     // SE3 Pose and camera center
     cv::Mat Tcw;    // 当前相机的位姿，世界坐标系到相机坐标系
     cv::Mat Twc;    // 当前相机位姿的逆
     cv::Mat Ow;     // 相机光心(左目)在世界坐标系下的坐标,这里和普通帧中的定义是一样的
 
+    // 和 Tcw、Ow 相同的Eigen形式,在 SetPose() 中同步更新
+    Eigen::Matrix3f mRcwEig;
+    Eigen::Vector3f mtcwEig;
+    Eigen::Vector3f mOwEig;
+
     cv::Mat Cw; ///< Stereo middel point. Only for visualization
 
     /// MapPoints associated to keypoints
@@ -416,6 +495,10 @@ protected:
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;            
     // 共视关键帧中从大到小排序后的权重，和上面对应
     std::vector<int> mvOrderedWeights;                             
+    // 连接权重变化之后还没有重新排序,下次读取排序结果时再排序
+    bool mbOrderedConnectionsDirty;
+    // 和其他关键帧共同观测到的地图点数目,地图点增删观测时增量维护,UpdateConnections 直接使用
+    std::map<KeyFrame*,int> mCovisibilityCounter;
 
     // ===================== Spanning Tree and Loop Edges ========================
     // std::set是集合，相比vector，进行插入数据这样的操作时会自动排序
@@ -439,6 +522,15 @@ protected:
     std::mutex mMutexConnections;
     /// 在操作和特征点有关的变量的时候的互斥锁
     std::mutex mMutexFeatures;
+    /// 操作 mCovisibilityCounter 的互斥锁,持有时不会再获取其他锁
+    std::mutex mMutexCovisibility;
+
+    // 从地图文件加载的关键帧延迟读取的数据
+    std::shared_ptr<MappedFile> mpMapFile;      ///< 映射的地图文件,描述子指向其中的数据
+    uint64_t mnFeaturesOffset;                  ///< 特征点等数据在文件中的位置
+    uint64_t mnFeaturesSize;                    ///< 特征点等数据的字节数
+    std::atomic<bool> mbFeaturesLoaded;         ///< 特征点等数据是否已经在内存中
+    std::mutex mMutexLoadFeatures;              ///< 读取特征点等数据时的互斥锁
 };
 
 } //namespace ORB_SLAM
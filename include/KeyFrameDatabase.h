@@ -41,6 +41,8 @@
 #include "ORBVocabulary.h"
 
 #include<mutex>
+#include<map>
+#include<iostream>
 
 
 namespace ORB_SLAM2
@@ -97,6 +99,19 @@ public:
    */
    std::vector<KeyFrame*> DetectRelocalizationCandidates(Frame* F);
 
+  /**
+   * @brief 保存倒排索引,只保存非空的单词
+   * @param[in] f 输出流
+   */
+   void Save(std::ostream &f);
+
+  /**
+   * @brief 读取Save()保存的倒排索引,不需要重新计算关键帧的词袋
+   * @param[in] f     输入流
+   * @param[in] mKFs  id到关键帧的映射
+   */
+   void Load(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs);
+
 protected:
 
   // Associated vocabulary
@@ -0,0 +1,110 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOCALBAWORKSPACE_H
+#define LOCALBAWORKSPACE_H
+
+#include <vector>
+
+#include "ThreadPool.h"
+#include "ThreadPoolExecutor.h"
+
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
+#include "Thirdparty/g2o/g2o/core/block_solver.h"
+#include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
+#include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief 局部BA的持久化工作空间
+ * @details 局部建图线程每插入一个关键帧就要做一次局部BA,每次都要 new 出几千个顶点、边和核函数,
+ * 优化结束后再全部 delete 掉,求解器内部的矩阵和缓冲区也要重新分配。
+ * 工作空间由局部建图线程持有,在多次局部BA之间复用这些对象:
+ * - 顶点、边和Huber核函数放在对象池中,Reset() 时只把它们从图中取下而不释放,下次直接取用;
+ * - 优化器、BlockSolver 和线性求解器一直存在,内部缓冲区(并行划分、Jacobian工作区等)的容量得以保留;
+ * - 稀疏矩阵的非零结构不变时(例如第二阶段只去掉了少量外点边),线性求解器沿用已有的符号分解(AMD排序和消元树)。
+ * @note 不是线程安全的,同一时刻只能被一个局部BA使用
+ */
+class LocalBAWorkspace
+{
+public:
+    /** @brief 构造函数,创建LM算法、BlockSolver_6_3 和 LinearSolverEigen */
+    LocalBAWorkspace();
+
+    /** @brief 析构函数,释放对象池中所有的顶点、边和核函数 */
+    ~LocalBAWorkspace();
+
+    /**
+     * @brief 开始一次新的局部BA:把上一次的顶点和边从优化器中取下,全部放回对象池
+     * @param[in] pThreadPool   线程池,不为NULL时在线程池上并行线性化和计算Schur补
+     * @param[in] pbStopFlag    外界设置的停止优化标志,可以为NULL
+     */
+    void Reset(ThreadPool* pThreadPool, bool* pbStopFlag);
+
+    /** @brief 返回持久化的优化器 */
+    g2o::SparseOptimizer& GetOptimizer();
+
+    /** @brief 从对象池中取一个位姿顶点,已经恢复为非固定状态 */
+    g2o::VertexSE3Expmap* NewVertexSE3();
+
+    /** @brief 从对象池中取一个地图点顶点,已经恢复为非边缘化状态 */
+    g2o::VertexSBAPointXYZ* NewVertexPoint();
+
+    /**
+     * @brief 从对象池中取一条单目投影边,并挂上阈值为 delta 的Huber核函数
+     * @note 核函数归工作空间所有,不能用 setRobustKernel() 替换或删除,要去掉核函数时调用 releaseRobustKernel()
+     */
+    g2o::EdgeSE3ProjectXYZ* NewEdgeMono(const double delta);
+
+    /** @brief 从对象池中取一条双目投影边,并挂上阈值为 delta 的Huber核函数,注意事项同 NewEdgeMono() */
+    g2o::EdgeStereoSE3ProjectXYZ* NewEdgeStereo(const double delta);
+
+protected:
+
+    /** @brief 把所有已取出的边的核函数取下,并清空优化器中的图,不释放任何对象 */
+    void ReleaseGraph();
+
+    ThreadPoolExecutor mExecutor;
+
+    g2o::SparseOptimizer mOptimizer;
+    g2o::BlockSolver_6_3* mpBlockSolver;
+
+    // 对象池,前 mnUsedXXX 个对象正在本次局部BA中使用
+    std::vector<g2o::VertexSE3Expmap*> mvpVerticesSE3;
+    size_t mnUsedVerticesSE3;
+
+    std::vector<g2o::VertexSBAPointXYZ*> mvpVerticesPoint;
+    size_t mnUsedVerticesPoint;
+
+    // 每条边在池中有一个对应的核函数
+    std::vector<g2o::EdgeSE3ProjectXYZ*> mvpEdgesMono;
+    std::vector<g2o::RobustKernelHuber*> mvpKernelsMono;
+    size_t mnUsedEdgesMono;
+
+    std::vector<g2o::EdgeStereoSE3ProjectXYZ*> mvpEdgesStereo;
+    std::vector<g2o::RobustKernelHuber*> mvpKernelsStereo;
+    size_t mnUsedEdgesStereo;
+};
+
+} //namespace ORB_SLAM
+
+#endif // LOCALBAWORKSPACE_H
@@ -39,8 +39,11 @@
 #include "LoopClosing.h"
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
+#include "ThreadPool.h"
+#include "LocalBAWorkspace.h"
 
 #include <mutex>
+#include <condition_variable>
 
 
 namespace ORB_SLAM2
@@ -74,6 +77,12 @@ public:
      */
     void SetTracker(Tracking* pTracker);
 
+    /**
+     * @brief 设置System中常驻的线程池句柄，局部BA在这个线程池上并行地线性化和计算Schur补
+     * @param[in] pThreadPool 线程池
+     */
+    void SetThreadPool(ThreadPool* pThreadPool);
+
     // Main function
     /** @brief 线程主函数 */
     void Run();
@@ -112,6 +121,8 @@ public:
     void SetAcceptKeyFrames(bool flag);
     /** @brief 设置 mbnotStop标志的状态 */
     bool SetNotStop(bool flag);
+    /** @brief 阻塞等待,直到局部建图线程响应停止请求真正停下来(或者线程已经结束) */
+    void WaitUntilStopped();
 
     /** @brief 外部线程调用,终止BA */
     void InterruptBA();
@@ -120,6 +131,8 @@ public:
     void RequestFinish();
     /** @brief 当前线程的run函数是否已经终止 */
     bool isFinished();
+    /** @brief 阻塞等待,直到当前线程的run函数终止 */
+    void WaitUntilFinished();
     //查看队列中等待插入的关键帧数目
     int KeyframesInQueue(){
         unique_lock<std::mutex> lock(mMutexNewKFs);
@@ -177,6 +190,18 @@ protected:
     /// 当前系统输入数单目还是双目RGB-D的标志
     bool mbMonocular;
 
+    /**
+     * @brief 唤醒所有在 mCondWakeUp 上等待的线程,在新关键帧、停止/释放、复位、终止等状态改变之后调用
+     * @note 调用时不能持有 mMutexNewKFs、mMutexStop、mMutexReset、mMutexFinish,等待的线程会在持有 mMutexWakeUp 时获取它们
+     */
+    void WakeUp();
+    /** @brief 是否有需要主循环处理的事件: 新的关键帧、可以响应的停止请求、复位请求或者终止请求 */
+    bool HasPendingEvents();
+    /// 线程状态改变的通知,替代原来每隔几毫秒的轮询
+    std::condition_variable mCondWakeUp;
+    /// 和 mCondWakeUp 配合使用的互斥量
+    std::mutex mMutexWakeUp;
+
     /** @brief 检查当前是否有复位线程的请求 */
     void ResetIfRequested();
     /// 当前系统是否收到了请求复位的信号
@@ -202,6 +227,10 @@ protected:
     LoopClosing* mpLoopCloser;
     // 追踪线程句柄
     Tracking* mpTracker;
+    // 线程池句柄，为NULL时局部BA串行计算
+    ThreadPool* mpThreadPool;
+    // 局部BA的工作空间，在多次局部BA之间复用优化器、顶点和边
+    LocalBAWorkspace mLocalBAWorkspace;
 
     // Tracking线程向LocalMapping中插入关键帧是先插入到该队列中
     std::list<KeyFrame*> mlNewKeyFrames; ///< 等待处理的关键帧列表
@@ -39,9 +39,11 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "ThreadPool.h"
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include "Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h"
 
 namespace ORB_SLAM2
@@ -81,6 +83,9 @@ public:
     /** @brief 设置局部建图线程的句柄
      * @param[in] pLocalMapper   */
     void SetLocalMapper(LocalMapping* pLocalMapper);
+    /** @brief 设置System中常驻的线程池句柄，全局BA在这个线程池上并行地线性化和计算Schur补
+     * @param[in] pThreadPool 线程池  */
+    void SetThreadPool(ThreadPool* pThreadPool);
 
     // Main function
     /** @brief 回环检测线程主函数 */
@@ -116,6 +121,9 @@ public:
     /** @brief 由外部线程调用,判断当前回环检测线程是否已经正确终止了  */
     bool isFinished();
 
+    /** @brief 由外部线程调用,阻塞等待直到回环检测线程终止,并且没有正在运行的全局BA */
+    void WaitUntilFinished();
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 protected:
@@ -174,6 +182,18 @@ protected:
     /// 和当前线程终止状态操作有关的互斥量
     std::mutex mMutexFinish;
 
+    /**
+     * @brief 唤醒所有在 mCondWakeUp 上等待的线程,在新关键帧、复位、终止、全局BA结束等状态改变之后调用
+     * @note 调用时不能持有 mMutexLoopQueue、mMutexReset、mMutexFinish、mMutexGBA
+     */
+    void WakeUp();
+    /** @brief 是否有需要主循环处理的事件: 新的关键帧、复位请求或者终止请求 */
+    bool HasPendingEvents();
+    /// 线程状态改变的通知,替代原来每隔几毫秒的轮询
+    std::condition_variable mCondWakeUp;
+    /// 和 mCondWakeUp 配合使用的互斥量
+    std::mutex mMutexWakeUp;
+
     /// (全局)地图的指针
     Map* mpMap;
     /// 追踪线程句柄
@@ -185,6 +205,8 @@ protected:
     ORBVocabulary* mpORBVocabulary;
     /// 局部建图线程句柄
     LocalMapping *mpLocalMapper;
+    /// 线程池句柄，为NULL时全局BA串行计算
+    ThreadPool* mpThreadPool;
 
     /// 一个队列, 其中存储了参与到回环检测的关键帧 (当然这些关键帧也有可能因为各种原因被设置成为bad,这样虽然这个关键帧还是存储在这里但是实际上已经不再实质性地参与到回环检测的过程中去了)
     std::list<KeyFrame*> mlpLoopKeyFrameQueue;
@@ -26,6 +26,8 @@
 #include <set>
 
 #include <mutex>
+#include <map>
+#include <iostream>
 
 
 
@@ -132,6 +134,19 @@ public:
     /** @brief 清空地图 */
     void clear();
 
+    /**
+     * @brief 保存地图本身的信息(初始关键帧),关键帧和地图点由System::SaveMap保存
+     * @param[in] f 输出流
+     */
+    void Save(std::ostream &f);
+
+    /**
+     * @brief 读取Save()保存的信息,关键帧需要已经加入地图
+     * @param[in] f     输入流
+     * @param[in] mKFs  id到关键帧的映射
+     */
+    void Load(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs);
+
     // 保存了最初始的关键帧
     vector<KeyFrame*> mvpKeyFrameOrigins;
 
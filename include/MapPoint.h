@@ -35,9 +35,14 @@
 #include"KeyFrame.h"
 #include"Frame.h"
 #include"Map.h"
+#include"ObservationMap.h"
 
 #include<opencv2/core/core.hpp>
+#include<Eigen/Core>
 #include<mutex>
+#include<map>
+#include<stdint.h>
+#include<iostream>
 
 
 namespace ORB_SLAM2
@@ -90,6 +95,16 @@ public:
      * @return cv::Mat 一个向量
      */
     cv::Mat GetNormal();
+    /**
+     * @brief 获取当前地图点在世界坐标系下的位置,不分配堆内存
+     * @return Eigen::Vector3f 位置
+     */
+    Eigen::Vector3f GetWorldPosEigen();
+    /**
+     * @brief 获取当前地图点的平均观测方向,不分配堆内存
+     * @return Eigen::Vector3f 一个向量
+     */
+    Eigen::Vector3f GetNormalEigen();
     /**
      * @brief 获取生成当前地图点的参考关键帧
      * @return KeyFrame* 
@@ -98,10 +113,17 @@ public:
 
     /**
      * @brief 获取观测到当前地图点的关键帧
-     * @return std::map<KeyFrame*,size_t> 观测到当前地图点的关键帧序列； 
-     *                                    size_t 这个对象对应为该地图点在该关键帧的特征点的访问id
+     * @return ObservationMap 观测到当前地图点的关键帧序列； 
+     *                        size_t 这个对象对应为该地图点在该关键帧的特征点的访问id
+     */
+    ObservationMap GetObservations();
+
+    /**
+     * @brief 获取观测到当前地图点的关键帧,复制到调用者提供的容器中
+     * @details 容器的内存会被复用,在循环中反复调用时不会分配内存
+     * @param[out] observations 观测到当前地图点的关键帧及特征点索引
      */
-    std::map<KeyFrame*,size_t> GetObservations();
+    void GetObservations(ObservationMap &observations);
     
     // 获取当前地图点的被观测次数
     int Observations();
@@ -225,6 +247,52 @@ public:
     //? 
     int PredictScale(const float &currentDist, Frame* pF);
 
+    /**
+     * @brief 保存地图点:位置、平均观测方向、描述子、尺度不变距离和参考关键帧id。观测由关键帧保存
+     * @param[in] f 输出流
+     */
+    void Save(std::ostream &f);
+
+    /**
+     * @brief 读取Save()保存的地图点,观测在KeyFrame::LoadLinks()中添加
+     * @param[in] f         输入流
+     * @param[in] pMap      地图
+     * @param[in] mKFs      id到关键帧的映射,用来找到参考关键帧
+     * @return MapPoint*    新建的地图点,读取失败时为NULL
+     */
+    static MapPoint* Load(std::istream &f, Map* pMap, const std::map<long unsigned int, KeyFrame*> &mKFs);
+
+protected:
+    /**
+     * @brief 加载地图时使用的构造函数,其他成员由Load()读取
+     * @param[in] nFirstKFid    创建该地图点的关键帧id
+     * @param[in] nFirstFrame   创建该地图点的帧id
+     * @param[in] pMap          地图
+     */
+    MapPoint(const long int &nFirstKFid, const long int &nFirstFrame, Map* pMap);
+
+    /**
+     * @brief 在描述子距离表中为新的观测插入一行,新的距离都标记为还没有计算,调用者需要持有 mMutexFeatures
+     * @param[in] pos   新观测在 mObservations 中的位置,调用前 mObservations 中已经有这个观测
+     */
+    void InsertDescriptorDistances(size_t pos);
+
+    /**
+     * @brief 从描述子距离表中删除一个观测的距离,调用者需要持有 mMutexFeatures
+     * @param[in] pos   观测在 mObservations 中的位置,调用前 mObservations 中已经删除了这个观测
+     */
+    void EraseDescriptorDistances(size_t pos);
+
+    /**
+     * @brief 增删关键帧 pKF 的观测时,更新 pKF 和其他观测关键帧之间的共视程度,调用者需要持有 mMutexFeatures
+     * @param[in] pKF   增加或者删除的观测关键帧,不在 mObservations 中时才计入
+     * @param[in] n     共视程度的变化量
+     */
+    void UpdateCovisibility(KeyFrame* pKF, int n);
+
+    /** @brief 地图点被删除或替换时,去掉观测关键帧两两之间由它带来的共视,调用者需要持有 mMutexFeatures */
+    void ClearCovisibility();
+
 public:
     long unsigned int mnId; ///< Global ID for MapPoint
     static long unsigned int nNextId;
@@ -283,21 +351,30 @@ protected:
 
     // Position in absolute coordinates
     cv::Mat mWorldPos; ///< MapPoint在世界坐标系下的坐标
+    Eigen::Vector3f mWorldPosEig; ///< 和 mWorldPos 相同,投影匹配等热点循环中使用
 
     // Keyframes observing the point and associated index in keyframe
     // 观测到该MapPoint的KF和该MapPoint在KF中的索引
-    std::map<KeyFrame*,size_t> mObservations; 
+    ObservationMap mObservations; 
 
     // Mean viewing direction
     // 该MapPoint平均观测方向
     // 用于判断点是否在可视范围内
     cv::Mat mNormalVector;
+    Eigen::Vector3f mNormalVectorEig; ///< 和 mNormalVector 相同
 
     // Best descriptor to fast matching
     // 每个3D点也有一个描述子，但是这个3D点可以观测多个二维特征点，从中选择一个最有代表性的
      //通过 ComputeDistinctiveDescriptors() 得到的最有代表性描述子,距离其它描述子的平均距离最小
     cv::Mat mDescriptor; 
 
+    // 各个观测的描述子两两之间的汉明距离,增删观测时增量维护,
+    // ComputeDistinctiveDescriptors 只需要计算新观测带来的那部分距离。
+    // 下标是观测在 mObservations 中的位置,描述子需要时直接从关键帧中取。
+    // 按行连续存储的严格下三角,第i个和第j个观测(i>j)的距离在 i*(i-1)/2+j
+    std::vector<uint16_t> mvDescDistances;              ///< 描述子之间的距离,0xFFFF表示还没有计算
+    bool mbDescriptorDirty;                             ///< 观测变化之后还没有重新选择 mDescriptor
+
     /// Reference KeyFrame
     // 通常情况下MapPoint的参考关键帧就是创建该MapPoint的那个关键帧
     KeyFrame* mpRefKF;
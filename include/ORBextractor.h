@@ -25,6 +25,8 @@
 #include <list>
 #include <opencv/cv.h>
 
+#include "ThreadPool.h"
+
 
 //这个文件主要负责进行ORB特征点的提取和数目分配功能
 
@@ -90,11 +92,18 @@ public:
      * @param[in] nlevels           指定需要提取特征点的图像金字塔层
      * @param[in] iniThFAST         初始的默认FAST响应值阈值
      * @param[in] minThFAST         较小的FAST响应值阈值
+     * @param[in] nThreads          并行处理金字塔各层时使用的线程数，小于等于1时串行处理
      */
-    ORBextractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAST, int minThFAST);
+    ORBextractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAST, int minThFAST, int nThreads=0);
 	
     /** @brief 析构函数 */
-    ~ORBextractor(){}
+    ~ORBextractor();
+
+    /**
+     * @brief 使用外部共享的线程池（例如System中的线程池）并行处理金字塔各层，代替自己创建的线程池
+     * @param[in] pThreadPool 线程池，为NULL时串行处理
+     */
+    void SetThreadPool(ThreadPool* pThreadPool);
 
     // Compute the ORB features and descriptors on an image.
     // ORB are dispersed on the image using an octree.
@@ -179,6 +188,13 @@ protected:
      */
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);    
 
+    /**
+     * @brief 计算某一层金字塔图像中的特征点：网格内提取FAST角点、八叉树均匀化、计算方向
+     * @param[in] level         金字塔层
+     * @param[out] keypoints    这一层中的特征点
+     */
+    void ComputeKeyPointsLevel(const int level, std::vector<cv::KeyPoint>& keypoints);
+
     /**
      * @brief 对于某一图层，分配其特征点，通过八叉树的方式
      * @param[in] vToDistributeKeys         等待分配的特征点
@@ -218,6 +234,9 @@ protected:
     std::vector<float> mvInvScaleFactor;        ///<以及每层缩放因子的倒数
     std::vector<float> mvLevelSigma2;		    ///<存储每层的sigma^2,即上面每层图像相对于底层图像缩放倍数的平方
     std::vector<float> mvInvLevelSigma2;	    ///<sigma平方的倒数
+
+    ThreadPool* mpThreadPool;                   ///<并行处理金字塔各层的线程池，为NULL时串行处理
+    bool mbOwnThreadPool;                       ///<线程池是否是自己创建的，是的话析构时需要释放
 };
 
 } //namespace ORB_SLAM
@@ -64,6 +64,25 @@ public:
      */
     static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
+    /**
+     * @brief 批量计算一个描述子与一块连续存储的候选描述子之间的汉明距离(1 vs N)
+     * 运行时根据CPU支持情况选择 AVX2 / POPCNT / 标量实现
+     * @param[in] a         查询描述子,1x32 CV_8U
+     * @param[in] B         候选描述子矩阵,每一行是一个描述子,Nx32 CV_8U
+     * @param[out] pDist    输出距离,长度至少为 B.rows
+     */
+    static void DescriptorDistances(const cv::Mat &a, const cv::Mat &B, int *pDist);
+
+    /**
+     * @brief 批量计算一个描述子与描述子矩阵中指定行之间的汉明距离,用于网格搜索得到候选点之后的匹配
+     * @param[in] a         查询描述子,1x32 CV_8U
+     * @param[in] B         描述子矩阵,例如 Frame::mDescriptors
+     * @param[in] vIndices  候选特征点在 B 中的行号
+     * @param[out] vDist    输出距离,vDist[k] 对应 vIndices[k]
+     */
+    static void DescriptorDistances(const cv::Mat &a, const cv::Mat &B,
+                                    const std::vector<size_t> &vIndices, std::vector<int> &vDist);
+
     // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
     // Used to track the local map (Tracking)
     /**
@@ -143,9 +162,10 @@ public:
     * @param  pKF               KeyFrame
     * @param  F                 Current Frame
     * @param  vpMapPointMatches F中MapPoints对应的匹配，NULL表示未匹配
+    * @param  pvMatchDistances  不为NULL时输出每个匹配的描述子距离,下标和匹配结果一致,供PnPsolver的PROSAC排序使用
     * @return                   成功匹配的数量
     */
-    int SearchByBoW(KeyFrame *pKF, Frame &F, std::vector<MapPoint*> &vpMapPointMatches);
+    int SearchByBoW(KeyFrame *pKF, Frame &F, std::vector<MapPoint*> &vpMapPointMatches, std::vector<int> *pvMatchDistances = NULL);
     int SearchByBoW(KeyFrame *pKF1, KeyFrame* pKF2, std::vector<MapPoint*> &vpMatches12);
 
     // Matching for the Map Initialization (only used in the monocular case)
@@ -207,6 +227,25 @@ public:
      */
     int Fuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, const float th=3.0);
 
+    /**
+     * @brief Fuse 的匹配部分,只寻找每个地图点在关键帧中的最佳匹配,不修改关键帧和地图点
+     * @param[in] pKF            关键帧
+     * @param[in] vpMapPoints    待投影的地图点
+     * @param[out] vnMatchedIdx  每个地图点匹配到的特征点索引,没有匹配为-1
+     * @param[in] th             搜索窗口的阈值
+     * @return int               匹配到的地图点数目
+     */
+    int SearchForFuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, vector<int> &vnMatchedIdx, const float th=3.0);
+
+    /**
+     * @brief Fuse 的融合部分,按顺序把 SearchForFuse 的匹配结果融合到关键帧中
+     * @param[in] pKF            关键帧
+     * @param[in] vpMapPoints    待投影的地图点
+     * @param[in] vnMatchedIdx   SearchForFuse 得到的匹配
+     * @return int               更新地图点的数量
+     */
+    int FuseMatches(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, const vector<int> &vnMatchedIdx);
+
     // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints.
     /**
      * @brief 将地图点投影到关键帧中进行,但是由于种种原因,地图点还不能够在这个函数中完成替换操作
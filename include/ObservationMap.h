@@ -0,0 +1,112 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OBSERVATIONMAP_H
+#define OBSERVATIONMAP_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+namespace ORB_SLAM2
+{
+
+class KeyFrame;
+
+/**
+ * @brief 地图点的观测: 关键帧 -> 地图点在关键帧中的特征点索引
+ * @details 按关键帧指针排序的连续数组,接口和 std::map<KeyFrame*,size_t> 一致,遍历顺序也一致。
+ * 一个地图点的观测一般只有几个到几十个,二分查找和插入时移动元素都很快,
+ * 比红黑树省内存(每个观测16字节,没有节点开销),遍历时也不会在堆上到处跳。
+ * 赋值时会复用已有的内存,所以在循环外定义、循环内反复用 MapPoint::GetObservations(ObservationMap&) 取快照不会分配内存
+ */
+class ObservationMap
+{
+public:
+    typedef std::pair<KeyFrame*,size_t> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    iterator begin() { return mvObservations.begin(); }
+    iterator end() { return mvObservations.end(); }
+    const_iterator begin() const { return mvObservations.begin(); }
+    const_iterator end() const { return mvObservations.end(); }
+
+    size_t size() const { return mvObservations.size(); }
+    bool empty() const { return mvObservations.empty(); }
+    void clear() { mvObservations.clear(); }
+    void reserve(size_t n) { mvObservations.reserve(n); }
+
+    /** @brief 查找关键帧的观测,没有时返回 end() */
+    iterator find(KeyFrame* pKF)
+    {
+        iterator it = LowerBound(pKF);
+        return (it!=mvObservations.end() && it->first==pKF) ? it : mvObservations.end();
+    }
+
+    const_iterator find(KeyFrame* pKF) const
+    {
+        return const_cast<ObservationMap*>(this)->find(pKF);
+    }
+
+    /** @brief 关键帧是否观测到了该地图点,返回0或1 */
+    size_t count(KeyFrame* pKF) const
+    {
+        return find(pKF)!=mvObservations.end() ? 1 : 0;
+    }
+
+    /** @brief 取得关键帧的特征点索引,没有时插入一个索引为0的观测 */
+    size_t& operator[](KeyFrame* pKF)
+    {
+        iterator it = LowerBound(pKF);
+        if(it==mvObservations.end() || it->first!=pKF)
+            it = mvObservations.insert(it,value_type(pKF,0));
+        return it->second;
+    }
+
+    /** @brief 删除关键帧的观测,返回删除的个数 */
+    size_t erase(KeyFrame* pKF)
+    {
+        iterator it = find(pKF);
+        if(it==mvObservations.end())
+            return 0;
+        mvObservations.erase(it);
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        return mvObservations.erase(it);
+    }
+
+private:
+    iterator LowerBound(KeyFrame* pKF)
+    {
+        return std::lower_bound(mvObservations.begin(),mvObservations.end(),pKF,
+                                [](const value_type &obs, KeyFrame* pKF){ return obs.first<pKF; });
+    }
+
+    std::vector<value_type> mvObservations;
+};
+
+} //namespace ORB_SLAM
+
+#endif // OBSERVATIONMAP_H
@@ -37,6 +37,7 @@
 #include "KeyFrame.h"
 #include "LoopClosing.h"
 #include "Frame.h"
+#include "ThreadPool.h"
 
 #include "Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h"
 
@@ -44,6 +45,7 @@ namespace ORB_SLAM2
 {
 
 class LoopClosing;
+class LocalBAWorkspace;
 
 /** @brief 优化器,所有的优化相关的函数都在这个类中; 并且这个类只有成员函数没有成员变量,相对要好分析一点 */
 class Optimizer
@@ -70,10 +72,11 @@ public:
      *          pbStopFlag  是否强制暂停
      *          nLoopKF  关键帧的个数 -- 但是我觉得形成了闭环关系的当前关键帧的id
      *          bRobust  是否使用核函数
+     *          pThreadPool 线程池，不为NULL时在线程池上并行线性化和计算Schur补
      */
     void static BundleAdjustment(const std::vector<KeyFrame*> &vpKF, const std::vector<MapPoint*> &vpMP,
                                  int nIterations = 5, bool *pbStopFlag=NULL, const unsigned long nLoopKF=0,
-                                 const bool bRobust = true);
+                                 const bool bRobust = true, ThreadPool* pThreadPool=NULL);
 
     /**
      * @brief 进行全局BA优化，但主要功能还是调用 BundleAdjustment,这个函数相当于加了一个壳.
@@ -82,9 +85,11 @@ public:
      * @param[in] pbStopFlag    外界给的控制GBA停止的标志位
      * @param[in] nLoopKF       当前回环关键帧的id，其实也就是参与GBA的关键帧个数
      * @param[in] bRobust       是否使用鲁棒核函数
+     * @param[in] pThreadPool   线程池，不为NULL时在线程池上并行线性化和计算Schur补
      */
     void static GlobalBundleAdjustemnt(Map* pMap, int nIterations=5, bool *pbStopFlag=NULL,
-                                       const unsigned long nLoopKF=0, const bool bRobust = true);
+                                       const unsigned long nLoopKF=0, const bool bRobust = true,
+                                       ThreadPool* pThreadPool=NULL);
 
     
 /**
@@ -107,9 +112,12 @@ public:
  * @param pKF        KeyFrame
  * @param pbStopFlag 是否停止优化的标志
  * @param pMap       在优化后，更新状态时需要用到Map的互斥量mMutexMapUpdate
+ * @param pThreadPool 线程池，不为NULL时在线程池上并行线性化和计算Schur补
+ * @param pWorkspace 持久化的工作空间，复用其中的优化器、顶点和边；为NULL时使用本次调用的临时工作空间
  * @note 由局部建图线程调用,对局部地图进行优化的函数
  */
-    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap);
+    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, ThreadPool* pThreadPool=NULL,
+                                      LocalBAWorkspace* pWorkspace=NULL);
 
     /**
      * @brief Pose Only Optimization
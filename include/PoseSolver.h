@@ -0,0 +1,126 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSESOLVER_H
+#define POSESOLVER_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief 只优化相机位姿的求解器,用于 Optimizer::PoseOptimization
+ * @details 和原来用g2o搭建的只有一个位姿顶点的图在数学上完全相同:误差、雅克比、Huber核函数、Levenberg阻尼的更新
+ * 策略和终止条件都和 g2o::OptimizationAlgorithmLevenberg + EdgeSE3ProjectXYZOnlyPose/EdgeStereoSE3ProjectXYZOnlyPose
+ * 一致,但是正规方程直接用固定大小的6x6矩阵求解,不需要创建图、顶点、边和稀疏矩阵。
+ * 观测保存在vector中,Clear()只清空不释放,同一个线程反复使用同一个求解器时不会再分配内存
+ */
+class PoseSolver
+{
+public:
+
+    /** @brief 一个地图点的观测 */
+    struct Observation
+    {
+        double Xw[3];           ///< 地图点的世界坐标
+        double obs[3];          ///< 观测:u,v,以及双目时的右目u
+        double invSigma2;       ///< 信息矩阵的对角元素
+        double err[3];          ///< 最近一次计算的误差
+        double chi2;            ///< 最近一次计算的误差平方(乘了信息矩阵)
+        bool bStereo;           ///< 是否是双目观测
+        bool bOutlier;          ///< 是否是外点,外点不参与优化
+    };
+
+    PoseSolver();
+
+    /**
+     * @brief 清空所有观测并设置相机参数,已经分配的内存会保留
+     * @param[in] fx,fy,cx,cy   相机内参
+     * @param[in] bf            基线乘以焦距,只用于双目观测
+     */
+    void Reset(double fx, double fy, double cx, double cy, double bf);
+
+    /** @brief 添加单目观测 */
+    void AddMonoObservation(const double Xw[3], double u, double v, double invSigma2);
+
+    /** @brief 添加双目观测 */
+    void AddStereoObservation(const double Xw[3], double u, double v, double ur, double invSigma2);
+
+    /**
+     * @brief 4轮优化,每轮从初始位姿开始迭代10次,然后按卡方阈值重新区分内外点,最后一轮不使用核函数
+     * @param[in,out] Tcw   输入初始位姿,输出优化后的位姿
+     * @return int          最后一轮之后外点的个数
+     */
+    int Optimize(g2o::SE3Quat &Tcw);
+
+    /** @brief 观测个数 */
+    size_t NumObservations() const { return mvObservations.size(); }
+
+    /** @brief 第i个观测(按添加的顺序)是否为外点 */
+    bool IsOutlier(size_t i) const { return mvObservations[i].bOutlier; }
+
+protected:
+
+    typedef Eigen::Matrix<double,6,6> Matrix6d;
+    typedef Eigen::Matrix<double,6,1> Vector6d;
+
+    /**
+     * @brief 在给定位姿下计算所有内点(或者所有外点)的误差
+     * @param[in] Tcw       位姿
+     * @param[in] bOutliers false时计算内点,true时计算外点
+     * @return double       内点经过核函数之后的误差之和
+     */
+    double ComputeErrors(const g2o::SE3Quat &Tcw, bool bOutliers);
+
+    /** @brief 用内点在给定位姿下的误差和雅克比构造正规方程 H x = b */
+    void BuildSystem(const g2o::SE3Quat &Tcw);
+
+    /**
+     * @brief 和 g2o::OptimizationAlgorithmLevenberg 相同的LM迭代
+     * @param[in,out] Tcw       位姿
+     * @param[in] nIterations   最大迭代次数
+     * @return g2o::SE3Quat     最后一次计算误差时的位姿,g2o中边的误差停留在这个位姿上
+     */
+    g2o::SE3Quat Levenberg(g2o::SE3Quat &Tcw, int nIterations);
+
+    // 相机内参
+    double fx, fy, cx, cy, bf;
+
+    // 当前是否使用Huber核函数
+    bool mbRobust;
+
+    std::vector<Observation> mvObservations;
+
+    // 正规方程,mx在多次求解之间保留,和g2o在Cholesky分解失败时的行为一致
+    Matrix6d mH;
+    Vector6d mb;
+    Vector6d mx;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //namespace ORB_SLAM
+
+#endif // POSESOLVER_H
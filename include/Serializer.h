@@ -0,0 +1,181 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+
+#include "Thirdparty/DBoW2/DBoW2/BowVector.h"
+#include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief 地图保存和加载时用到的二进制读写函数
+ * @details 和Converter一样是一个完全的静态类。数据按本机字节序写出，所以地图文件只能在相同架构的机器之间使用。
+ * 读取失败时流会被置为fail状态，调用者在读完一段数据后检查流的状态即可
+ */
+class Serializer
+{
+public:
+
+    /** @brief 写入一个POD类型的值 */
+    template<class T>
+    static void Write(std::ostream &f, const T &value)
+    {
+        f.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    /** @brief 读取一个POD类型的值 */
+    template<class T>
+    static void Read(std::istream &f, T &value)
+    {
+        f.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    /** @brief 写入POD类型的vector,先写元素个数 */
+    template<class T>
+    static void WriteVector(std::ostream &f, const std::vector<T> &v)
+    {
+        const uint64_t n = v.size();
+        Write(f,n);
+        if(n>0)
+            f.write(reinterpret_cast<const char*>(&v[0]), n*sizeof(T));
+    }
+
+    /** @brief 读取POD类型的vector */
+    template<class T>
+    static void ReadVector(std::istream &f, std::vector<T> &v)
+    {
+        uint64_t n = 0;
+        Read(f,n);
+        v.clear();
+        if(n==0 || !CheckAvailable(f,n,sizeof(T)))
+            return;
+        v.resize(n);
+        f.read(reinterpret_cast<char*>(&v[0]), n*sizeof(T));
+    }
+
+    /**
+     * @brief 检查流中是否还剩下n个大小为elemSize的元素,在按文件中的长度分配内存之前调用
+     * @details 地图文件损坏或者被截断时,读出来的长度可能非常大,直接 resize() 会抛出 bad_alloc 或者分配大量内存。
+     * 剩余的字节不够时把流置为fail状态,调用者照常检查流的状态就可以发现错误
+     * @param[in] f         输入流
+     * @param[in] n         元素个数
+     * @param[in] elemSize  每个元素的字节数
+     * @return true         剩余的字节足够,或者无法知道剩余的字节数
+     */
+    static bool CheckAvailable(std::istream &f, uint64_t n, size_t elemSize);
+
+    /**
+     * @brief 写入cv::Mat,支持任意类型和通道数的二维矩阵,空矩阵也可以写入
+     * @param[in] f     输出流
+     * @param[in] m     矩阵
+     */
+    static void WriteMat(std::ostream &f, const cv::Mat &m);
+
+    /**
+     * @brief 读取WriteMat写入的cv::Mat
+     * @param[in] f     输入流
+     * @param[out] m    矩阵
+     */
+    static void ReadMat(std::istream &f, cv::Mat &m);
+
+    /** @brief 写入特征点 */
+    static void WriteKeyPoints(std::ostream &f, const std::vector<cv::KeyPoint> &vKeys);
+
+    /** @brief 读取特征点 */
+    static void ReadKeyPoints(std::istream &f, std::vector<cv::KeyPoint> &vKeys);
+
+    /** @brief 写入词袋向量 */
+    static void WriteBowVector(std::ostream &f, const DBoW2::BowVector &v);
+
+    /** @brief 读取词袋向量 */
+    static void ReadBowVector(std::istream &f, DBoW2::BowVector &v);
+
+    /** @brief 写入特征向量 */
+    static void WriteFeatureVector(std::ostream &f, const DBoW2::FeatureVector &v);
+
+    /** @brief 读取特征向量 */
+    static void ReadFeatureVector(std::istream &f, DBoW2::FeatureVector &v);
+};
+
+/**
+ * @brief 只读的内存映射文件
+ * @details 映射在析构时释放,所以所有指向映射的数据(例如关键帧的描述子)都要持有它的shared_ptr
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * @brief 以只读方式映射整个文件
+     * @param[in] filename  文件名
+     * @return true         映射成功
+     */
+    bool Open(const std::string &filename);
+
+    /** @brief 映射的起始地址 */
+    const char* Data() const { return mpData; }
+
+    /** @brief 映射的字节数 */
+    size_t Size() const { return mnSize; }
+
+protected:
+    // 不允许拷贝,否则会重复释放映射
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* mpData;
+    size_t mnSize;
+};
+
+/**
+ * @brief 在一段内存上读数据的streambuf,不拷贝数据,用于直接用Serializer的函数读取映射文件中的内容
+ * @code
+ *   MemoryBuffer buf(p,n);
+ *   std::istream f(&buf);
+ * @endcode
+ */
+class MemoryBuffer : public std::streambuf
+{
+public:
+    MemoryBuffer(const char* pData, size_t nSize)
+    {
+        char* p = const_cast<char*>(pData);
+        setg(p,p,p+nSize);
+    }
+
+    /** @brief 还没有读取的字节数 */
+    size_t Remaining() const { return egptr()-gptr(); }
+};
+
+}// namespace ORB_SLAM
+
+#endif // SERIALIZER_H
@@ -29,6 +29,9 @@
 //一些公用库的支持，字符串操作，多线程操作，以及opencv库等
 #include <string>
 #include <thread>
+#include <list>
+#include <future>
+#include <condition_variable>
 #include <opencv2/core/core.hpp>
 
 //下面则是本ORB-SLAM2系统中的其他模块
@@ -41,6 +44,7 @@
 #include "KeyFrameDatabase.h"
 #include "ORBVocabulary.h"
 #include "Viewer.h"
+#include "ThreadPool.h"
 
 namespace ORB_SLAM2
 {
@@ -100,6 +104,28 @@ public:
     cv::Mat TrackMonocular(const cv::Mat &im,           //图像
                            const double &timestamp);    //时间戳
 
+    // Pipelined tracking (opt-in). The frame is built on the calling thread (features extracted,
+    // stereo matched) and queued, while a dedicated thread tracks the previous frame. The pose is
+    // delivered through the returned future, in submission order. At most one built frame waits in
+    // the queue: if tracking falls behind, the call blocks until the queued frame is taken.
+    // Do not mix with the synchronous calls above: those first wait for the pipeline to drain.
+    // 流水线跟踪接口：调用线程构造第N+1帧(特征提取、双目匹配)的同时，后台线程跟踪第N帧。
+    // 返回的future按提交顺序得到相机位姿(跟踪失败时为空)
+    std::future<cv::Mat> TrackStereoAsync(const cv::Mat &imLeft,    //左目图像
+                                          const cv::Mat &imRight,   //右目图像
+                                          const double &timestamp); //时间戳
+
+    std::future<cv::Mat> TrackRGBDAsync(const cv::Mat &im,          //彩色图像
+                                        const cv::Mat &depthmap,    //深度图像
+                                        const double &timestamp);   //时间戳
+
+    // In monocular the extractor (initialization or normal) is chosen from the state of the last
+    // tracked frame, so right after initialization one more frame may be built with the
+    // initialization extractor.
+    // 单目时根据最近一个已跟踪帧的状态选择特征提取器，所以初始化成功后可能还有一帧使用初始化提取器
+    std::future<cv::Mat> TrackMonocularAsync(const cv::Mat &im,         //图像
+                                             const double &timestamp);  //时间戳
+
     // This stops local mapping thread (map building) and performs only camera tracking.
     //使能定位模式，此时仅有运动追踪部分在工作，局部建图功能则不工作
     void ActivateLocalizationMode();
@@ -143,10 +169,18 @@ public:
     // 以KITTI格式保存相机的运行轨迹
     void SaveTrajectoryKITTI(const string &filename);
 
-    // TODO: Save/Load functions
-    // 在这里可以实现自己的地图保存和加载函数
-    // SaveMap(const string &filename);
-    // LoadMap(const string &filename);
+    // Save the map (KeyFrames, MapPoints, covisibility graph, spanning tree, loop edges and
+    // the KeyFrameDatabase) in a binary file. Call first Shutdown()
+    // 以二进制格式保存地图,词袋和倒排索引一起保存,加载时不需要重新计算
+    bool SaveMap(const string &filename);
+
+    // Load a map saved by SaveMap(). Call it right after the constructor, before the first image.
+    // The vocabulary and the sensor type must be the same used when saving. The tracker starts
+    // LOST, so the first images are relocalized against the loaded map.
+    // The file is memory-mapped: KeyFrame keypoints, descriptors and feature vectors are only read
+    // when the KeyFrame is used, so it must not be modified in place while the map is in use.
+    // 加载SaveMap()保存的地图,失败时地图为空,系统和刚构造时一样
+    bool LoadMap(const string &filename);
 
     // Information from most recent processed frame
     // You can call this right after TrackMonocular (or stereo or RGBD)
@@ -157,6 +191,26 @@ public:
 
 private:
 
+    // 流水线中等待跟踪的一帧
+    struct TrackingJob
+    {
+        Frame frame;                        ///< 已经构造好的帧
+        cv::Mat imGray;                     ///< 该帧的灰度图像，用于帧绘制器显示
+        std::promise<cv::Mat> promise;      ///< 跟踪完成后写入相机位姿
+    };
+
+    // 如果有模式切换或复位请求，先等待流水线清空，再在调用线程中执行这些请求
+    void CheckPendingRequests();
+
+    // 把构造好的帧放入流水线，第一次调用时启动跟踪线程
+    std::future<cv::Mat> PushTrackingJob(const Frame &frame, const cv::Mat &imGray);
+
+    // 流水线跟踪线程的主函数
+    void RunTrackingPipeline();
+
+    // 等待流水线中所有的帧都跟踪完毕
+    void WaitTrackingPipeline();
+
     //注意变量命名方式，类的变量有前缀m，如果这个变量是指针类型还要多加个前缀p，
     //如果是进程那么加个前缀t
 
@@ -200,6 +254,10 @@ private:
     //地图绘制器
     MapDrawer* mpMapDrawer;
 
+    // Thread pool shared by the tracking hot paths. Lives as long as the System.
+    // 常驻的线程池，Tracking等模块中可以并行的部分都提交到这里，而不是每次都创建新的线程
+    ThreadPool* mpThreadPool;
+
 
     // System threads: Local Mapping, Loop Closing, Viewer.
     // The Tracking thread "lives" in the main execution thread that creates the System object.
@@ -225,6 +283,15 @@ private:
     std::vector<MapPoint*> mTrackedMapPoints;
     std::vector<cv::KeyPoint> mTrackedKeyPointsUn;
     std::mutex mMutexState;
+
+    // Pipelined tracking. The thread is only launched by the first Track*Async call.
+    // 流水线跟踪，只有调用Track*Async时才会启动跟踪线程
+    std::thread* mptTrackingPipeline;
+    std::list<TrackingJob*> mlpTrackingJobs;    ///< 已经构造好、等待跟踪的帧
+    bool mbTrackingJobRunning;                  ///< 跟踪线程是否正在跟踪一帧
+    bool mbFinishPipeline;                      ///< 请求跟踪线程退出
+    std::mutex mMutexPipeline;
+    std::condition_variable mCondPipeline;
 };
 
 }// namespace ORB_SLAM
@@ -0,0 +1,131 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief 固定线程数的work-stealing线程池
+ * @details 线程在构造时创建,析构时退出,避免每帧都去创建/销毁线程。每个工作线程有自己的任务队列:
+ * 工作线程提交的任务放到自己队列的尾部并优先从尾部取(局部性好),空闲时从其他线程队列的头部"偷"任务;
+ * 非工作线程(例如Tracking线程)提交的任务轮流放到各个队列中。
+ * ParallelFor 的调用线程自己也会参与计算,所以在任务内部再次调用 ParallelFor 也不会死锁;
+ * Submit 返回的future则不能在任务内部等待,见 Submit() 的说明
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] nThreads  工作线程的个数,为0时所有任务都在调用线程中直接执行
+     */
+    ThreadPool(int nThreads);
+
+    /** @brief 析构函数,执行完剩余的任务后等待所有工作线程退出 */
+    ~ThreadPool();
+
+    /**
+     * @brief 提交一个任务
+     * @details 和 ParallelFor 不同,等待返回的future时调用线程不会帮忙执行队列中的任务。
+     * 所以不要在线程池的任务内部等待这个future(get()/wait()),所有工作线程都这样等待时会死锁;
+     * 只在非工作线程(例如Tracking线程)中等待,或者在任务内部改用 ParallelFor
+     * @param[in] func  任务函数,不带参数
+     * @return 用来获取任务返回值的future
+     */
+    template<class F>
+    std::future<typename std::result_of<F()>::type> Submit(F func)
+    {
+        typedef typename std::result_of<F()>::type R;
+        // packaged_task 不能拷贝,而任务队列中的 std::function 要求可拷贝,所以用shared_ptr包一层
+        std::shared_ptr<std::packaged_task<R()> > pTask = std::make_shared<std::packaged_task<R()> >(func);
+        std::future<R> result = pTask->get_future();
+        if(mvThreads.empty())
+            (*pTask)();
+        else
+            Push([pTask](){ (*pTask)(); });
+        return result;
+    }
+
+    /**
+     * @brief 对 [0,n) 中的每个索引调用一次 func,所有索引都完成后才返回
+     * @details 每个索引只会被执行一次,但执行的线程和先后顺序不确定,所以 func 只能写入和索引对应的输出
+     * @param[in] n     索引个数
+     * @param[in] func  对每个索引执行的函数
+     */
+    void ParallelFor(int n, const std::function<void(int)> &func);
+
+    /** @brief 工作线程的个数 */
+    int GetNumThreads() const;
+
+protected:
+
+    /** @brief 每个工作线程的任务队列 */
+    struct WorkQueue
+    {
+        std::mutex mMutex;
+        std::deque<std::function<void()> > mdTasks;
+    };
+
+    /**
+     * @brief 把任务放入队列并唤醒一个空闲的工作线程
+     * @param[in] task  任务
+     */
+    void Push(const std::function<void()> &task);
+
+    /**
+     * @brief 取一个任务:先从自己队列的尾部取,没有的话再从其他队列的头部偷
+     * @param[in] id        工作线程的编号,非工作线程为-1
+     * @param[out] task     取到的任务
+     * @return true         取到了任务
+     */
+    bool Pop(int id, std::function<void()> &task);
+
+    /**
+     * @brief 工作线程的主函数
+     * @param[in] id    工作线程的编号
+     */
+    void Run(int id);
+
+    std::vector<std::thread> mvThreads;             ///< 工作线程
+    std::vector<WorkQueue*> mvpQueues;              ///< 每个工作线程的任务队列
+    std::atomic<unsigned int> mnNextQueue;          ///< 非工作线程提交任务时轮流使用的队列编号
+    std::atomic<int> mnPending;                     ///< 所有队列中待执行的任务总数
+
+    std::mutex mMutexSleep;                         ///< 空闲线程休眠用的互斥锁
+    std::condition_variable mCondSleep;             ///< 有新任务或者需要退出时通知空闲的工作线程
+    bool mbStop;                                    ///< 线程池是否正在析构
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
@@ -0,0 +1,62 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOLEXECUTOR_H
+#define THREADPOOLEXECUTOR_H
+
+#include "ThreadPool.h"
+
+#include "Thirdparty/g2o/g2o/core/parallel_executor.h"
+
+namespace ORB_SLAM2
+{
+
+/**
+ * @brief 把ThreadPool包装成g2o的ParallelExecutor，g2o的BlockSolver用它并行地线性化各条边和计算Schur补
+ */
+class ThreadPoolExecutor : public g2o::ParallelExecutor
+{
+public:
+    ThreadPoolExecutor(ThreadPool* pThreadPool):mpThreadPool(pThreadPool){}
+
+    /** @brief 更换使用的线程池 */
+    void SetThreadPool(ThreadPool* pThreadPool)
+    {
+        mpThreadPool = pThreadPool;
+    }
+
+    virtual void parallelFor(int n, const g2o::ParallelLoopBody &body)
+    {
+        mpThreadPool->ParallelFor(n, [&body](int i){ body(i); });
+    }
+
+    // 调用ParallelFor的线程自己也参与计算
+    virtual int numThreads() const
+    {
+        return mpThreadPool->GetNumThreads()+1;
+    }
+
+protected:
+    ThreadPool* mpThreadPool;
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOLEXECUTOR_H
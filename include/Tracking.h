@@ -115,6 +115,51 @@ public:
      */
     cv::Mat GrabImageMonocular(const cv::Mat &im, const double &timestamp);
 
+    // Split of GrabImage*() used by the pipelined interface of System: the frame can be built
+    // (features extracted, stereo matched) on another thread while the previous one is being tracked.
+    // 下面的函数把GrabImage*拆成"构造帧"和"跟踪"两步，供System的流水线跟踪接口使用
+    /**
+     * @brief 将双目图像转为灰度图像并构造Frame，不进行跟踪
+     *
+     * @param[in] imRectLeft    左目图像
+     * @param[in] imRectRight   右目图像
+     * @param[in] timestamp     时间戳
+     * @param[out] imGray       左目灰度图像
+     * @return Frame            构造好的双目帧
+     */
+    Frame CreateFrameStereo(const cv::Mat &imRectLeft,const cv::Mat &imRectRight, const double &timestamp, cv::Mat &imGray);
+
+    /**
+     * @brief 将RGBD图像转为灰度图像、将深度图转为真实尺度并构造Frame，不进行跟踪
+     *
+     * @param[in] imRGB         彩色图像
+     * @param[in] imD           深度图像
+     * @param[in] timestamp     时间戳
+     * @param[out] imGray       灰度图像
+     * @return Frame            构造好的RGBD帧
+     */
+    Frame CreateFrameRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, cv::Mat &imGray);
+
+    /**
+     * @brief 将单目图像转为灰度图像并构造Frame，不进行跟踪
+     *
+     * @param[in] im            单目图像
+     * @param[in] timestamp     时间戳
+     * @param[in] bInitializing 是否处于初始化阶段，初始化阶段使用提取2倍特征点的初始化提取器
+     * @param[out] imGray       灰度图像
+     * @return Frame            构造好的单目帧
+     */
+    Frame CreateFrameMonocular(const cv::Mat &im, const double &timestamp, const bool bInitializing, cv::Mat &imGray);
+
+    /**
+     * @brief 跟踪一个已经构造好的帧
+     *
+     * @param[in] frame     由CreateFrame*构造好的帧
+     * @param[in] imGray    该帧的灰度图像，用于帧绘制器显示
+     * @return cv::Mat      世界坐标系到该帧相机坐标系的变换矩阵
+     */
+    cv::Mat TrackFrame(const Frame &frame, const cv::Mat &imGray);
+
     /**
      * @brief 设置局部地图句柄
      * 
@@ -136,6 +181,13 @@ public:
      */
     void SetViewer(Viewer* pViewer);
 
+    /**
+     * @brief 设置System中常驻的线程池句柄，双目特征提取、单目初始化等耗时操作会提交到这个线程池中
+     * 
+     * @param[in] pThreadPool 线程池
+     */
+    void SetThreadPool(ThreadPool* pThreadPool);
+
     // Load new settings
     // The focal length should be similar or scale prediction will fail when projecting points
     // TODO: Modify MapPoint::PredictScale to take into account focal lenght
@@ -276,6 +328,19 @@ protected:
     /** @brief 重定位模块 */
     bool Relocalization();
 
+    /**
+     * @brief 用一个候选关键帧的EPnP结果优化帧的位姿,内点不够时再用投影匹配补充匹配点,即重定位中的 Step 4.2 ~ 4.4
+     * @details 只读写传入的帧 F,不修改Tracking的成员,可以对不同的帧在多个线程中同时调用
+     * @param[in] F                     待重定位的帧,会被设置位姿和匹配的地图点
+     * @param[in] pKF                   候选关键帧
+     * @param[in] Tcw                   EPnP估计的位姿
+     * @param[in] vbInliers             EPnP的内点标记
+     * @param[in] vpMapPointMatches     帧和候选关键帧的词袋匹配结果
+     * @return int                      优化后的内点数目,不少于50时认为重定位成功
+     */
+    int RefineRelocalization(Frame &F, KeyFrame* pKF, const cv::Mat &Tcw, const std::vector<bool> &vbInliers,
+                             const std::vector<MapPoint*> &vpMapPointMatches);
+
     /**
      * @brief 更新局部地图 LocalMap
      *
@@ -353,6 +418,8 @@ protected:
     ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
     ///在初始化的时候使用的特征点提取器,其提取到的特征点个数会更多
     ORBextractor* mpIniORBextractor;
+    ///是否并行处理金字塔各层(配置文件中 ORBextractor.nThreads>1)
+    bool mbParallelExtraction;
 
     //BoW 词袋模型相关
     ///ORB特征字典
@@ -364,6 +431,9 @@ protected:
     /// 单目初始器
     Initializer* mpInitializer;
 
+    ///System中常驻的线程池
+    ThreadPool* mpThreadPool;
+
     //Local Map 局部地图相关
     ///参考关键帧
     KeyFrame* mpReferenceKF;// 当前关键帧就是参考帧
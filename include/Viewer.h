@@ -39,6 +39,7 @@
 #include "System.h"
 
 #include <mutex>
+#include <condition_variable>
 
 namespace ORB_SLAM2
 {
@@ -80,6 +81,10 @@ public:
     bool isStopped();
     /** @brief 释放变量，避免互斥关系 */
     void Release();
+    /** @brief 阻塞等待,直到查看器响应停止请求暂停更新 */
+    void WaitUntilStopped();
+    /** @brief 阻塞等待,直到查看器进程的主函数执行完毕 */
+    void WaitUntilFinished();
 
 private:
 
@@ -136,6 +141,16 @@ private:
     ///用于锁住stop,停止更新变量相关的互斥量
     std::mutex mMutexStop;
 
+    /**
+     * @brief 唤醒所有在 mCondWakeUp 上等待的线程,在停止、释放、终止状态改变之后调用
+     * @note 调用时不能持有 mMutexStop 和 mMutexFinish
+     */
+    void WakeUp();
+    ///状态改变的通知,替代原来每隔几毫秒的轮询
+    std::condition_variable mCondWakeUp;
+    ///和 mCondWakeUp 配合使用的互斥量
+    std::mutex mMutexWakeUp;
+
 };
 
 }
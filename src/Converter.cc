@@ -192,6 +192,24 @@ Eigen::Matrix<double,3,3> Converter::toMatrix3d(const cv::Mat &cvMat3)
     return M;
 }
 
+//cv::Mat -> Eigen::Vector3f
+Eigen::Vector3f Converter::toVector3f(const cv::Mat &cvVector)
+{
+    Eigen::Vector3f v;
+    v << cvVector.at<float>(0), cvVector.at<float>(1), cvVector.at<float>(2);
+    return v;
+}
+
+//cv::Mat -> Eigen::Matrix3f
+Eigen::Matrix3f Converter::toMatrix3f(const cv::Mat &cvMat3)
+{
+    Eigen::Matrix3f M;
+    M << cvMat3.at<float>(0,0), cvMat3.at<float>(0,1), cvMat3.at<float>(0,2),
+         cvMat3.at<float>(1,0), cvMat3.at<float>(1,1), cvMat3.at<float>(1,2),
+         cvMat3.at<float>(2,0), cvMat3.at<float>(2,1), cvMat3.at<float>(2,2);
+    return M;
+}
+
 //将cv::Mat类型的四元数转换成为std::vector型
 std::vector<float> Converter::toQuaternion(const cv::Mat &M)
 {
@@ -32,7 +32,14 @@
 #include "Frame.h"
 #include "Converter.h"
 #include "ORBmatcher.h"
-#include <thread>
+#include <future>
+#include <string.h>
+
+// x86-64 上 SSE2 是基本指令集,双目匹配的SAD精匹配使用向量化实现;其他平台使用标量实现
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRAME_USE_SSE2
+#endif
 
 namespace ORB_SLAM2
 {
@@ -47,6 +54,7 @@ namespace ORB_SLAM2
     float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
     float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
     float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
+    cv::Mat Frame::mUndistortMapX, Frame::mUndistortMapY;
 
     //无参的构造函数默认为空
     Frame::Frame()
@@ -77,6 +85,8 @@ namespace ORB_SLAM2
           mDescriptorsRight(frame.mDescriptorsRight.clone()), //cv::Mat深拷贝
           mvpMapPoints(frame.mvpMapPoints),                   //深拷贝
           mvbOutlier(frame.mvbOutlier),                       //深拷贝
+          mvGridIndices(frame.mvGridIndices),                 //深拷贝
+          mvGridCellStart(frame.mvGridCellStart),             //深拷贝
           mnId(frame.mnId),
           mpReferenceKF(frame.mpReferenceKF),
           mnScaleLevels(frame.mnScaleLevels),
@@ -87,14 +97,6 @@ namespace ORB_SLAM2
           mvLevelSigma2(frame.mvLevelSigma2),         //深拷贝
           mvInvLevelSigma2(frame.mvInvLevelSigma2)    //深拷贝
     {
-        //逐个复制，其实这里也是深拷贝
-        for (int i = 0; i < FRAME_GRID_COLS; i++)
-            for (int j = 0; j < FRAME_GRID_ROWS; j++)
-                //这里没有使用前面的深拷贝方式的原因可能是mGrid是由若干vector类型对象组成的vector，
-                //但是自己不知道vector内部的源码不清楚其赋值方式，在第一维度上直接使用上面的方法可能会导致
-                //错误使用不合适的复制函数，导致第一维度的vector不能够被正确地“拷贝”
-                mGrid[i][j] = frame.mGrid[i][j];
-
         if (!frame.mTcw.empty())
             //这里说的是给新的帧设置Pose
             SetPose(frame.mTcw);
@@ -113,9 +115,10 @@ namespace ORB_SLAM2
  * @param[in] distCoef          相机去畸变参数
  * @param[in] bf                相机基线长度和焦距的乘积
  * @param[in] thDepth           远点和近点的深度区分阈值
+ * @param[in] pThreadPool       线程池，用来和当前线程同时提取右目图像的特征点、并行计算双目匹配；为NULL时串行计算
  *  
  */
-    Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor *extractorLeft, ORBextractor *extractorRight, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
+    Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor *extractorLeft, ORBextractor *extractorRight, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, ThreadPool* pThreadPool)
         : mpORBvocabulary(voc), mpORBextractorLeft(extractorLeft), mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()), mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
           mpReferenceKF(static_cast<KeyFrame *>(NULL))
     {
@@ -139,16 +142,20 @@ namespace ORB_SLAM2
         mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
 
         // ORB extraction
-        // Step 3 对左目右目图像提取ORB特征点, 第一个参数0-左图， 1-右图。为加速计算，同时开了两个线程计算
-        thread threadLeft(&Frame::ExtractORB, //该线程的主函数
-                          this,               //当前帧对象的对象指针
-                          0,                  //表示是左图图像
-                          imLeft);            //图像数据
-                                              //对右目图像提取ORB特征，参数含义同上
-        thread threadRight(&Frame::ExtractORB, this, 1, imRight);
-        //等待两张图像特征点提取过程完成
-        threadLeft.join();
-        threadRight.join();
+        // Step 3 对左目右目图像提取ORB特征点, 第一个参数0-左图， 1-右图。
+        // 为加速计算，右目图像交给System中常驻的线程池提取，左目图像在当前线程中同时提取，这样不用每帧都创建线程
+        if(pThreadPool)
+        {
+            std::future<void> rightDone = pThreadPool->Submit(std::bind(&Frame::ExtractORB, this, 1, imRight));
+            ExtractORB(0,imLeft);
+            //等待右目图像特征点提取过程完成
+            rightDone.get();
+        }
+        else
+        {
+            ExtractORB(0,imLeft);
+            ExtractORB(1,imRight);
+        }
 
         //mvKeys中保存的是左图像中的特征点，这里是获取左侧图像中特征点的个数
         N = mvKeys.size();
@@ -159,11 +166,13 @@ namespace ORB_SLAM2
 
         // Step 4 用OpenCV的矫正函数、内参对提取到的特征点进行矫正
         // 实际上由于双目输入的图像已经预先经过矫正,所以实际上并没有对特征点进行任何处理操作
+        if (mbInitialComputations)
+            ComputeUndistortMap(imLeft);
         UndistortKeyPoints();
 
         // Step 5 计算双目间特征点的匹配，只有匹配成功的特征点会计算其深度,深度存放在 mvDepth
         // mvuRight中存储的应该是左图像中的点所匹配的在右图像中的点的横坐标（纵坐标相同）
-        ComputeStereoMatches();
+        ComputeStereoMatches(pThreadPool);
 
         // 初始化本帧的地图点
         mvpMapPoints = vector<MapPoint *>(N, static_cast<MapPoint *>(NULL));
@@ -252,6 +261,8 @@ namespace ORB_SLAM2
             return;
 
         // Step 4 用OpenCV的矫正函数、内参对提取到的特征点进行矫正
+        if (mbInitialComputations)
+            ComputeUndistortMap(imGray);
         UndistortKeyPoints();
 
         // Step 5 获取图像的深度，并且根据这个深度推算其右图中匹配的特征点的视差
@@ -344,6 +355,8 @@ namespace ORB_SLAM2
             return;
 
         // Step 4 用OpenCV的矫正函数、内参对提取到的特征点进行矫正
+        if (mbInitialComputations)
+            ComputeUndistortMap(imGray);
         UndistortKeyPoints();
 
         // Set no stereo information
@@ -394,16 +407,13 @@ namespace ORB_SLAM2
  */
     void Frame::AssignFeaturesToGrid()
     {
-        // Step 1  给存储特征点的网格数组 Frame::mGrid 预分配空间
-        // ? 这里0.5 是为什么？节省空间？
-        // FRAME_GRID_COLS = 64，FRAME_GRID_ROWS=48
-        int nReserve = 0.5f * N / (FRAME_GRID_COLS * FRAME_GRID_ROWS); // N是特征点个数
-                                                                       //开始对mGrid这个二维数组中的每一个vector元素遍历并预分配空间
-        for (unsigned int i = 0; i < FRAME_GRID_COLS; i++)
-            for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++)
-                mGrid[i][j].reserve(nReserve);
-
-        // Step 2 遍历每个特征点，将每个特征点在mvKeysUn中的索引值放到对应的网格mGrid中
+        // 网格按 CSR 的方式存放: 先统计每个网格的特征点数目,再算出每个网格在 mvGridIndices 中的起始位置,
+        // 最后把特征点的索引依次填进去。只有两次分配,不需要给 64x48 个网格各自分配 vector
+        const int nCells = FRAME_GRID_COLS * FRAME_GRID_ROWS;
+
+        // Step 1 计算每个特征点所在的网格,不在网格中的记为-1
+        vector<int> vCellOfKey(N);
+        mvGridCellStart.assign(nCells + 1, 0);
         for (int i = 0; i < N; i++)
         {
             //从类的成员变量中获取已经去畸变后的特征点
@@ -413,8 +423,25 @@ namespace ORB_SLAM2
             int nGridPosX, nGridPosY;
             // 计算某个特征点所在网格的网格坐标，如果找到特征点所在的网格坐标，记录在nGridPosX,nGridPosY里，返回true，没找到返回false
             if (PosInGrid(kp, nGridPosX, nGridPosY))
-                //如果找到特征点所在网格坐标，将这个特征点的索引添加到对应网格的数组mGrid中
-                mGrid[nGridPosX][nGridPosY].push_back(i);
+            {
+                vCellOfKey[i] = nGridPosX * FRAME_GRID_ROWS + nGridPosY;
+                mvGridCellStart[vCellOfKey[i] + 1]++;
+            }
+            else
+                vCellOfKey[i] = -1;
+        }
+
+        // Step 2 数目累加得到每个网格的起始位置
+        for (int c = 0; c < nCells; c++)
+            mvGridCellStart[c + 1] += mvGridCellStart[c];
+
+        // Step 3 按特征点id顺序填入,同一网格内的索引保持升序
+        mvGridIndices.resize(mvGridCellStart[nCells]);
+        vector<int> vFill(mvGridCellStart.begin(), mvGridCellStart.end() - 1);
+        for (int i = 0; i < N; i++)
+        {
+            if (vCellOfKey[i] >= 0)
+                mvGridIndices[vFill[vCellOfKey[i]]++] = i;
         }
     }
 
@@ -467,6 +494,10 @@ namespace ORB_SLAM2
 
         // mTcw 求逆后是当前相机坐标系变换到世界坐标系下，对应的光心变换到世界坐标系下就是 mTcw的逆 中对应的平移向量
         mOw = -mRcw.t() * mtcw;
+
+        mRcwEig = Converter::toMatrix3f(mRcw);
+        mtcwEig = Converter::toVector3f(mtcw);
+        mOwEig = Converter::toVector3f(mOw);
     }
 
     /**
@@ -492,14 +523,14 @@ namespace ORB_SLAM2
 
         // 3D in absolute coordinates
         // Step 1 获得这个地图点的世界坐标
-        cv::Mat P = pMP->GetWorldPos();
+        const Eigen::Vector3f P = pMP->GetWorldPosEigen();
 
         // 3D in camera coordinates
         // 根据当前帧(粗糙)位姿转化到当前相机坐标系下的三维点Pc
-        const cv::Mat Pc = mRcw * P + mtcw;
-        const float &PcX = Pc.at<float>(0);
-        const float &PcY = Pc.at<float>(1);
-        const float &PcZ = Pc.at<float>(2);
+        const Eigen::Vector3f Pc = mRcwEig * P + mtcwEig;
+        const float PcX = Pc(0);
+        const float PcY = Pc(1);
+        const float PcZ = Pc(2);
 
         // Check positive depth
         // Step 2 关卡一：将这个地图点变换到当前帧的相机坐标系下，如果深度值为正才能继续下一步。
@@ -526,9 +557,9 @@ namespace ORB_SLAM2
 
         // 得到当前地图点距离当前帧相机光心的距离,注意P，mOw都是在同一坐标系下才可以
         //  mOw：当前相机光心在世界坐标系下坐标
-        const cv::Mat PO = P - mOw;
+        const Eigen::Vector3f PO = P - mOwEig;
         //取模就得到了距离
-        const float dist = cv::norm(PO);
+        const float dist = PO.norm();
 
         //如果不在有效范围内，认为投影不可靠
         if (dist < minDistance || dist > maxDistance)
@@ -536,7 +567,7 @@ namespace ORB_SLAM2
 
         // Check viewing angle
         // Step 5 关卡四：计算当前相机指向地图点向量和地图点的平均观测方向夹角，小于60°才能进入下一步。
-        cv::Mat Pn = pMP->GetNormal();
+        const Eigen::Vector3f Pn = pMP->GetNormalEigen();
 
         // 计算当前相机指向地图点向量和地图点的平均观测方向夹角的余弦值，注意平均观测方向为单位向量
         const float viewCos = PO.dot(Pn) / dist;
@@ -589,6 +620,10 @@ namespace ORB_SLAM2
         vector<size_t> vIndices;
         vIndices.reserve(N);
 
+        // 没有特征点的帧不会分配网格
+        if (mvGridCellStart.empty())
+            return vIndices;
+
         // Step 1 计算半径为r圆左右上下边界所在的网格列和行的id
         // 查找半径为r的圆左侧边界所在网格列坐标。这个地方有点绕，慢慢理解下：
         // (mnMaxX-mnMinX)/FRAME_GRID_COLS：表示列方向每个网格可以平均分得几个像素（肯定大于1）
@@ -628,16 +663,15 @@ namespace ORB_SLAM2
             for (int iy = nMinCellY; iy <= nMaxCellY; iy++)
             {
                 // 获取这个网格内的所有特征点在 Frame::mvKeysUn 中的索引
-                const vector<size_t> vCell = mGrid[ix][iy];
-                // 如果这个网格中没有特征点，那么跳过这个网格继续下一个
-                if (vCell.empty())
-                    continue;
+                const int nCell = ix * FRAME_GRID_ROWS + iy;
+                const int jbegin = mvGridCellStart[nCell];
+                const int jend = mvGridCellStart[nCell + 1];
 
-                // 如果这个网格中有特征点，那么遍历这个图像网格中所有的特征点
-                for (size_t j = 0, jend = vCell.size(); j < jend; j++)
+                // 遍历这个图像网格中所有的特征点，没有特征点时循环直接跳过
+                for (int j = jbegin; j < jend; j++)
                 {
                     // 根据索引先读取这个特征点
-                    const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
+                    const cv::KeyPoint &kpUn = mvKeysUn[mvGridIndices[j]];
                     // 保证给定的搜索金字塔层级范围合法
                     if (bCheckLevels)
                     {
@@ -659,7 +693,7 @@ namespace ORB_SLAM2
                     // 如果x方向和y方向的距离都在指定的半径之内，存储其index为候选特征点
                     //; 其实如果按照这里的写法来看，并不是在半径r的圆形区域内找特征点，而是在边长为2r的正方形内找特征点
                     if (fabs(distx) < r && fabs(disty) < r)
-                        vIndices.push_back(vCell[j]);
+                        vIndices.push_back(mvGridIndices[j]);
                 }
             }
         }
@@ -727,49 +761,87 @@ namespace ORB_SLAM2
             return;
         }
 
-        // Step 2 如果畸变参数不为0，用OpenCV函数进行畸变矫正
-        // Fill matrix with points
-        // N为提取的特征点数量，为满足OpenCV函数输入要求，将N个特征点保存在N*2的矩阵中
-        cv::Mat mat(N, 2, CV_32F);
-        //遍历每个特征点，并将它们的坐标保存到矩阵中
-        for (int i = 0; i < N; i++)
-        {
-            //然后将这个特征点的横纵坐标分别保存
-            mat.at<float>(i, 0) = mvKeys[i].pt.x;
-            mat.at<float>(i, 1) = mvKeys[i].pt.y;
-        }
-
-        // Undistort points
-        // 函数reshape(int cn,int rows=0) 其中cn为更改后的通道数，rows=0表示这个行将保持原来的参数不变
-        //为了能够直接调用opencv的函数来去畸变，需要先将矩阵调整为2通道（对应坐标x,y）
-        mat = mat.reshape(2);
-        cv::undistortPoints(
-            mat,       //输入的特征点坐标
-            mat,       //输出的校正后的特征点坐标覆盖原矩阵
-            mK,        //相机的内参数矩阵
-            mDistCoef, //相机畸变参数矩阵
-            cv::Mat(), //一个空矩阵，对应为函数原型中的R
-            mK);       //新内参数矩阵，对应为函数原型中的P
-
-        //调整回只有一个通道，回归我们正常的处理方式
-        mat = mat.reshape(1);
+        // Step 2 如果畸变参数不为0，查表并双线性插值得到去畸变后的坐标
+        // 查找表由 ComputeUndistortMap() 用 cv::undistortPoints 预先算好，这里不再逐帧迭代求解
+        const float invStep = 1.0f / UNDISTORT_MAP_STEP;
+        const int nMaxC = mUndistortMapX.cols - 2;
+        const int nMaxR = mUndistortMapX.rows - 2;
 
         // Fill undistorted keypoint vector
-        // Step 存储校正后的特征点
+        // Step 3 存储校正后的特征点
         mvKeysUn.resize(N);
         //遍历每一个特征点
         for (int i = 0; i < N; i++)
         {
-            //根据索引获取这个特征点
             //注意之所以这样做而不是直接重新声明一个特征点对象的目的是，能够得到源特征点对象的其他属性
             cv::KeyPoint kp = mvKeys[i];
-            //读取校正后的坐标并覆盖老坐标
-            kp.pt.x = mat.at<float>(i, 0);
-            kp.pt.y = mat.at<float>(i, 1);
+
+            // 特征点所在的采样格子,以及在格子中的相对位置
+            const float sx = kp.pt.x * invStep;
+            const float sy = kp.pt.y * invStep;
+            const int c = min(max((int)floor(sx), 0), nMaxC);
+            const int r = min(max((int)floor(sy), 0), nMaxR);
+            const float ax = sx - c;
+            const float ay = sy - r;
+
+            const float *pX0 = mUndistortMapX.ptr<float>(r) + c;
+            const float *pX1 = mUndistortMapX.ptr<float>(r + 1) + c;
+            const float *pY0 = mUndistortMapY.ptr<float>(r) + c;
+            const float *pY1 = mUndistortMapY.ptr<float>(r + 1) + c;
+
+            kp.pt.x = (1.0f - ay) * ((1.0f - ax) * pX0[0] + ax * pX0[1]) + ay * ((1.0f - ax) * pX1[0] + ax * pX1[1]);
+            kp.pt.y = (1.0f - ay) * ((1.0f - ax) * pY0[0] + ax * pY0[1]) + ay * ((1.0f - ax) * pY1[0] + ax * pY1[1]);
             mvKeysUn[i] = kp;
         }
     }
 
+    /**
+     * @brief 计算去畸变查找表
+     * @details 在原始图像上每隔 UNDISTORT_MAP_STEP 个像素取一个采样点(最后一行/列覆盖到图像边界以外),
+     * 用 cv::undistortPoints 求出它们去畸变后的坐标。畸变是光滑的,采样点之间双线性插值的误差远小于特征点的定位误差
+     * 
+     * @param[in] im                需要去畸变的图像,只用到它的尺寸
+     */
+    void Frame::ComputeUndistortMap(const cv::Mat &im)
+    {
+        // 不需要矫正时也就不需要查找表
+        if (mDistCoef.at<float>(0) == 0.0)
+        {
+            mUndistortMapX.release();
+            mUndistortMapY.release();
+            return;
+        }
+
+        const int nCols = (im.cols + UNDISTORT_MAP_STEP - 1) / UNDISTORT_MAP_STEP + 2;
+        const int nRows = (im.rows + UNDISTORT_MAP_STEP - 1) / UNDISTORT_MAP_STEP + 2;
+
+        // 采样点的坐标,和 UndistortKeyPoints 原来的做法一样用N*2的矩阵作为OpenCV函数的输入
+        cv::Mat mat(nRows * nCols, 2, CV_32F);
+        for (int r = 0; r < nRows; r++)
+        {
+            for (int c = 0; c < nCols; c++)
+            {
+                mat.at<float>(r * nCols + c, 0) = c * UNDISTORT_MAP_STEP;
+                mat.at<float>(r * nCols + c, 1) = r * UNDISTORT_MAP_STEP;
+            }
+        }
+
+        mat = mat.reshape(2);
+        cv::undistortPoints(mat, mat, mK, mDistCoef, cv::Mat(), mK);
+        mat = mat.reshape(1);
+
+        mUndistortMapX.create(nRows, nCols, CV_32F);
+        mUndistortMapY.create(nRows, nCols, CV_32F);
+        for (int r = 0; r < nRows; r++)
+        {
+            for (int c = 0; c < nCols; c++)
+            {
+                mUndistortMapX.at<float>(r, c) = mat.at<float>(r * nCols + c, 0);
+                mUndistortMapY.at<float>(r, c) = mat.at<float>(r * nCols + c, 1);
+            }
+        }
+    }
+
     /**
      * @brief 计算去畸变图像的边界
      * 
@@ -813,6 +885,81 @@ namespace ORB_SLAM2
         }
     }
 
+    /// SAD精匹配的图像块半径,图像块大小为 (2w+1)x(2w+1)
+    const int STEREO_SAD_W = 5;
+    /// SAD精匹配时右图图像块左右滑动的范围 [-L, L]
+    const int STEREO_SAD_L = 5;
+    /// 右图每一行参与计算的像素数
+    const int STEREO_SAD_SPAN = 2 * STEREO_SAD_L + 2 * STEREO_SAD_W + 1;
+
+    /**
+     * @brief 双目精匹配中一次算出右图图像块在 2L+1 个偏移处与左图图像块的SAD
+     * @details 两个图像块都先减去各自中心像素的灰度(去均值),再求差的绝对值之和,直接在uint8的金字塔图像上做整数运算,
+     * 和转成CV_32F后用 cv::norm(NORM_L1) 算出的结果完全相同。每个差的绝对值不超过510,
+     * 11x11个累加起来不超过61710,可以用无符号16位整数累加
+     * 
+     * @param[in] pL        左图图像块左上角像素的指针
+     * @param[in] stepL     左图每行的字节数
+     * @param[in] pR        右图搜索范围左上角像素的指针,即偏移为-L时图像块的左上角
+     * @param[in] stepR     右图每行的字节数
+     * @param[out] vDists   2L+1 个偏移处的SAD,vDists[L+incR] 对应偏移 incR
+     */
+    static void StereoPatchSAD(const uchar *pL, size_t stepL, const uchar *pR, size_t stepR, int *vDists)
+    {
+        const int w = STEREO_SAD_W;
+        const int nOffsets = 2 * STEREO_SAD_L + 1;
+        const int Lc = pL[w * stepL + w];
+
+#ifdef FRAME_USE_SSE2
+        // 偏移 k (0..2L) 放在第k个16位通道,两个向量共16个通道,多出的通道不使用。
+        // 右图的一行先拷贝到32字节的缓冲区再按16字节读取,多读的部分不会越过图像
+        alignas(16) uchar buf[32] = {0};
+        const __m128i zero = _mm_setzero_si128();
+
+        // 每个偏移处右图图像块的中心像素
+        memcpy(buf, pR + w * stepR, STEREO_SAD_SPAN);
+        const __m128i center = _mm_loadu_si128((const __m128i *)(buf + w));
+        const __m128i rc_lo = _mm_unpacklo_epi8(center, zero);
+        const __m128i rc_hi = _mm_unpackhi_epi8(center, zero);
+
+        __m128i acc_lo = zero, acc_hi = zero;
+        for (int r = 0; r < 2 * w + 1; r++)
+        {
+            const uchar *lrow = pL + r * stepL;
+            memcpy(buf, pR + r * stepR, STEREO_SAD_SPAN);
+            for (int j = 0; j < 2 * w + 1; j++)
+            {
+                const __m128i lv = _mm_set1_epi16((short)(lrow[j] - Lc));
+                const __m128i v = _mm_loadu_si128((const __m128i *)(buf + j));
+                const __m128i d_lo = _mm_sub_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), rc_lo), lv);
+                const __m128i d_hi = _mm_sub_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), rc_hi), lv);
+                acc_lo = _mm_add_epi16(acc_lo, _mm_max_epi16(d_lo, _mm_sub_epi16(zero, d_lo)));
+                acc_hi = _mm_add_epi16(acc_hi, _mm_max_epi16(d_hi, _mm_sub_epi16(zero, d_hi)));
+            }
+        }
+
+        alignas(16) unsigned short sums[16];
+        _mm_store_si128((__m128i *)sums, acc_lo);
+        _mm_store_si128((__m128i *)(sums + 8), acc_hi);
+        for (int k = 0; k < nOffsets; k++)
+            vDists[k] = sums[k];
+#else
+        for (int k = 0; k < nOffsets; k++)
+        {
+            const int Rc = pR[w * stepR + k + w];
+            int dist = 0;
+            for (int r = 0; r < 2 * w + 1; r++)
+            {
+                const uchar *lrow = pL + r * stepL;
+                const uchar *rrow = pR + r * stepR + k;
+                for (int j = 0; j < 2 * w + 1; j++)
+                    dist += abs((lrow[j] - Lc) - (rrow[j] - Rc));
+            }
+            vDists[k] = dist;
+        }
+#endif
+    }
+
     /*
  * 双目匹配函数
  *
@@ -823,7 +970,7 @@ namespace ORB_SLAM2
  * 这里所谓的亚像素精度，就是使用这个拟合得到一个小于一个单位像素的修正量，这样可以取得更好的估计结果，计算出来的点的深度也就越准确
  * 匹配成功后会更新 mvuRight(ur) 和 mvDepth(Z)
  */
-    void Frame::ComputeStereoMatches()
+    void Frame::ComputeStereoMatches(ThreadPool* pThreadPool)
     {
         /*两帧图像稀疏立体匹配（即：ORB特征点匹配，非逐像素的密集匹配，但依然满足行对齐）
      * 输入：两帧立体矫正后的图像img_left 和 img_right 对应的orb特征点集
@@ -849,33 +996,46 @@ namespace ORB_SLAM2
         // 金字塔底层（0层）图像高 nRows
         const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-        // 二维vector存储每一行的orb特征点的列坐标，为什么是vector，因为每一行的特征点有可能不一样，例如
-        // vRowIndices[0] = [1，2，5，8, 11]   第1行有5个特征点,他们的列号（即x坐标）分别是1,2,5,8,11
-        // vRowIndices[1] = [2，6，7，9, 13, 17, 20]  第2行有7个特征点.etc
-        vector<vector<size_t>> vRowIndices(nRows, vector<size_t>());
-        for (int i = 0; i < nRows; i++)
-            vRowIndices[i].reserve(200);
+        // 每一行可能匹配的右图特征点索引，例如
+        // 第0行: [1，2，5，8, 11]   第0行附近有5个右图特征点,它们的索引分别是1,2,5,8,11
+        // 第1行: [2，6，7，9, 13, 17, 20]  第1行附近有7个右图特征点.etc
+        // 所有行连续存放在 vRowIndices 中，第yi行是 vRowIndices[vRowStart[yi], vRowStart[yi+1])，
+        // 这样只需要两次分配，不用给每一行分配一个vector
+        vector<int> vRowStart(nRows + 1, 0);
+        vector<size_t> vRowIndices;
 
         // 右图特征点数量，N表示数量 r表示右图，且不能被修改
         const int Nr = mvKeysRight.size();
 
         // Step 1. 行特征点统计。 考虑用图像金字塔尺度作为偏移，左图中对应右图的一个特征点可能存在于多行，而非唯一的一行
+        // 计算特征点ir在行方向上，可能的偏移范围r，即可能的行号为[kpY + r, kpY -r]
+        // 2 表示在全尺寸(scale = 1)的情况下，假设有2个像素的偏移，随着尺度变化，r也跟着变化
+        vector<int> vMinRow(Nr), vMaxRow(Nr);
         for (int iR = 0; iR < Nr; iR++)
         {
-
             // 获取特征点ir的y坐标，即行号
             const cv::KeyPoint &kp = mvKeysRight[iR];
             const float &kpY = kp.pt.y;
 
-            // 计算特征点ir在行方向上，可能的偏移范围r，即可能的行号为[kpY + r, kpY -r]
-            // 2 表示在全尺寸(scale = 1)的情况下，假设有2个像素的偏移，随着尺度变化，r也跟着变化
-            const float r = 2.0f * mvScaleFactors[mvKeysRight[iR].octave];
-            const int maxr = ceil(kpY + r);
-            const int minr = floor(kpY - r);
+            const float r = 2.0f * mvScaleFactors[kp.octave];
+            vMaxRow[iR] = min(nRows - 1, (int)ceil(kpY + r));
+            vMinRow[iR] = max(0, (int)floor(kpY - r));
 
-            // 将特征点ir保证在可能的行号中
-            for (int yi = minr; yi <= maxr; yi++)
-                vRowIndices[yi].push_back(iR);
+            // 先统计每一行的特征点数目
+            for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+                vRowStart[yi + 1]++;
+        }
+
+        for (int yi = 0; yi < nRows; yi++)
+            vRowStart[yi + 1] += vRowStart[yi];
+
+        // 再按特征点索引顺序填入，每一行内的索引保持升序
+        vRowIndices.resize(vRowStart[nRows]);
+        {
+            vector<int> vFill(vRowStart.begin(), vRowStart.end() - 1);
+            for (int iR = 0; iR < Nr; iR++)
+                for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+                    vRowIndices[vFill[yi]++] = iR;
         }
 
         // 下面是 粗匹配 + 精匹配的过程
@@ -888,12 +1048,12 @@ namespace ORB_SLAM2
         const float minD = 0;          // 最小视差为0，对应无穷远
         const float maxD = mbf / minZ; // 最大视差对应的距离是相机的基线
 
-        // 保存sad块匹配相似度和左图特征点索引
-        vector<pair<int, int>> vDistIdx;
-        vDistIdx.reserve(N);
+        // 每个左图特征点匹配成功时的sad块匹配相似度，没有匹配时为-1
+        vector<int> vSadDist(N, -1);
 
-        // 为左图每一个特征点il，在右图搜索最相似的特征点ir
-        for (int iL = 0; iL < N; iL++)
+        // 为左图特征点il，在右图搜索最相似的特征点ir
+        // 每个特征点只读右图的特征点和图像，只写自己的 mvDepth[iL]、mvuRight[iL]、vSadDist[iL]，所以可以并行
+        auto matchKeyPoint = [&](int iL)
         {
 
             const cv::KeyPoint &kpL = mvKeys[iL];
@@ -902,9 +1062,11 @@ namespace ORB_SLAM2
             const float &uL = kpL.pt.x;
 
             // 获取左图特征点il所在行，以及在右图对应行中可能的匹配点
-            const vector<size_t> &vCandidates = vRowIndices[vL];
-            if (vCandidates.empty())
-                continue;
+            const int nRowL = vL;
+            const int iCBegin = vRowStart[nRowL];
+            const int iCEnd = vRowStart[nRowL + 1];
+            if (iCBegin == iCEnd)
+                return;
 
             // 计算理论上的最佳搜索范围
             const float minU = uL - maxD;
@@ -912,7 +1074,7 @@ namespace ORB_SLAM2
 
             // 最大搜索范围小于0，说明无匹配点
             if (maxU < 0)
-                continue;
+                return;
 
             // 初始化最佳相似度，用最大相似度，以及最佳匹配点索引
             int bestDist = ORBmatcher::TH_HIGH;
@@ -920,10 +1082,10 @@ namespace ORB_SLAM2
             const cv::Mat &dL = mDescriptors.row(iL);
 
             // Step 2. 粗配准。左图特征点il与右图中的可能的匹配点进行逐个比较,得到最相似匹配点的描述子距离和索引
-            for (size_t iC = 0; iC < vCandidates.size(); iC++)
+            for (int iC = iCBegin; iC < iCEnd; iC++)
             {
 
-                const size_t iR = vCandidates[iC];
+                const size_t iR = vRowIndices[iC];
                 const cv::KeyPoint &kpR = mvKeysRight[iR];
 
                 // 左图特征点il与待匹配点ic的空间尺度差超过2，放弃
@@ -965,27 +1127,10 @@ namespace ORB_SLAM2
 
                 // 滑动窗口搜索, 类似模版卷积或滤波
                 // w表示sad相似度的窗口半径
-                const int w = 5;
-
-                // 提取左图中，以特征点(scaleduL,scaledvL)为中心, 半径为w的图像块patch
-                cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduL - w, scaleduL + w + 1);
-                IL.convertTo(IL, CV_32F);
-
-                // 图像块均值归一化，降低亮度变化对相似度计算的影响
-                IL = IL - IL.at<float>(w, w) * cv::Mat::ones(IL.rows, IL.cols, CV_32F);
-
-                //初始化最佳相似度
-                int bestDist = INT_MAX;
-
-                // 通过滑动窗口搜索优化，得到的列坐标偏移量
-                int bestincR = 0;
+                const int w = STEREO_SAD_W;
 
                 //滑动窗口的滑动范围为（-L, L）
-                const int L = 5;
-
-                // 初始化存储图像块相似度
-                vector<float> vDists;
-                vDists.resize(2 * L + 1);
+                const int L = STEREO_SAD_L;
 
                 // 计算滑动窗口滑动范围的边界，因为是块匹配，还要算上图像块的尺寸
                 // 列方向起点 iniu = r0 - 最大窗口滑动范围 - 图像块尺寸
@@ -998,36 +1143,36 @@ namespace ORB_SLAM2
 
                 // 判断搜索是否越界
                 if (iniu < 0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
-                    continue;
-
-                // 在搜索范围内从左到右滑动，并计算图像块相似度
-                for (int incR = -L; incR <= +L; incR++)
-                {
+                    return;
 
-                    // 提取右图中，以特征点(scaleduL,scaledvL)为中心, 半径为w的图像快patch
-                    cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduR0 + incR - w, scaleduR0 + incR + w + 1);
-                    IR.convertTo(IR, CV_32F);
+                // 左图中以特征点(scaleduL,scaledvL)为中心、半径为w的图像块，
+                // 和右图中以(scaleduR0+incR,scaledvL)为中心的图像块，各自减去中心像素灰度后计算sad，值越小越相似
+                const cv::Mat &imL = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+                const cv::Mat &imR = mpORBextractorRight->mvImagePyramid[kpL.octave];
+                int vDists[2 * STEREO_SAD_L + 1];
+                StereoPatchSAD(imL.ptr<uchar>(scaledvL - w) + (int)scaleduL - w, imL.step,
+                               imR.ptr<uchar>(scaledvL - w) + (int)iniu, imR.step,
+                               vDists);
 
-                    // 图像块均值归一化，降低亮度变化对相似度计算的影响
-                    IR = IR - IR.at<float>(w, w) * cv::Mat::ones(IR.rows, IR.cols, CV_32F);
+                //初始化最佳相似度
+                int bestDist = INT_MAX;
 
-                    // sad 计算，值越小越相似
-                    float dist = cv::norm(IL, IR, cv::NORM_L1);
+                // 通过滑动窗口搜索优化，得到的列坐标偏移量
+                int bestincR = 0;
 
-                    // 统计最小sad和偏移量
-                    if (dist < bestDist)
+                // 统计最小sad和偏移量，L+incR 为refine后的匹配点列坐标(x)
+                for (int incR = -L; incR <= +L; incR++)
+                {
+                    if (vDists[L + incR] < bestDist)
                     {
-                        bestDist = dist;
+                        bestDist = vDists[L + incR];
                         bestincR = incR;
                     }
-
-                    //L+incR 为refine后的匹配点列坐标(x)
-                    vDists[L + incR] = dist;
                 }
 
                 // 搜索窗口越界判断
                 if (bestincR == -L || bestincR == L)
-                    continue;
+                    return;
 
                 // Step 4. 亚像素插值, 使用最佳匹配点及其左右相邻点构成抛物线来得到最小sad的亚像素坐标
                 // 使用3点拟合抛物线的方式，用极小值代替之前计算的最优是差值
@@ -1047,7 +1192,7 @@ namespace ORB_SLAM2
 
                 // 亚像素精度的修正量应该是在[-1,1]之间，否则就是误匹配
                 if (deltaR < -1 || deltaR > 1)
-                    continue;
+                    return;
 
                 // 根据亚像素精度偏移量delta调整最佳匹配索引
                 float bestuR = mvScaleFactors[kpL.octave] * ((float)scaleduR0 + (float)bestincR + deltaR);
@@ -1067,10 +1212,27 @@ namespace ORB_SLAM2
                     // Step 5. 最优视差值/深度选择.
                     mvDepth[iL] = mbf / disparity;
                     mvuRight[iL] = bestuR;
-                    vDistIdx.push_back(pair<int, int>(bestDist, iL));
+                    vSadDist[iL] = bestDist;
                 }
             }
-        }
+        };
+
+        if (pThreadPool)
+            pThreadPool->ParallelFor(N, matchKeyPoint);
+        else
+            for (int iL = 0; iL < N; iL++)
+                matchKeyPoint(iL);
+
+        // 保存sad块匹配相似度和左图特征点索引，按特征点索引的顺序收集，和串行时一样
+        vector<pair<int, int>> vDistIdx;
+        vDistIdx.reserve(N);
+        for (int iL = 0; iL < N; iL++)
+            if (vSadDist[iL] >= 0)
+                vDistIdx.push_back(pair<int, int>(vSadDist[iL], iL));
+
+        if (vDistIdx.empty())
+            return;
+
         // Step 6. 删除离群点(outliers)
         // 块匹配相似度阈值判断，归一化sad最小，并不代表就一定是匹配的，比如光照变化、弱纹理、无纹理等同样会造成误匹配
         // 误匹配判断条件  norm_sad > 1.5 * 1.4 * median
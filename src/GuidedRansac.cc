@@ -0,0 +1,164 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GuidedRansac.h"
+
+#include <cmath>
+#include <algorithm>
+#include "Thirdparty/DBoW2/DUtils/Random.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+ProsacSampler::ProsacSampler():mnMinSet(0), mnSamples(0), mn(0), mTn(0), mTnPrime(0)
+{
+}
+
+void ProsacSampler::Reset(const vector<int> &vDistances, int nMinSet, int nMaxIterations)
+{
+    const int N = vDistances.size();
+
+    // 按描述子距离升序排列. 先随机打乱,距离相同的匹配就是随机顺序,
+    // 否则距离没有区分度时前n个匹配总是下标最小的那几个,而下标是按金字塔层和网格排列的,外点常常聚在一起
+    mvSortedIndices.resize(N);
+    for(int i=0; i<N; i++)
+        mvSortedIndices[i] = i;
+    for(int i=N; i>1; i--)
+        swap(mvSortedIndices[i-1], mvSortedIndices[DUtils::Random::RandomInt(0, i-1)]);
+    stable_sort(mvSortedIndices.begin(), mvSortedIndices.end(),
+                [&vDistances](size_t a, size_t b){ return vDistances[a]<vDistances[b]; });
+    mvAvailable.reserve(N);
+
+    mnMinSet = nMinSet;
+    mnSamples = 0;
+    mn = min(nMinSet, N);
+
+    // T_n = T_N * C(n,m) / C(N,m), n 从 m 开始
+    mTn = nMaxIterations;
+    for(int i=0; i<nMinSet && i<N; i++)
+        mTn *= static_cast<double>(nMinSet-i)/(N-i);
+    mTnPrime = 1.0;
+}
+
+void ProsacSampler::Sample(vector<size_t> &vSample)
+{
+    const int N = mvSortedIndices.size();
+    vSample.clear();
+
+    // Step 1 采样次数达到 T'_n 时把采样范围扩大到 n+1
+    mnSamples++;
+    if(mnSamples>=mTnPrime && mn<N)
+    {
+        const double Tn1 = mTn*(mn+1)/(mn+1-mnMinSet);
+        mTnPrime += ceil(Tn1-mTn);
+        mTn = Tn1;
+        mn++;
+    }
+
+    // Step 2 还没有超过 T'_n 时,第n个匹配一定在最小集中,其余的从前n-1个中随机选;否则从前n个中随机选m个
+    int nRandom = mnMinSet;
+    int nRange = mn;
+    if(mTnPrime>=mnSamples)
+    {
+        nRandom--;
+        nRange--;
+        vSample.push_back(mvSortedIndices[mn-1]);
+    }
+
+    mvAvailable.assign(mvSortedIndices.begin(), mvSortedIndices.begin()+nRange);
+    for(int i=0; i<nRandom; i++)
+    {
+        const int randi = DUtils::Random::RandomInt(0, mvAvailable.size()-1);
+        vSample.push_back(mvAvailable[randi]);
+        mvAvailable[randi] = mvAvailable.back();
+        mvAvailable.pop_back();
+    }
+}
+
+SprtVerifier::SprtVerifier():mEpsilon(0), mDelta(0), mTM(0), mLogA(0), mLogRatioInlier(0), mLogRatioOutlier(0),
+    mbActive(false), mLogLambda(0), mnTested(0), mnConsistent(0), mnRejectedTested(0), mnRejectedConsistent(0)
+{
+}
+
+void SprtVerifier::Reset(double epsilon, double delta, double tM, size_t nPoints)
+{
+    mEpsilon = epsilon;
+    mDelta = delta;
+    mTM = tM;
+    mnRejectedTested = 0;
+    mnRejectedConsistent = 0;
+
+    // Fisher-Yates 洗牌,所有模型共用同一个随机顺序
+    mvOrder.resize(nPoints);
+    for(size_t i=0; i<nPoints; i++)
+        mvOrder[i] = i;
+    for(size_t i=nPoints; i>1; i--)
+        swap(mvOrder[i-1], mvOrder[DUtils::Random::RandomInt(0, static_cast<int>(i)-1)]);
+
+    UpdateThreshold();
+    Begin();
+}
+
+void SprtVerifier::Rejected()
+{
+    mnRejectedTested += mnTested;
+    mnRejectedConsistent += mnConsistent;
+    if(mnRejectedTested==0)
+        return;
+
+    // δ 的估计变化超过5%时才重新计算阈值
+    const double delta = max(0.001, static_cast<double>(mnRejectedConsistent)/mnRejectedTested);
+    if(fabs(delta-mDelta)>0.05*mDelta)
+    {
+        mDelta = delta;
+        UpdateThreshold();
+    }
+}
+
+void SprtVerifier::BetterModel(double epsilon)
+{
+    if(epsilon>mEpsilon)
+    {
+        mEpsilon = min(epsilon, 0.999);
+        UpdateThreshold();
+    }
+}
+
+void SprtVerifier::UpdateThreshold()
+{
+    mbActive = mDelta>0 && mDelta<mEpsilon && mEpsilon<1;
+    if(!mbActive)
+        return;
+
+    mLogRatioInlier = log(mDelta/mEpsilon);
+    mLogRatioOutlier = log((1.0-mDelta)/(1.0-mEpsilon));
+
+    // 最优阈值满足 A = tM*C + 1 + log(A), 其中 C 是一个点在两种模型下的KL散度,迭代几次就收敛了
+    const double C = (1.0-mDelta)*log((1.0-mDelta)/(1.0-mEpsilon)) + mDelta*log(mDelta/mEpsilon);
+    const double K = mTM*C + 1.0;
+    double A = K;
+    for(int i=0; i<10; i++)
+        A = K + log(A);
+    mLogA = log(A);
+}
+
+} //namespace ORB_SLAM
@@ -37,7 +37,7 @@
 #include "ORBmatcher.h"
 
 //这里使用到了多线程的加速技术
-#include<thread>
+#include<future>
 
 namespace ORB_SLAM2
 {
@@ -49,7 +49,8 @@ namespace ORB_SLAM2
  * @param[in] sigma                 测量误差
  * @param[in] iterations            RANSAC迭代次数
  */
-Initializer::Initializer(const Frame &ReferenceFrame, float sigma, int iterations)
+Initializer::Initializer(const Frame &ReferenceFrame, float sigma, int iterations, ThreadPool* pThreadPool):
+    mpThreadPool(pThreadPool)
 {
 	//从参考帧中获取相机的内参数矩阵
     mK = ReferenceFrame.mK.clone();
@@ -188,19 +189,24 @@ bool Initializer::Initialize(const Frame &CurrentFrame, const vector<int> &vMatc
     cv::Mat H, F; 
 
 
-    // 构造线程来计算H矩阵及其得分
-    // thread方法比较特殊，在传递引用的时候，外层需要用ref来进行引用传递，否则就是浅拷贝
-    thread threadH(&Initializer::FindHomography,	//该线程的主函数
-				   this,							//由于主函数为类的成员函数，所以第一个参数就应该是当前对象的this指针
-				   ref(vbMatchesInliersH), 			//输出，特征点对的Inlier标记
-				   ref(SH), 						//输出，计算的单应矩阵的RANSAC评分
-				   ref(H));							//输出，计算的单应矩阵结果
-    // 计算fundamental matrix并打分，参数定义和H是一样的，这里不再赘述
-    thread threadF(&Initializer::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F));
-    // Wait until both threads have finished
-	//等待两个计算线程结束
-    threadH.join();
-    threadF.join();
+    // 把F矩阵的计算交给线程池，当前线程同时计算H矩阵及其得分
+    // bind在传递引用的时候，需要用ref来进行引用传递，否则就是拷贝
+    if(mpThreadPool)
+    {
+        // 计算fundamental matrix并打分
+        future<void> threadF = mpThreadPool->Submit(bind(&Initializer::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F)));
+        FindHomography(vbMatchesInliersH,	//输出，特征点对的Inlier标记
+                       SH, 					//输出，计算的单应矩阵的RANSAC评分
+                       H);					//输出，计算的单应矩阵结果
+        // Wait until both threads have finished
+        //等待F矩阵计算结束
+        threadF.get();
+    }
+    else
+    {
+        FindHomography(vbMatchesInliersH, SH, H);
+        FindFundamental(vbMatchesInliersF, SF, F);
+    }
 
     // Compute ratio of scores
     // Step 4 计算得分比例来判断选取哪个模型来求位姿R,t
@@ -32,6 +32,7 @@
 #include "KeyFrame.h"
 #include "Converter.h"
 #include "ORBmatcher.h"
+#include "Serializer.h"
 #include<mutex>
 
 namespace ORB_SLAM2
@@ -54,10 +55,10 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mvInvLevelSigma2(F.mvInvLevelSigma2), mnMinX(F.mnMinX), mnMinY(F.mnMinY), mnMaxX(F.mnMaxX),
     //; 注意下面这一行中，mvpMapPoints(F.mvpMapPoints)， 把当前普通帧的每个特征点对应的地图点匹配关系赋值给了关键帧
     mnMaxY(F.mnMaxY), mK(F.mK), mvpMapPoints(F.mvpMapPoints), mpKeyFrameDB(pKFDB),    
-    mpORBvocabulary(F.mpORBvocabulary), mbFirstConnection(true), mpParent(NULL), mbNotErase(false),
+    mpORBvocabulary(F.mpORBvocabulary), mbOrderedConnectionsDirty(false), mbFirstConnection(true), mpParent(NULL), mbNotErase(false),
     mbToBeErased(false), mbBad(false), 
     mHalfBaseline(F.mb/2),      // 计算双目相机长度的一半
-    mpMap(pMap)
+    mpMap(pMap), mnFeaturesOffset(0), mnFeaturesSize(0), mbFeaturesLoaded(true)
 {
     // 获取id
     mnId=nNextId++;
@@ -68,7 +69,14 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     {
         mGrid[i].resize(mnGridRows);
         for(int j=0; j<mnGridRows; j++)
-            mGrid[i][j] = F.mGrid[i][j];  // 这个索引的结果是一个vector
+        {
+            // 普通帧的网格是连续存放的,取出这个网格对应的一段
+            if(F.mvGridCellStart.empty())
+                continue;
+            const int nCell = i*mnGridRows+j;
+            mGrid[i][j].assign(F.mvGridIndices.begin()+F.mvGridCellStart[nCell],
+                               F.mvGridIndices.begin()+F.mvGridCellStart[nCell+1]);
+        }
     }
 
     // 设置当前关键帧的位姿
@@ -79,6 +87,8 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
 //Done
 void KeyFrame::ComputeBoW()
 {
+    LoadFeatures();
+
     // 只有当词袋向量或者节点和特征序号的特征向量为空的时候执行
     if(mBowVec.empty() || mFeatVec.empty())
     {
@@ -101,6 +111,10 @@ void KeyFrame::SetPose(const cv::Mat &Tcw_)
     // 和普通帧中进行的操作相同
     Ow = -Rwc*tcw;
 
+    mRcwEig = Converter::toMatrix3f(Rcw);
+    mtcwEig = Converter::toVector3f(tcw);
+    mOwEig = Converter::toVector3f(Ow);
+
     // 计算当前位姿的逆
     Twc = cv::Mat::eye(4,4,Tcw.type());
     Rwc.copyTo(Twc.rowRange(0,3).colRange(0,3));
@@ -156,6 +170,24 @@ cv::Mat KeyFrame::GetTranslation()
     return Tcw.rowRange(0,3).col(3).clone();
 }
 
+Eigen::Matrix3f KeyFrame::GetRotationEigen()
+{
+    unique_lock<mutex> lock(mMutexPose);
+    return mRcwEig;
+}
+
+Eigen::Vector3f KeyFrame::GetTranslationEigen()
+{
+    unique_lock<mutex> lock(mMutexPose);
+    return mtcwEig;
+}
+
+Eigen::Vector3f KeyFrame::GetCameraCenterEigen()
+{
+    unique_lock<mutex> lock(mMutexPose);
+    return mOwEig;
+}
+
 /**
  * @brief 为当前关键帧新建或更新和其他关键帧的连接权重
  * 
@@ -164,24 +196,23 @@ cv::Mat KeyFrame::GetTranslation()
  */
 void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
 {
-    {
-        // 互斥锁，防止同时操作共享数据产生冲突
-        unique_lock<mutex> lock(mMutexConnections);
+    // 互斥锁，防止同时操作共享数据产生冲突
+    unique_lock<mutex> lock(mMutexConnections);
 
-        // 新建或更新连接权重
-        // count是STL库中的算法，查找里面有没有这个变量
-        if(!mConnectedKeyFrameWeights.count(pKF)) 
-            // count函数返回0，说明mConnectedKeyFrameWeights中没有pKF，新建连接
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else if(mConnectedKeyFrameWeights[pKF]!=weight) 
-            // 之前连接的权重不一样了，需要更新
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else
-            return;
-    }
+    // 新建或更新连接权重
+    // count是STL库中的算法，查找里面有没有这个变量
+    if(!mConnectedKeyFrameWeights.count(pKF)) 
+        // count函数返回0，说明mConnectedKeyFrameWeights中没有pKF，新建连接
+        mConnectedKeyFrameWeights[pKF]=weight;
+    else if(mConnectedKeyFrameWeights[pKF]!=weight) 
+        // 之前连接的权重不一样了，需要更新
+        mConnectedKeyFrameWeights[pKF]=weight;
+    else
+        return;
 
     // 连接关系变化就要更新最佳共视，主要是重新进行排序
-    UpdateBestCovisibles();
+    // 一次 UpdateConnections 会改变很多关键帧的连接,所以排序推迟到下次读取排序结果的时候
+    mbOrderedConnectionsDirty = true;
 }
 
 /**
@@ -193,6 +224,17 @@ void KeyFrame::UpdateBestCovisibles()
 {
     // 互斥锁，防止同时操作共享数据产生冲突
     unique_lock<mutex> lock(mMutexConnections);
+    mbOrderedConnectionsDirty = true;
+    SortConnectedKeyFrames();
+}
+
+// 连接权重变化过才重新排序
+void KeyFrame::SortConnectedKeyFrames()
+{
+    if(!mbOrderedConnectionsDirty)
+        return;
+    mbOrderedConnectionsDirty = false;
+
     // http://stackoverflow.com/questions/3389648/difference-between-stdliststdpair-and-stdmap-in-c-stl (std::map 和 std::list<std::pair>的区别)
     
     vector<pair<int,KeyFrame*> > vPairs;
@@ -220,6 +262,23 @@ void KeyFrame::UpdateBestCovisibles()
     mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
 }
 
+// 地图点增删观测时更新共同观测到的地图点数目,数目为0时删除
+void KeyFrame::ChangeCovisibility(KeyFrame* pKF, int n)
+{
+    unique_lock<mutex> lock(mMutexCovisibility);
+    map<KeyFrame*,int>::iterator mit = mCovisibilityCounter.find(pKF);
+    if(mit==mCovisibilityCounter.end())
+    {
+        if(n>0)
+            mCovisibilityCounter[pKF] = n;
+        return;
+    }
+
+    mit->second += n;
+    if(mit->second<=0)
+        mCovisibilityCounter.erase(mit);
+}
+
 // 得到与该关键帧连接（>15个共视地图点）的关键帧(没有排序的)
 set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
 {
@@ -235,6 +294,7 @@ set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
 vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
 {
     unique_lock<mutex> lock(mMutexConnections);
+    SortConnectedKeyFrames();
     return mvpOrderedConnectedKeyFrames;
 }
 
@@ -248,6 +308,7 @@ vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
 vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
 {
     unique_lock<mutex> lock(mMutexConnections);
+    SortConnectedKeyFrames();
 
     if((int)mvpOrderedConnectedKeyFrames.size()<N)
         // 如果总数不够，就返回所有的关键帧
@@ -267,6 +328,7 @@ vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
 vector<KeyFrame*> KeyFrame::GetCovisiblesByWeight(const int &w)
 {
     unique_lock<mutex> lock(mMutexConnections);
+    SortConnectedKeyFrames();
 
     // 如果没有和当前关键帧连接的关键帧，直接返回空
     if(mvpOrderedConnectedKeyFrames.empty())
@@ -404,7 +466,7 @@ MapPoint* KeyFrame::GetMapPoint(const size_t &idx)
 /*
  * 更新关键帧之间的连接图
  * 
- * 1. 首先获得该关键帧的所有MapPoint点，统计观测到这些3d点的每个关键帧与其它所有关键帧之间的共视程度
+ * 1. 取出该关键帧与其它所有关键帧之间的共视程度，即共同观测到的3d点个数，它在地图点增删观测时增量维护
  *    对每一个找到的关键帧，建立一条边，边的权重是该关键帧与当前关键帧公共3d点的个数。
  * 2. 并且该权重必须大于一个阈值，如果没有超过该阈值的权重，那么就只保留权重最大的边（与其它关键帧的共视程度比较高）
  * 3. 对这些连接按照权重从大到小进行排序，以方便将来的处理
@@ -413,45 +475,11 @@ MapPoint* KeyFrame::GetMapPoint(const size_t &idx)
 void KeyFrame::UpdateConnections()
 {
     // 关键帧-权重，权重为其它关键帧与当前关键帧共视地图点的个数，也称为共视程度
+    // Step 1 共视程度在地图点增删观测的时候已经增量统计好了,不需要再遍历所有地图点的观测
     map<KeyFrame*,int> KFcounter; 
-    vector<MapPoint*> vpMP;
-
     {
-        // 获得该关键帧的所有地图点
-        unique_lock<mutex> lockMPs(mMutexFeatures);
-        vpMP = mvpMapPoints;
-    }
-
-    //For all map points in keyframe check in which other keyframes are they seen
-    //Increase counter for those keyframes
-    // Step 1 通过地图点被关键帧观测来间接统计关键帧之间的共视程度
-    // 遍历这个关键帧中的所有地图点。统计每一个地图点都有多少关键帧与当前关键帧存在共视关系，统计结果放在KFcounter
-
-    for(vector<MapPoint*>::iterator vit=vpMP.begin(), vend=vpMP.end(); vit!=vend; vit++)
-    {
-        MapPoint* pMP = *vit;
-
-        if(!pMP)  // 地图点为空，说明当前关键帧的这个位置的特征点没有对应的地图点
-            continue;
-
-        if(pMP->isBad())  // 地图点是坏点，即将被删除
-            continue;
-
-        // 对于每一个地图点，observations记录了可以观测到该地图点的所有关键帧
-        map<KeyFrame*,size_t> observations = pMP->GetObservations();  // 观测到该MapPoint的KF和该MapPoint在KF中的索引
-
-        // 地图点中存储了可以观测到这个地图点的关键帧信息，所以再遍历这个map，得到能观测到这个地图点的所有关键帧
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
-        {
-            // 除去自身，自己与自己不算共视
-            if(mit->first->mnId==mnId)  // 关键帧的id等于当前这个关键帧的id，说明是自己
-                continue;
-            // 这里的操作非常精彩！
-            // map[key] = value，当要插入的键存在时，会覆盖键对应的原来的值。如果键不存在，则添加一组键值对
-            // mit->first 是地图点看到的关键帧，同一个关键帧看到的地图点会累加到该关键帧计数
-            // 所以最后KFcounter 第一个参数表示某个关键帧，第2个参数表示该关键帧看到了多少当前帧的地图点，也就是共视程度
-            KFcounter[mit->first]++;  // 这就是一种侧面的操作，统计当前帧的每一个地图点，被其他关键帧观测到，然后统计共视地图点的个数
-        }
+        unique_lock<mutex> lockCovis(mMutexCovisibility);
+        KFcounter = mCovisibilityCounter;
     }
 
     // This should not happen
@@ -524,6 +552,7 @@ void KeyFrame::UpdateConnections()
         mConnectedKeyFrameWeights = KFcounter;   //; 这里直接一步更新了当前帧和其他共视帧的连接关系
         mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
         mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
+        mbOrderedConnectionsDirty = false;
 
         // Step 5 更新生成树的连接
         //; mbFirstConnection 指示当前关键帧是否第一次加入生成树中，默认为true。所以一般情况下这个if判断总是成立的
@@ -672,6 +701,7 @@ void KeyFrame::SetBadFlag()
         // 清空自己与其它关键帧之间的联系
         mConnectedKeyFrameWeights.clear();
         mvpOrderedConnectedKeyFrames.clear();
+        mbOrderedConnectionsDirty = false;
 
         // Update Spanning Tree 
         // Step 4 更新生成树，主要是处理好父子关键帧，不然会造成整个关键帧维护的图断裂，或者混乱
@@ -774,21 +804,13 @@ bool KeyFrame::isBad()
 // 删除当前关键帧和指定关键帧之间的共视关系
 void KeyFrame::EraseConnection(KeyFrame* pKF)
 {
-    // 其实这个应该表示是否真的是有共视关系
-    bool bUpdate = false;
-
+    unique_lock<mutex> lock(mMutexConnections);
+    // 如果是真的有共视关系,那么删除之后就要更新共视关系,排序推迟到下次读取的时候
+    if(mConnectedKeyFrameWeights.count(pKF))
     {
-        unique_lock<mutex> lock(mMutexConnections);
-        if(mConnectedKeyFrameWeights.count(pKF))
-        {
-            mConnectedKeyFrameWeights.erase(pKF);  // erase就是STL库函数，在库函数里删除这个变量
-            bUpdate=true;
-        }
+        mConnectedKeyFrameWeights.erase(pKF);  // erase就是STL库函数，在库函数里删除这个变量
+        mbOrderedConnectionsDirty = true;
     }
-
-    // 如果是真的有共视关系,那么删除之后就要更新共视关系
-    if(bUpdate)
-        UpdateBestCovisibles();
 }
 
 // 获取某个特征点的邻域中的特征点id,其实这个和 Frame.cc 中的那个函数基本上都是一致的; r为边长（半径）
@@ -822,7 +844,7 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const vector<size_t> vCell = mGrid[ix][iy];
+            const vector<size_t> &vCell = mGrid[ix][iy];
             for(size_t j=0, jend=vCell.size(); j<jend; j++)
             {
                 const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
@@ -852,6 +874,8 @@ bool KeyFrame::IsInImage(const float &x, const float &y) const
  */
 cv::Mat KeyFrame::UnprojectStereo(int i)
 {
+    LoadFeatures();
+
     const float z = mvDepth[i];
     if(z>0)
     {
@@ -908,4 +932,336 @@ float KeyFrame::ComputeSceneMedianDepth(const int q)
     return vDepths[(vDepths.size()-1)/q];
 }
 
+
+// 保存关键帧自身的数据
+void KeyFrame::Save(std::ostream &f, uint64_t nFeaturesBegin, uint64_t nFeaturesEnd)
+{
+    // 编号和时间戳
+    Serializer::Write(f,mnId);
+    Serializer::Write(f,mnFrameId);
+    Serializer::Write(f,mTimeStamp);
+
+    // 相机参数和图像边界
+    Serializer::Write(f,fx);
+    Serializer::Write(f,fy);
+    Serializer::Write(f,cx);
+    Serializer::Write(f,cy);
+    Serializer::Write(f,invfx);
+    Serializer::Write(f,invfy);
+    Serializer::Write(f,mbf);
+    Serializer::Write(f,mb);
+    Serializer::Write(f,mThDepth);
+    Serializer::WriteMat(f,mK);
+    Serializer::Write(f,mnMinX);
+    Serializer::Write(f,mnMinY);
+    Serializer::Write(f,mnMaxX);
+    Serializer::Write(f,mnMaxY);
+    Serializer::Write(f,mfGridElementWidthInv);
+    Serializer::Write(f,mfGridElementHeightInv);
+
+    // 图像金字塔的尺度信息
+    Serializer::Write(f,mnScaleLevels);
+    Serializer::Write(f,mfScaleFactor);
+    Serializer::Write(f,mfLogScaleFactor);
+    Serializer::WriteVector(f,mvScaleFactors);
+    Serializer::WriteVector(f,mvLevelSigma2);
+    Serializer::WriteVector(f,mvInvLevelSigma2);
+
+    // 添加观测时要用到右目坐标,回环检测时要用到词袋,所以和关键帧一起读取
+    Serializer::Write(f,N);
+    Serializer::WriteVector(f,mvuRight);
+    Serializer::WriteVector(f,mvDepth);
+    Serializer::WriteBowVector(f,mBowVec);
+
+    // 位姿
+    Serializer::WriteMat(f,GetPose());
+    Serializer::WriteMat(f,mTcp);
+
+    // SaveFeatures()写出的数据块
+    const int32_t descRows = mDescriptors.rows, descCols = mDescriptors.cols, descType = mDescriptors.type();
+    Serializer::Write(f,descRows);
+    Serializer::Write(f,descCols);
+    Serializer::Write(f,descType);
+    Serializer::Write(f,nFeaturesBegin);
+    Serializer::Write(f,nFeaturesEnd);
+}
+
+// 保存描述子、特征点、网格和特征向量
+void KeyFrame::SaveFeatures(std::ostream &f)
+{
+    // 描述子逐行写出,不带矩阵头,读取时直接指向映射文件中的数据
+    const size_t rowBytes = mDescriptors.cols*mDescriptors.elemSize();
+    for(int i=0; i<mDescriptors.rows; i++)
+        f.write(reinterpret_cast<const char*>(mDescriptors.ptr(i)), rowBytes);
+
+    // 还没有读入内存的数据直接从映射文件中拷贝,保存地图时不需要把所有关键帧都读进来
+    {
+        unique_lock<mutex> lock(mMutexLoadFeatures);
+        if(!mbFeaturesLoaded.load(std::memory_order_relaxed))
+        {
+            f.write(mpMapFile->Data()+mnFeaturesOffset,mnFeaturesSize);
+            return;
+        }
+    }
+
+    Serializer::WriteKeyPoints(f,mvKeys);
+    Serializer::WriteKeyPoints(f,mvKeysUn);
+    for(int i=0; i<mnGridCols; i++)
+        for(int j=0; j<mnGridRows; j++)
+            Serializer::WriteVector(f,mGrid[i][j]);
+    Serializer::WriteFeatureVector(f,mFeatVec);
+}
+
+// 保存关键帧和其他关键帧、地图点之间的关系
+void KeyFrame::SaveLinks(std::ostream &f)
+{
+    Serializer::Write(f,mnId);
+
+    // 观测到的地图点,没有地图点或者是坏点时保存为-1
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        vector<long int> vMPids(N,-1);
+        for(int i=0; i<N; i++)
+        {
+            MapPoint* pMP = mvpMapPoints[i];
+            if(pMP && !pMP->isBad())
+                vMPids[i] = pMP->mnId;
+        }
+        Serializer::WriteVector(f,vMPids);
+    }
+
+    unique_lock<mutex> lock(mMutexConnections);
+
+    // 共视关键帧和权重
+    vector<long unsigned int> vKFids;
+    vector<int> vWeights;
+    for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
+    {
+        if(mit->first->isBad())
+            continue;
+        vKFids.push_back(mit->first->mnId);
+        vWeights.push_back(mit->second);
+    }
+    Serializer::WriteVector(f,vKFids);
+    Serializer::WriteVector(f,vWeights);
+
+    // 生成树
+    const long int nParentId = mpParent ? (long int)mpParent->mnId : -1;
+    Serializer::Write(f,nParentId);
+
+    vector<long unsigned int> vChildIds;
+    for(set<KeyFrame*>::iterator sit=mspChildrens.begin(), send=mspChildrens.end(); sit!=send; sit++)
+        if(!(*sit)->isBad())
+            vChildIds.push_back((*sit)->mnId);
+    Serializer::WriteVector(f,vChildIds);
+
+    // 回环边
+    vector<long unsigned int> vLoopIds;
+    for(set<KeyFrame*>::iterator sit=mspLoopEdges.begin(), send=mspLoopEdges.end(); sit!=send; sit++)
+        if(!(*sit)->isBad())
+            vLoopIds.push_back((*sit)->mnId);
+    Serializer::WriteVector(f,vLoopIds);
+}
+
+// 读取关键帧。先把数据读到一个普通帧中,再用普通帧构造关键帧,这样和正常运行时创建关键帧的过程一致
+KeyFrame* KeyFrame::Load(std::istream &f, Map* pMap, KeyFrameDatabase* pKFDB, ORBVocabulary* pVoc,
+                         const std::shared_ptr<MappedFile> &pMapFile)
+{
+    Frame F;
+    F.mpORBvocabulary = pVoc;
+
+    long unsigned int nId;
+    Serializer::Read(f,nId);
+    Serializer::Read(f,F.mnId);
+    Serializer::Read(f,F.mTimeStamp);
+
+    // 相机参数和图像边界是Frame中的静态变量
+    Serializer::Read(f,Frame::fx);
+    Serializer::Read(f,Frame::fy);
+    Serializer::Read(f,Frame::cx);
+    Serializer::Read(f,Frame::cy);
+    Serializer::Read(f,Frame::invfx);
+    Serializer::Read(f,Frame::invfy);
+    Serializer::Read(f,F.mbf);
+    Serializer::Read(f,F.mb);
+    Serializer::Read(f,F.mThDepth);
+    Serializer::ReadMat(f,F.mK);
+    int nMinX, nMinY, nMaxX, nMaxY;
+    Serializer::Read(f,nMinX);
+    Serializer::Read(f,nMinY);
+    Serializer::Read(f,nMaxX);
+    Serializer::Read(f,nMaxY);
+    Frame::mnMinX = nMinX;
+    Frame::mnMinY = nMinY;
+    Frame::mnMaxX = nMaxX;
+    Frame::mnMaxY = nMaxY;
+    Serializer::Read(f,Frame::mfGridElementWidthInv);
+    Serializer::Read(f,Frame::mfGridElementHeightInv);
+
+    Serializer::Read(f,F.mnScaleLevels);
+    Serializer::Read(f,F.mfScaleFactor);
+    Serializer::Read(f,F.mfLogScaleFactor);
+    Serializer::ReadVector(f,F.mvScaleFactors);
+    Serializer::ReadVector(f,F.mvLevelSigma2);
+    Serializer::ReadVector(f,F.mvInvLevelSigma2);
+
+    Serializer::Read(f,F.N);
+    Serializer::ReadVector(f,F.mvuRight);
+    Serializer::ReadVector(f,F.mvDepth);
+    Serializer::ReadBowVector(f,F.mBowVec);
+
+    Serializer::ReadMat(f,F.mTcw);
+    cv::Mat Tcp;
+    Serializer::ReadMat(f,Tcp);
+
+    int32_t descRows = 0, descCols = 0, descType = 0;
+    uint64_t nFeaturesBegin = 0, nFeaturesEnd = 0;
+    Serializer::Read(f,descRows);
+    Serializer::Read(f,descCols);
+    Serializer::Read(f,descType);
+    Serializer::Read(f,nFeaturesBegin);
+    Serializer::Read(f,nFeaturesEnd);
+
+    if(!f.good() || F.N<0 || (int)F.mvuRight.size()!=F.N || descRows!=F.N ||
+       F.mTcw.rows!=4 || F.mTcw.cols!=4)
+        return static_cast<KeyFrame*>(NULL);
+
+    // 检查数据块是否在文件范围内
+    const uint64_t descBytes = descRows>0 ? (uint64_t)descRows*descCols*CV_ELEM_SIZE(descType) : 0;
+    if(nFeaturesBegin>nFeaturesEnd || nFeaturesEnd>pMapFile->Size() || descBytes>nFeaturesEnd-nFeaturesBegin)
+        return static_cast<KeyFrame*>(NULL);
+
+    // 地图点关系在LoadLinks中恢复
+    F.mvpMapPoints = vector<MapPoint*>(F.N,static_cast<MapPoint*>(NULL));
+
+    KeyFrame* pKF = new KeyFrame(F,pMap,pKFDB);
+    pKF->mnId = nId;
+    pKF->mTcp = Tcp;
+
+    // 描述子不拷贝,映射是只读的,修改描述子会导致段错误
+    if(descRows>0)
+        pKF->mDescriptors = cv::Mat(descRows,descCols,descType,const_cast<char*>(pMapFile->Data()+nFeaturesBegin));
+    pKF->mpMapFile = pMapFile;
+    pKF->mnFeaturesOffset = nFeaturesBegin+descBytes;
+    pKF->mnFeaturesSize = nFeaturesEnd-pKF->mnFeaturesOffset;
+    pKF->mbFeaturesLoaded = false;
+
+    return pKF;
+}
+
+// 从映射文件中读取特征点、网格和特征向量
+void KeyFrame::LoadFeatures()
+{
+    if(mbFeaturesLoaded.load(std::memory_order_acquire))
+        return;
+
+    unique_lock<mutex> lock(mMutexLoadFeatures);
+    // 其他线程可能已经读取过了
+    if(mbFeaturesLoaded.load(std::memory_order_relaxed))
+        return;
+
+    MemoryBuffer buf(mpMapFile->Data()+mnFeaturesOffset,mnFeaturesSize);
+    istream f(&buf);
+
+    Serializer::ReadKeyPoints(f,mvKeys);
+    Serializer::ReadKeyPoints(f,mvKeysUn);
+    for(int i=0; i<mnGridCols; i++)
+        for(int j=0; j<mnGridRows; j++)
+            Serializer::ReadVector(f,mGrid[i][j]);
+    Serializer::ReadFeatureVector(f,mFeatVec);
+
+    // 文件在加载之后被破坏,没有办法继续运行
+    if(f.fail() || (int)mvKeys.size()!=N || (int)mvKeysUn.size()!=N)
+    {
+        cerr << "ERROR: corrupted features of keyframe " << mnId << " in the map file" << endl;
+        exit(-1);
+    }
+
+    mbFeaturesLoaded.store(true,std::memory_order_release);
+}
+
+// 读取关键帧和其他关键帧、地图点之间的关系
+void KeyFrame::LoadLinks(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs,
+                         const std::map<long unsigned int, MapPoint*> &mMPs)
+{
+    long unsigned int nId;
+    Serializer::Read(f,nId);
+
+    vector<long int> vMPids;
+    Serializer::ReadVector(f,vMPids);
+
+    vector<long unsigned int> vKFids;
+    vector<int> vWeights;
+    Serializer::ReadVector(f,vKFids);
+    Serializer::ReadVector(f,vWeights);
+
+    long int nParentId;
+    Serializer::Read(f,nParentId);
+
+    vector<long unsigned int> vChildIds, vLoopIds;
+    Serializer::ReadVector(f,vChildIds);
+    Serializer::ReadVector(f,vLoopIds);
+
+    if(!f.good() || nId!=mnId || (int)vMPids.size()!=N || vKFids.size()!=vWeights.size())
+    {
+        f.setstate(std::ios::failbit);
+        return;
+    }
+
+    // 地图点和观测,观测次数和正常运行时一样由AddObservation统计
+    for(int i=0; i<N; i++)
+    {
+        if(vMPids[i]<0)
+            continue;
+        map<long unsigned int, MapPoint*>::const_iterator mit = mMPs.find(vMPids[i]);
+        if(mit==mMPs.end())
+            continue;
+        AddMapPoint(mit->second,i);
+        mit->second->AddObservation(this,i);
+    }
+
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+
+        // 共视图
+        for(size_t i=0; i<vKFids.size(); i++)
+        {
+            map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(vKFids[i]);
+            if(mit!=mKFs.end())
+                mConnectedKeyFrameWeights[mit->second] = vWeights[i];
+        }
+
+        // 生成树
+        if(nParentId>=0)
+        {
+            map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(nParentId);
+            if(mit!=mKFs.end())
+                mpParent = mit->second;
+        }
+        for(size_t i=0; i<vChildIds.size(); i++)
+        {
+            map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(vChildIds[i]);
+            if(mit!=mKFs.end())
+                mspChildrens.insert(mit->second);
+        }
+
+        // 回环边,有回环边的关键帧不能被删除
+        for(size_t i=0; i<vLoopIds.size(); i++)
+        {
+            map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(vLoopIds[i]);
+            if(mit!=mKFs.end())
+            {
+                mspLoopEdges.insert(mit->second);
+                mbNotErase = true;
+            }
+        }
+
+        // 生成树已经恢复,之后UpdateConnections不能再重新设置父关键帧
+        mbFirstConnection = false;
+    }
+
+    // 按权重排序共视关键帧
+    UpdateBestCovisibles();
+}
+
 } //namespace ORB_SLAM
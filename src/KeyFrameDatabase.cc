@@ -33,6 +33,7 @@
 
 #include "KeyFrame.h"
 #include "Thirdparty/DBoW2/DBoW2/BowVector.h"
+#include "Serializer.h"
 
 #include<mutex>
 
@@ -258,6 +259,8 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
             {
                 vpLoopCandidates.push_back(pKFi);
                 spAlreadyAddedKF.insert(pKFi);
+                // 候选关键帧接下来要和当前关键帧做特征匹配
+                pKFi->LoadFeatures();
             }
         }
     }
@@ -415,6 +418,8 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
             {
                 vpRelocCandidates.push_back(pKFi);
                 spAlreadyAddedKF.insert(pKFi);  
+                // 候选关键帧接下来要和当前帧做特征匹配
+                pKFi->LoadFeatures();
             }
         }
     }
@@ -422,4 +427,58 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
     return vpRelocCandidates;
 }
 
+// 保存倒排索引,每个非空单词保存单词id和包含它的关键帧id
+void KeyFrameDatabase::Save(std::ostream &f)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    vector<unsigned int> vWordIds;
+    for(size_t i=0; i<mvInvertedFile.size(); i++)
+        if(!mvInvertedFile[i].empty())
+            vWordIds.push_back(i);
+    Serializer::WriteVector(f,vWordIds);
+
+    for(size_t i=0; i<vWordIds.size(); i++)
+    {
+        const list<KeyFrame*> &lKFs = mvInvertedFile[vWordIds[i]];
+        vector<long unsigned int> vKFids;
+        vKFids.reserve(lKFs.size());
+        for(list<KeyFrame*>::const_iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            if(!(*lit)->isBad())
+                vKFids.push_back((*lit)->mnId);
+        Serializer::WriteVector(f,vKFids);
+    }
+}
+
+// 读取倒排索引,保持保存时每个单词中关键帧的顺序
+void KeyFrameDatabase::Load(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs)
+{
+    vector<unsigned int> vWordIds;
+    Serializer::ReadVector(f,vWordIds);
+
+    unique_lock<mutex> lock(mMutex);
+    mvInvertedFile.clear();
+    mvInvertedFile.resize(mpVoc->size());
+
+    for(size_t i=0; i<vWordIds.size(); i++)
+    {
+        vector<long unsigned int> vKFids;
+        Serializer::ReadVector(f,vKFids);
+        // 保存时用的是另一个字典
+        if(!f.good() || vWordIds[i]>=mvInvertedFile.size())
+        {
+            f.setstate(std::ios::failbit);
+            return;
+        }
+
+        list<KeyFrame*> &lKFs = mvInvertedFile[vWordIds[i]];
+        for(size_t j=0; j<vKFids.size(); j++)
+        {
+            map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(vKFids[j]);
+            if(mit!=mKFs.end())
+                lKFs.push_back(mit->second);
+        }
+    }
+}
+
 } //namespace ORB_SLAM
@@ -0,0 +1,155 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalBAWorkspace.h"
+
+#include "Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+LocalBAWorkspace::LocalBAWorkspace():
+    mExecutor(static_cast<ThreadPool*>(NULL)),
+    mnUsedVerticesSE3(0), mnUsedVerticesPoint(0), mnUsedEdgesMono(0), mnUsedEdgesStereo(0)
+{
+    // 和全局BA一样使用 LM + BlockSolver_6_3 + LinearSolverEigen
+    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
+    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+    mpBlockSolver = new g2o::BlockSolver_6_3(linearSolver);
+    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(mpBlockSolver);
+    // 优化器析构时会释放算法,算法再释放BlockSolver和线性求解器
+    mOptimizer.setAlgorithm(solver);
+}
+
+LocalBAWorkspace::~LocalBAWorkspace()
+{
+    ReleaseGraph();
+
+    for(size_t i=0; i<mvpVerticesSE3.size(); i++)
+        delete mvpVerticesSE3[i];
+    for(size_t i=0; i<mvpVerticesPoint.size(); i++)
+        delete mvpVerticesPoint[i];
+    for(size_t i=0; i<mvpEdgesMono.size(); i++)
+    {
+        delete mvpEdgesMono[i];
+        delete mvpKernelsMono[i];
+    }
+    for(size_t i=0; i<mvpEdgesStereo.size(); i++)
+    {
+        delete mvpEdgesStereo[i];
+        delete mvpKernelsStereo[i];
+    }
+}
+
+void LocalBAWorkspace::ReleaseGraph()
+{
+    // 边析构或者 setRobustKernel() 时会 delete 掉挂在上面的核函数,所以先把池中的核函数都取下来
+    for(size_t i=0; i<mnUsedEdgesMono; i++)
+        mvpEdgesMono[i]->releaseRobustKernel();
+    for(size_t i=0; i<mnUsedEdgesStereo; i++)
+        mvpEdgesStereo[i]->releaseRobustKernel();
+
+    mOptimizer.release();
+
+    mnUsedVerticesSE3 = 0;
+    mnUsedVerticesPoint = 0;
+    mnUsedEdgesMono = 0;
+    mnUsedEdgesStereo = 0;
+}
+
+void LocalBAWorkspace::Reset(ThreadPool* pThreadPool, bool* pbStopFlag)
+{
+    ReleaseGraph();
+
+    // 有线程池时按地图点划分各条边,并行地线性化和计算Schur补
+    mExecutor.SetThreadPool(pThreadPool);
+    mpBlockSolver->setParallelExecutor(pThreadPool ? &mExecutor : static_cast<g2o::ParallelExecutor*>(NULL));
+
+    mOptimizer.setForceStopFlag(pbStopFlag);
+}
+
+g2o::SparseOptimizer& LocalBAWorkspace::GetOptimizer()
+{
+    return mOptimizer;
+}
+
+g2o::VertexSE3Expmap* LocalBAWorkspace::NewVertexSE3()
+{
+    if(mnUsedVerticesSE3==mvpVerticesSE3.size())
+        mvpVerticesSE3.push_back(new g2o::VertexSE3Expmap());
+
+    g2o::VertexSE3Expmap* pVertex = mvpVerticesSE3[mnUsedVerticesSE3++];
+    pVertex->setFixed(false);
+    pVertex->setMarginalized(false);
+    return pVertex;
+}
+
+g2o::VertexSBAPointXYZ* LocalBAWorkspace::NewVertexPoint()
+{
+    if(mnUsedVerticesPoint==mvpVerticesPoint.size())
+        mvpVerticesPoint.push_back(new g2o::VertexSBAPointXYZ());
+
+    g2o::VertexSBAPointXYZ* pVertex = mvpVerticesPoint[mnUsedVerticesPoint++];
+    pVertex->setFixed(false);
+    pVertex->setMarginalized(false);
+    return pVertex;
+}
+
+g2o::EdgeSE3ProjectXYZ* LocalBAWorkspace::NewEdgeMono(const double delta)
+{
+    if(mnUsedEdgesMono==mvpEdgesMono.size())
+    {
+        mvpEdgesMono.push_back(new g2o::EdgeSE3ProjectXYZ());
+        mvpKernelsMono.push_back(new g2o::RobustKernelHuber());
+    }
+
+    g2o::EdgeSE3ProjectXYZ* pEdge = mvpEdgesMono[mnUsedEdgesMono];
+    g2o::RobustKernelHuber* pKernel = mvpKernelsMono[mnUsedEdgesMono];
+    mnUsedEdgesMono++;
+
+    // 上一次局部BA中可能被标记成了外点
+    pEdge->setLevel(0);
+    pKernel->setDelta(delta);
+    pEdge->setRobustKernel(pKernel);
+    return pEdge;
+}
+
+g2o::EdgeStereoSE3ProjectXYZ* LocalBAWorkspace::NewEdgeStereo(const double delta)
+{
+    if(mnUsedEdgesStereo==mvpEdgesStereo.size())
+    {
+        mvpEdgesStereo.push_back(new g2o::EdgeStereoSE3ProjectXYZ());
+        mvpKernelsStereo.push_back(new g2o::RobustKernelHuber());
+    }
+
+    g2o::EdgeStereoSE3ProjectXYZ* pEdge = mvpEdgesStereo[mnUsedEdgesStereo];
+    g2o::RobustKernelHuber* pKernel = mvpKernelsStereo[mnUsedEdgesStereo];
+    mnUsedEdgesStereo++;
+
+    pEdge->setLevel(0);
+    pKernel->setDelta(delta);
+    pEdge->setRobustKernel(pKernel);
+    return pEdge;
+}
+
+} //namespace ORB_SLAM
@@ -42,6 +42,7 @@ namespace ORB_SLAM2
 // 构造函数
 LocalMapping::LocalMapping(Map *pMap, const float bMonocular):
     mbMonocular(bMonocular), mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
+    mpThreadPool(static_cast<ThreadPool*>(NULL)),
     mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true)
 {
     /*
@@ -68,6 +69,12 @@ void LocalMapping::SetTracker(Tracking *pTracker)
     mpTracker=pTracker;
 }
 
+// 设置线程池句柄
+void LocalMapping::SetThreadPool(ThreadPool *pThreadPool)
+{
+    mpThreadPool=pThreadPool;
+}
+
 // 线程主函数
 void LocalMapping::Run()
 {
@@ -129,7 +136,7 @@ void LocalMapping::Run()
                     // 注意这里的第二个参数是按地址传递的,当这里的 mbAbortBA 状态发生变化时，能够及时执行/停止BA
                     //; 把当前帧的一级共视关键帧和他们的地图点作为g2o优化的顶点，加入g2o优化，同时优化地图点和位姿。
                     //; 此外，会把当前帧的二级共视关键帧也加入到g2o中，但是不优化这些帧的位姿，只是作为一个约束
-                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap);  // 局部BA
+                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap, mpThreadPool, &mLocalBAWorkspace);  // 局部BA
 
                 // Check redundant local Keyframes
                 // Step 7 检测并剔除当前帧相邻的关键帧中冗余的关键帧
@@ -145,11 +152,11 @@ void LocalMapping::Run()
         else if(Stop())     // 当要终止当前线程的时候
         {
             // Safe area to stop
-            while(isStopped() && !CheckFinish())
             {
-                // 如果还没有结束利索,那么等
-                // usleep(3000);
-                std::this_thread::sleep_for(std::chrono::milliseconds(3));
+                // 如果还没有结束利索,那么等,直到 Release() 或者 RequestFinish() 把我们唤醒
+                unique_lock<mutex> lock(mMutexWakeUp);
+                while(isStopped() && !CheckFinish())
+                    mCondWakeUp.wait(lock);
             }
             // 然后确定终止了就跳出这个线程的主循环
             if(CheckFinish())
@@ -166,9 +173,12 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;          //; 注意这里是跳出最外面while()的循环
 
-        //usleep(3000);
-        std::this_thread::sleep_for(std::chrono::milliseconds(3));
-
+        // 没有事情可做时阻塞,直到有新的关键帧、停止、复位或者终止请求到来
+        {
+            unique_lock<mutex> lock(mMutexWakeUp);
+            while(!HasPendingEvents())
+                mCondWakeUp.wait(lock);
+        }
     }
 
     // 设置线程已经终止
@@ -178,10 +188,13 @@ void LocalMapping::Run()
 // 插入关键帧,由外部（Tracking）线程调用;这里只是插入到列表中,等待线程主函数对其进行处理
 void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexNewKFs);
-    // 将关键帧插入到列表中
-    mlNewKeyFrames.push_back(pKF);   //; 注意这里是插入到等待处理的关键帧列表中
-    mbAbortBA=true;
+    {
+        unique_lock<mutex> lock(mMutexNewKFs);
+        // 将关键帧插入到列表中
+        mlNewKeyFrames.push_back(pKF);   //; 注意这里是插入到等待处理的关键帧列表中
+        mbAbortBA=true;
+    }
+    WakeUp();
 }
 
 // 查看列表中是否有等待被插入的关键帧,
@@ -333,9 +346,6 @@ void LocalMapping::CreateNewMapPoints()
     // Step 1：在当前关键帧的共视关键帧中找到共视程度最高的nn帧相邻关键帧
     const vector<KeyFrame*> vpNeighKFs = mpCurrentKeyFrame->GetBestCovisibilityKeyFrames(nn);
 
-    // 特征点匹配配置 最佳距离 < 0.6*次佳距离，比较苛刻了。不检查旋转
-    ORBmatcher matcher(0.6,false); 
-
     // 取出当前帧从世界坐标系到相机坐标系的变换矩阵
     cv::Mat Rcw1 = mpCurrentKeyFrame->GetRotation();
     cv::Mat Rwc1 = Rcw1.t();
@@ -360,16 +370,37 @@ void LocalMapping::CreateNewMapPoints()
     // 记录三角化成功的地图点数目
     int nnew=0;
 
+    // 三角化成功、还没有生成地图点的匹配对
+    struct NewPointCandidate
+    {
+        size_t idx1;    ///< 在当前关键帧中的特征点索引
+        size_t idx2;    ///< 在相邻关键帧中的特征点索引
+        cv::Mat x3D;    ///< 三角化得到的世界坐标
+    };
+
+    const int nNeighKFs = vpNeighKFs.size();
+    // 每个相邻关键帧三角化得到的候选点
+    vector<vector<NewPointCandidate> > vvCandidates(nNeighKFs);
+    // 是否因为有新的关键帧插入而放弃了这个相邻关键帧,用 char 是因为不同线程会同时写相邻的元素
+    vector<char> vbAborted(nNeighKFs,0);
+
     // Search matches with epipolar restriction and triangulate
     // Step 2：遍历相邻关键帧，搜索匹配并用极线约束剔除误匹配，最终三角化
-    for(size_t i=0; i<vpNeighKFs.size(); i++)
+    // 这一步只读取关键帧的数据,不同的相邻关键帧之间互不影响,可以并行
+    auto triangulateNeighbor = [&](int i)
     {
         // ! 疑似bug，正确应该是 if(i>0 && !CheckNewKeyFrames())
         //; 确实，不知道这里在判断什么？i>0是什么条件？
         //; 如果还有新插入的关键帧没有处理，那么就别恢复地图点了，赶紧去处理下一帧？
         //; 没看懂？？？这到底在判断什么？？考虑因素是什么？
-        if(i>0 && CheckNewKeyFrames())  
+        if(i>0 && CheckNewKeyFrames())
+        {
+            vbAborted[i] = 1;
             return;
+        }
+
+        // 特征点匹配配置 最佳距离 < 0.6*次佳距离，比较苛刻了。不检查旋转
+        ORBmatcher matcher(0.6,false);
 
         KeyFrame* pKF2 = vpNeighKFs[i];
 
@@ -387,7 +418,7 @@ void LocalMapping::CreateNewMapPoints()
             // 如果是双目相机，关键帧间距小于本身的基线时不生成3D点
             // 因为太短的基线下能够恢复的地图点不稳定
             if(baseline<pKF2->mb)
-            continue;
+            return;
         }
         else    
         {
@@ -398,7 +429,7 @@ void LocalMapping::CreateNewMapPoints()
             const float ratioBaselineDepth = baseline/medianDepthKF2;
             // 如果比例特别小，基线太短恢复3D点不准，那么跳过当前邻接的关键帧，不生成3D点
             if(ratioBaselineDepth<0.01)
-                continue;
+                return;
         }
 
         // Compute Fundamental Matrix
@@ -635,6 +666,30 @@ void LocalMapping::CreateNewMapPoints()
                 continue;
 
             // Triangulation is succesfull
+            // 先记下来,等所有相邻关键帧都处理完之后再按顺序生成地图点
+            NewPointCandidate candidate;
+            candidate.idx1 = idx1;
+            candidate.idx2 = idx2;
+            candidate.x3D = x3D;
+            vvCandidates[i].push_back(candidate);
+        }
+    };
+
+    // 按相邻关键帧的顺序把候选点生成地图点,这样并行时地图点的创建顺序和id也是确定的
+    auto createMapPoints = [&](int i)
+    {
+        KeyFrame* pKF2 = vpNeighKFs[i];
+        const vector<NewPointCandidate> &vCandidates = vvCandidates[i];
+        for(size_t ic=0; ic<vCandidates.size(); ic++)
+        {
+            const size_t idx1 = vCandidates[ic].idx1;
+            const size_t idx2 = vCandidates[ic].idx2;
+            const cv::Mat &x3D = vCandidates[ic].x3D;
+
+            // 并行三角化时,排在前面的相邻关键帧可能已经在这个特征点上生成了地图点
+            if(mpCurrentKeyFrame->GetMapPoint(idx1) || pKF2->GetMapPoint(idx2))
+                continue;
+
             // Step 6.8：三角化生成3D点成功，构造成MapPoint
             //; 注意地图点的RedKF就是生成它的那个关键帧，也就是处理的当前关键帧
             MapPoint* pMP = new MapPoint(x3D,mpCurrentKeyFrame,mpMap);
@@ -663,6 +718,29 @@ void LocalMapping::CreateNewMapPoints()
 
             nnew++;
         }
+        vvCandidates[i].clear();
+    };
+
+    if(mpThreadPool)
+    {
+        mpThreadPool->ParallelFor(nNeighKFs, triangulateNeighbor);
+        for(int i=0; i<nNeighKFs; i++)
+        {
+            if(vbAborted[i])
+                return;
+            createMapPoints(i);
+        }
+    }
+    else
+    {
+        // 串行时每处理完一个相邻关键帧就生成地图点,后面的匹配不会再用到这些特征点
+        for(int i=0; i<nNeighKFs; i++)
+        {
+            triangulateNeighbor(i);
+            if(vbAborted[i])
+                return;
+            createMapPoints(i);
+        }
     }
 }
 
@@ -734,15 +812,27 @@ void LocalMapping::SearchInNeighbors()
     //; 我认为如果不存在效率问题的话，对插入到每个LocalMappping中的关键帧，在三角化生成地图点之后，接着就进行一次对新生成的地图点
     //; 的融合。
     vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
-    for(vector<KeyFrame*>::iterator vit=vpTargetKFs.begin(), vend=vpTargetKFs.end(); vit!=vend; vit++)
-    {
-        KeyFrame* pKFi = *vit;
 
-        // 将地图点投影到关键帧中进行匹配和融合；融合策略如下
-        // 1.如果地图点能匹配关键帧的特征点，并且该点有对应的地图点，那么选择观测数目多的替换两个地图点
-        // 2.如果地图点能匹配关键帧的特征点，并且该点没有对应的地图点，那么为该点添加该投影地图点
+    // 将地图点投影到关键帧中进行匹配和融合；融合策略如下
+    // 1.如果地图点能匹配关键帧的特征点，并且该点有对应的地图点，那么选择观测数目多的替换两个地图点
+    // 2.如果地图点能匹配关键帧的特征点，并且该点没有对应的地图点，那么为该点添加该投影地图点
+    // 投影匹配只读取数据,每个目标关键帧交给一个线程;融合会修改地图点之间的替换关系,
+    // 所以按 vpTargetKFs 的顺序在当前线程中进行,结果不受线程调度的影响
+    const int nTargetKFs = vpTargetKFs.size();
+    vector<vector<int> > vvnMatchedIdx(nTargetKFs);
+    if(mpThreadPool)
+    {
+        mpThreadPool->ParallelFor(nTargetKFs, [&](int i){
+            matcher.SearchForFuse(vpTargetKFs[i],vpMapPointMatches,vvnMatchedIdx[i]);
+        });
+        for(int i=0; i<nTargetKFs; i++)
+            matcher.FuseMatches(vpTargetKFs[i],vpMapPointMatches,vvnMatchedIdx[i]);
+    }
+    else
+    {
         // 注意这个时候对地图点融合的操作是立即生效的
-        matcher.Fuse(pKFi,vpMapPointMatches);
+        for(int i=0; i<nTargetKFs; i++)
+            matcher.Fuse(vpTargetKFs[i],vpMapPointMatches);
     }
 
     // Search matches by projection from target KFs in current KF
@@ -829,25 +919,30 @@ cv::Mat LocalMapping::ComputeF12(KeyFrame *&pKF1, KeyFrame *&pKF2)
 // 外部线程调用,请求停止当前线程的工作; 其实是回环检测线程调用,来避免在进行全局优化的过程中局部建图线程添加新的关键帧
 void LocalMapping::RequestStop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopRequested = true;
-    unique_lock<mutex> lock2(mMutexNewKFs);
-    mbAbortBA = true;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopRequested = true;
+        unique_lock<mutex> lock2(mMutexNewKFs);
+        mbAbortBA = true;
+    }
+    WakeUp();
 }
 
 // 检查是否要把当前的局部建图线程停止工作,运行的时候要检查是否有终止请求,如果有就执行. 由run函数调用
 bool LocalMapping::Stop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    // 如果当前线程还没有准备停止,但是已经有终止请求了,那么就准备停止当前线程
-    if(mbStopRequested && !mbNotStop)
     {
+        unique_lock<mutex> lock(mMutexStop);
+        // 如果当前线程还没有准备停止,但是已经有终止请求了,那么就准备停止当前线程
+        if(!mbStopRequested || mbNotStop)
+            return false;
+
         mbStopped = true;
         cout << "Local Mapping STOP" << endl;
-        return true;
     }
-
-    return false;
+    // 通知在 WaitUntilStopped() 中等待的线程
+    WakeUp();
+    return true;
 }
 
 // 检查mbStopped是否为true，为true表示可以并终止localmapping 线程
@@ -867,17 +962,21 @@ bool LocalMapping::stopRequested()
 // 释放当前还在缓冲区中的关键帧指针
 void LocalMapping::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    unique_lock<mutex> lock2(mMutexFinish);
-    if(mbFinished)
-        return;
-    mbStopped = false;
-    mbStopRequested = false;
-    for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
-        delete *lit;
-    mlNewKeyFrames.clear();
-
-    cout << "Local Mapping RELEASE" << endl;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        unique_lock<mutex> lock2(mMutexFinish);
+        if(mbFinished)
+            return;
+        mbStopped = false;
+        mbStopRequested = false;
+        for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
+            delete *lit;
+        mlNewKeyFrames.clear();
+
+        cout << "Local Mapping RELEASE" << endl;
+    }
+    // 唤醒停在 Run() 安全区中的局部建图线程
+    WakeUp();
 }
 
 // 查看当前是否允许接受关键帧
@@ -897,20 +996,33 @@ void LocalMapping::SetAcceptKeyFrames(bool flag)
 // 设置 mbnotStop标志的状态
 bool LocalMapping::SetNotStop(bool flag)
 {
-    unique_lock<mutex> lock(mMutexStop);
+    {
+        unique_lock<mutex> lock(mMutexStop);
 
-    //已经处于!flag的状态了
-    // 就是我希望线程先不要停止,但是经过检查这个时候线程已经停止了...
-    if(flag && mbStopped)
-        //设置失败
-        return false;
+        //已经处于!flag的状态了
+        // 就是我希望线程先不要停止,但是经过检查这个时候线程已经停止了...
+        if(flag && mbStopped)
+            //设置失败
+            return false;
 
-    //设置为要设置的状态
-    mbNotStop = flag;
+        //设置为要设置的状态
+        mbNotStop = flag;
+    }
+    // 取消 mbNotStop 之后,之前被它挡住的停止请求可以响应了
+    if(!flag)
+        WakeUp();
     //设置成功
     return true;
 }
 
+// 阻塞等待局部建图线程真正停下来,SetFinish() 也会把 mbStopped 置位
+void LocalMapping::WaitUntilStopped()
+{
+    unique_lock<mutex> lock(mMutexWakeUp);
+    while(!isStopped())
+        mCondWakeUp.wait(lock);
+}
+
 // 终止BA
 void LocalMapping::InterruptBA()
 {
@@ -941,6 +1053,9 @@ void LocalMapping::KeyFrameCulling()
     // Step 1：根据共视图提取当前关键帧的所有共视关键帧
     vector<KeyFrame*> vpLocalKeyFrames = mpCurrentKeyFrame->GetVectorCovisibleKeyFrames();
 
+    // 在循环外定义,复用内存
+    ObservationMap observations;
+
     // 对所有的共视关键帧进行遍历
     for(vector<KeyFrame*>::iterator vit=vpLocalKeyFrames.begin(), vend=vpLocalKeyFrames.end(); vit!=vend; vit++)
     {
@@ -948,6 +1063,7 @@ void LocalMapping::KeyFrameCulling()
         // 第1个关键帧不能删除，跳过
         if(pKF->mnId==0)
             continue;
+        pKF->LoadFeatures();
         // Step 2：提取每个共视关键帧的地图点
         const vector<MapPoint*> vpMapPoints = pKF->GetMapPointMatches();
 
@@ -981,15 +1097,16 @@ void LocalMapping::KeyFrameCulling()
                     {
                         const int &scaleLevel = pKF->mvKeysUn[i].octave;
                         // Observation存储的是可以看到该地图点的所有关键帧的集合
-                        const map<KeyFrame*, size_t> observations = pMP->GetObservations();
+                        pMP->GetObservations(observations);
 
                         int nObs=0;
                         // 遍历观测到该地图点的关键帧
-                        for(map<KeyFrame*, size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+                        for(ObservationMap::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
                         {
                             KeyFrame* pKFi = mit->first;
                             if(pKFi==pKF)
                                 continue;
+                            pKFi->LoadFeatures();
                             const int &scaleLeveli = pKFi->mvKeysUn[mit->second].octave;
 
                             // 尺度约束：为什么pKF 尺度+1 要大于等于 pKFi 尺度？
@@ -1035,7 +1152,10 @@ void LocalMapping::RequestReset()
         mbResetRequested = true;
     }
 
+    WakeUp();
+
     // 一直等到局部建图线程响应之后才可以退出
+    unique_lock<mutex> lock(mMutexWakeUp);
     while(1)
     {
         {
@@ -1043,32 +1163,37 @@ void LocalMapping::RequestReset()
             if(!mbResetRequested)
                 break;
         }
-        //usleep(3000);
-        std::this_thread::sleep_for(std::chrono::milliseconds(3));
-
+        mCondWakeUp.wait(lock);
     }
 }
 
 // 检查是否有复位线程的请求
 void LocalMapping::ResetIfRequested()
 {
-    unique_lock<mutex> lock(mMutexReset);
-    // 执行复位操作:清空关键帧缓冲区,清空待cull的地图点缓冲
-    
-    if(mbResetRequested)
     {
+        unique_lock<mutex> lock(mMutexReset);
+        // 执行复位操作:清空关键帧缓冲区,清空待cull的地图点缓冲
+
+        if(!mbResetRequested)
+            return;
+
         mlNewKeyFrames.clear();
         mlpRecentAddedMapPoints.clear();
         // 恢复为false表示复位过程完成
         mbResetRequested=false;
     }
+    // 通知在 RequestReset() 中等待的线程
+    WakeUp();
 }
 
 // 请求终止当前线程
 void LocalMapping::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    WakeUp();
 }
 
 // 检查是否已经有外部线程请求终止当前线程
@@ -1081,10 +1206,13 @@ bool LocalMapping::CheckFinish()
 // 设置当前线程已经真正地结束了
 void LocalMapping::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;    // 线程已经被结束
-    unique_lock<mutex> lock2(mMutexStop);
-    mbStopped = true;     //既然已经都结束了,那么当前线程也已经停止工作了
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;    // 线程已经被结束
+        unique_lock<mutex> lock2(mMutexStop);
+        mbStopped = true;     //既然已经都结束了,那么当前线程也已经停止工作了
+    }
+    WakeUp();
 }
 
 // 当前线程的run函数是否已经终止
@@ -1094,4 +1222,38 @@ bool LocalMapping::isFinished()
     return mbFinished;
 }
 
+// 阻塞等待当前线程的run函数终止
+void LocalMapping::WaitUntilFinished()
+{
+    unique_lock<mutex> lock(mMutexWakeUp);
+    while(!isFinished())
+        mCondWakeUp.wait(lock);
+}
+
+// 先获取再释放 mMutexWakeUp,保证等待的线程要么还没有检查条件,要么已经在 wait 中,不会错过这次通知
+void LocalMapping::WakeUp()
+{
+    {
+        unique_lock<mutex> lock(mMutexWakeUp);
+    }
+    mCondWakeUp.notify_all();
+}
+
+// 主循环空闲时的唤醒条件,和 Run() 中各个分支的处理条件一一对应
+bool LocalMapping::HasPendingEvents()
+{
+    if(CheckNewKeyFrames() || CheckFinish())
+        return true;
+
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        if(mbResetRequested)
+            return true;
+    }
+
+    // 被 mbNotStop 挡住的停止请求现在还不能响应,SetNotStop(false) 时会再次唤醒
+    unique_lock<mutex> lock(mMutexStop);
+    return mbStopRequested && !mbNotStop;
+}
+
 } //namespace ORB_SLAM
@@ -43,7 +43,7 @@ namespace ORB_SLAM2
 // 构造函数
 LoopClosing::LoopClosing(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale):
     mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
+    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpThreadPool(NULL), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
     mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0)
 {
     // 连续性阈值
@@ -61,6 +61,12 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper)
     mpLocalMapper=pLocalMapper;
 }
 
+// 设置线程池句柄
+void LoopClosing::SetThreadPool(ThreadPool *pThreadPool)
+{
+    mpThreadPool=pThreadPool;
+}
+
 // 回环线程主函数
 void LoopClosing::Run()
 {
@@ -95,9 +101,12 @@ void LoopClosing::Run()
         if(CheckFinish())
             break;
 
-        //usleep(5000);
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
-
+        // 没有事情可做时阻塞,直到有新的关键帧、复位或者终止请求到来
+        {
+            unique_lock<mutex> lock(mMutexWakeUp);
+            while(!HasPendingEvents())
+                mCondWakeUp.wait(lock);
+        }
 	}
 
     // 运行到这里说明有外部线程请求终止当前线程,在这个函数中执行终止当前线程的一些操作
@@ -107,10 +116,14 @@ void LoopClosing::Run()
 // 将某个关键帧加入到回环检测的过程中,由局部建图线程调用
 void LoopClosing::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    // 注意：这里第0个关键帧不能够参与到回环检测的过程中,因为第0关键帧定义了整个地图的世界坐标系
-    if(pKF->mnId!=0)
+    {
+        unique_lock<mutex> lock(mMutexLoopQueue);
+        // 注意：这里第0个关键帧不能够参与到回环检测的过程中,因为第0关键帧定义了整个地图的世界坐标系
+        if(pKF->mnId==0)
+            return;
         mlpLoopKeyFrameQueue.push_back(pKF);
+    }
+    WakeUp();
 }
 
 /*
@@ -671,10 +684,7 @@ void LoopClosing::CorrectLoop()
 
     // Wait until Local Mapping has effectively stopped
     // 一直等到局部地图线程结束再继续
-    while(!mpLocalMapper->isStopped())
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    mpLocalMapper->WaitUntilStopped();
 
     // Ensure current keyframe is updated
     // Step 1：根据共视关系更新当前关键帧与其它关键帧之间的连接关系
@@ -969,7 +979,10 @@ void LoopClosing::RequestReset()
         mbResetRequested = true;
     }
 
+    WakeUp();
+
     // 堵塞,直到回环检测线程复位完成
+    unique_lock<mutex> lock(mMutexWakeUp);
     while(1)
     {
         {
@@ -977,23 +990,25 @@ void LoopClosing::RequestReset()
         if(!mbResetRequested)
             break;
         }
-		//usleep(5000);
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
-
+        mCondWakeUp.wait(lock);
     }
 }
 
 // 当前线程调用,检查是否有外部线程请求复位当前线程,如果有的话就复位回环检测线程
 void LoopClosing::ResetIfRequested()
 {
-    unique_lock<mutex> lock(mMutexReset);
-    // 如果有来自于外部的线程的复位请求,那么就复位当前线程
-    if(mbResetRequested)
     {
+        unique_lock<mutex> lock(mMutexReset);
+        // 如果有来自于外部的线程的复位请求,那么就复位当前线程
+        if(!mbResetRequested)
+            return;
+
         mlpLoopKeyFrameQueue.clear();   // 清空参与和进行回环检测的关键帧队列
         mLastLoopKFid=0;                // 上一次没有和任何关键帧形成闭环关系
         mbResetRequested=false;         // 复位请求标志复位
     }
+    // 通知在 RequestReset() 中等待的线程
+    WakeUp();
 }
 /**
  * @brief 全局BA线程,这个是这个线程的主函数
@@ -1015,7 +1030,8 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
                                       10,           // 迭代次数
                                       &mbStopGBA,   // 外界控制 GBA 停止的标志
                                       nLoopKF,      // 形成了闭环的当前关键帧的id
-                                      false);       // 不使用鲁棒核函数
+                                      false,        // 不使用鲁棒核函数
+                                      mpThreadPool);// 在线程池上并行线性化和计算Schur补
 
     // Update all MapPoints and KeyFrames
     // Local Mapping was active during BA, that means that there might be new keyframes
@@ -1042,12 +1058,8 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            // 等待直到local mapping结束才会继续后续操作
-            while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-				//usleep(1000);
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
-			}
+            // 等待直到local mapping停止(或者已经结束)才会继续后续操作
+            mpLocalMapper->WaitUntilStopped();
 
             // Get Map Mutex
             // 后续要更新地图所以要上锁
@@ -1143,14 +1155,20 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
 
         mbFinishedGBA = true;
         mbRunningGBA = false;
-    } 
+    }
+
+    // 通知在 WaitUntilFinished() 中等待全局BA结束的线程
+    WakeUp();
 }
 
 // 由外部线程调用,请求终止当前线程
 void LoopClosing::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    WakeUp();
 }
 
 // 当前线程调用,查看是否有外部线程请求当前线程
@@ -1163,8 +1181,11 @@ bool LoopClosing::CheckFinish()
 // 有当前线程调用,执行完成该函数之后线程主函数退出,线程销毁
 void LoopClosing::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    WakeUp();
 }
 
 // 由外部线程调用,判断当前回环检测线程是否已经正确终止了
@@ -1174,5 +1195,32 @@ bool LoopClosing::isFinished()
     return mbFinished;
 }
 
+// 由外部线程调用,阻塞等待回环检测线程终止,并且没有正在运行的全局BA
+void LoopClosing::WaitUntilFinished()
+{
+    unique_lock<mutex> lock(mMutexWakeUp);
+    while(!isFinished() || isRunningGBA())
+        mCondWakeUp.wait(lock);
+}
+
+// 先获取再释放 mMutexWakeUp,保证等待的线程要么还没有检查条件,要么已经在 wait 中,不会错过这次通知
+void LoopClosing::WakeUp()
+{
+    {
+        unique_lock<mutex> lock(mMutexWakeUp);
+    }
+    mCondWakeUp.notify_all();
+}
+
+// 主循环空闲时的唤醒条件
+bool LoopClosing::HasPendingEvents()
+{
+    if(CheckNewKeyFrames() || CheckFinish())
+        return true;
+
+    unique_lock<mutex> lock(mMutexReset);
+    return mbResetRequested;
+}
+
 
 } //namespace ORB_SLAM
@@ -31,6 +31,7 @@
 
 
 #include "Map.h"
+#include "Serializer.h"
 
 #include<mutex>
 
@@ -180,4 +181,31 @@ void Map::clear()
     mvpKeyFrameOrigins.clear();
 }
 
+// 保存初始关键帧的id
+void Map::Save(std::ostream &f)
+{
+    unique_lock<mutex> lock(mMutexMap);
+    vector<long unsigned int> vOriginIds;
+    for(size_t i=0; i<mvpKeyFrameOrigins.size(); i++)
+        if(!mvpKeyFrameOrigins[i]->isBad())
+            vOriginIds.push_back(mvpKeyFrameOrigins[i]->mnId);
+    Serializer::WriteVector(f,vOriginIds);
+}
+
+// 读取初始关键帧
+void Map::Load(std::istream &f, const std::map<long unsigned int, KeyFrame*> &mKFs)
+{
+    vector<long unsigned int> vOriginIds;
+    Serializer::ReadVector(f,vOriginIds);
+
+    unique_lock<mutex> lock(mMutexMap);
+    mvpKeyFrameOrigins.clear();
+    for(size_t i=0; i<vOriginIds.size(); i++)
+    {
+        map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(vOriginIds[i]);
+        if(mit!=mKFs.end())
+            mvpKeyFrameOrigins.push_back(mit->second);
+    }
+}
+
 } //namespace ORB_SLAM
@@ -20,6 +20,8 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "Serializer.h"
+#include "Converter.h"
 
 #include<mutex>
 
@@ -29,6 +31,15 @@ namespace ORB_SLAM2
 long unsigned int MapPoint::nNextId=0;
 mutex MapPoint::mGlobalMutex;
 
+// 描述子距离表中还没有计算的距离,ORB描述子的汉明距离最大是256
+static const uint16_t DESC_DIST_UNKNOWN = 0xFFFF;
+
+// 描述子距离表是按行存储的严格下三角,返回第i个和第j个观测(i>j)的距离的下标
+static inline size_t TriangleIndex(size_t i, size_t j)
+{
+    return i*(i-1)/2+j;
+}
+
 /**
  * @brief Construct a new Map Point:: Map Point object
  * 
@@ -50,6 +61,7 @@ MapPoint::MapPoint(const cv::Mat &Pos,  //地图点的世界坐标
     mnCorrectedByKF(0),                     //
     mnCorrectedReference(0),                //
     mnBAGlobalForKF(0),                     //
+    mbDescriptorDirty(true),                //还没有选择过描述子
     mpRefKF(pRefKF),                        //
     mnVisible(1),                           //在帧中的可视次数
     mnFound(1),                             //被找到的次数 和上面的相比要求能够匹配上
@@ -62,6 +74,8 @@ MapPoint::MapPoint(const cv::Mat &Pos,  //地图点的世界坐标
     Pos.copyTo(mWorldPos);
     //平均观测方向初始化为0
     mNormalVector = cv::Mat::zeros(3,1,CV_32F);
+    mWorldPosEig = Converter::toVector3f(mWorldPos);
+    mNormalVectorEig.setZero();
 
     // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
     unique_lock<mutex> lock(mpMap->mMutexPointCreation);
@@ -80,13 +94,15 @@ MapPoint::MapPoint(const cv::Mat &Pos,  //地图点的世界坐标
 MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF):
     mnFirstKFid(-1), mnFirstFrame(pFrame->mnId), nObs(0), mnTrackReferenceForFrame(0), mnLastFrameSeen(0),
     mnBALocalForKF(0), mnFuseCandidateForKF(0),mnLoopPointForKF(0), mnCorrectedByKF(0),
-    mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
-    mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap)
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mbDescriptorDirty(true), mpRefKF(static_cast<KeyFrame*>(NULL)),
+    mnVisible(1), mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap)
 {
     Pos.copyTo(mWorldPos);
     cv::Mat Ow = pFrame->GetCameraCenter();
     mNormalVector = mWorldPos - Ow;// 世界坐标系下相机到3D点的向量 (当前关键帧的观测方向)
     mNormalVector = mNormalVector/cv::norm(mNormalVector);// 单位化
+    mWorldPosEig = Converter::toVector3f(mWorldPos);
+    mNormalVectorEig = Converter::toVector3f(mNormalVector);
 
     //这个算重了吧
     cv::Mat PC = Pos - Ow;
@@ -119,6 +135,7 @@ void MapPoint::SetWorldPos(const cv::Mat &Pos)
     unique_lock<mutex> lock2(mGlobalMutex);
     unique_lock<mutex> lock(mMutexPos);
     Pos.copyTo(mWorldPos);
+    mWorldPosEig = Converter::toVector3f(mWorldPos);
 }
 //获取地图点在世界坐标系下的坐标
 cv::Mat MapPoint::GetWorldPos()
@@ -133,6 +150,18 @@ cv::Mat MapPoint::GetNormal()
     unique_lock<mutex> lock(mMutexPos);
     return mNormalVector.clone();
 }
+
+Eigen::Vector3f MapPoint::GetWorldPosEigen()
+{
+    unique_lock<mutex> lock(mMutexPos);
+    return mWorldPosEig;
+}
+
+Eigen::Vector3f MapPoint::GetNormalEigen()
+{
+    unique_lock<mutex> lock(mMutexPos);
+    return mNormalVectorEig;
+}
 //获取地图点的参考关键帧
 KeyFrame* MapPoint::GetReferenceKeyFrame()
 {
@@ -157,7 +186,11 @@ void MapPoint::AddObservation(KeyFrame* pKF, size_t idx)
     if(mObservations.count(pKF)) 
         return;
     // 如果没有添加过观测，记录下能观测到该MapPoint的KF和该MapPoint在KF中的索引
+    // 新的观测和已有的每个观测之间都多了一个共视地图点,坏点不计入共视
+    if(!mbBad)
+        UpdateCovisibility(pKF,1);
     mObservations[pKF]=idx;   //; 注意这是一个map, 是用关键帧作为索引
+    InsertDescriptorDistances(mObservations.find(pKF)-mObservations.begin());
 
     if(pKF->mvuRight[idx]>=0)
         nObs+=2; // 双目或者rgbd
@@ -165,6 +198,74 @@ void MapPoint::AddObservation(KeyFrame* pKF, size_t idx)
         nObs++; // 单目
 }
 
+// 在描述子距离表中插入新观测的一行和一列,它和其他描述子的距离等到需要时再计算
+void MapPoint::InsertDescriptorDistances(size_t pos)
+{
+    // 插入后的观测数目
+    const size_t n = mObservations.size();
+    mvDescDistances.resize(n*(n-1)/2);
+
+    // 原来的(i,j)移动到(i+(i>=pos), j+(j>=pos)),新的下标不小于原来的下标,从后往前原地移动
+    for(size_t i=n-1; i>0; i--)
+    {
+        const size_t iOld = i>pos ? i-1 : i;
+        for(size_t j=i; j-->0;)
+        {
+            uint16_t &d = mvDescDistances[TriangleIndex(i,j)];
+            if(i==pos || j==pos)
+                d = DESC_DIST_UNKNOWN;
+            else
+                d = mvDescDistances[TriangleIndex(iOld, j>pos ? j-1 : j)];
+        }
+    }
+
+    mbDescriptorDirty = true;
+}
+
+// pKF 和其他观测到该地图点的关键帧之间的共视程度都改变 n
+void MapPoint::UpdateCovisibility(KeyFrame* pKF, int n)
+{
+    for(ObservationMap::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+    {
+        if(mit->first==pKF)
+            continue;
+        mit->first->ChangeCovisibility(pKF,n);
+        pKF->ChangeCovisibility(mit->first,n);
+    }
+}
+
+// 地图点要被删除了,观测到它的关键帧两两之间的共视程度都减一
+void MapPoint::ClearCovisibility()
+{
+    for(ObservationMap::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+    {
+        ObservationMap::iterator mit2 = mit;
+        for(mit2++; mit2!=mend; mit2++)
+        {
+            mit->first->ChangeCovisibility(mit2->first,-1);
+            mit2->first->ChangeCovisibility(mit->first,-1);
+        }
+    }
+}
+
+// 从描述子距离表中删除一个观测的一行和一列
+void MapPoint::EraseDescriptorDistances(size_t pos)
+{
+    // 删除后的观测数目
+    const size_t n = mObservations.size();
+
+    // 原来的(i+(i>=pos), j+(j>=pos))移动到(i,j),新的下标不大于原来的下标,从前往后原地移动
+    for(size_t i=1; i<n; i++)
+    {
+        const size_t iOld = i>=pos ? i+1 : i;
+        for(size_t j=0; j<i; j++)
+            mvDescDistances[TriangleIndex(i,j)] = mvDescDistances[TriangleIndex(iOld, j>=pos ? j+1 : j)];
+    }
+    mvDescDistances.resize(n>0 ? n*(n-1)/2 : 0);
+
+    mbDescriptorDirty = true;
+}
+
 
 // 删除某个关键帧对当前地图点的观测
 void MapPoint::EraseObservation(KeyFrame* pKF)
@@ -173,15 +274,20 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
     {
         unique_lock<mutex> lock(mMutexFeatures);
         // 查找这个要删除的观测,根据单目和双目类型的不同从其中删除当前地图点的被观测次数
-        if(mObservations.count(pKF))
+        ObservationMap::iterator mit = mObservations.find(pKF);
+        if(mit!=mObservations.end())
         {
-            int idx = mObservations[pKF];
+            int idx = mit->second;
             if(pKF->mvuRight[idx]>=0)  // 双目或者rgbd
                 nObs-=2;
             else
                 nObs--;
 
-            mObservations.erase(pKF);  // 从观测关系中删除这个关键帧
+            const size_t pos = mit-mObservations.begin();
+            mObservations.erase(mit);  // 从观测关系中删除这个关键帧
+            EraseDescriptorDistances(pos);
+            if(!mbBad)
+                UpdateCovisibility(pKF,-1);
 
             // 如果该keyFrame是参考帧，该Frame被删除后重新指定RefFrame
             if(mpRefKF==pKF)
@@ -200,12 +306,18 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
 }
 
 // 能够观测到当前地图点的所有关键帧及该地图点在KF中的索引
-map<KeyFrame*, size_t> MapPoint::GetObservations()
+ObservationMap MapPoint::GetObservations()
 {
     unique_lock<mutex> lock(mMutexFeatures);
     return mObservations;
 }
 
+void MapPoint::GetObservations(ObservationMap &observations)
+{
+    unique_lock<mutex> lock(mMutexFeatures);
+    observations = mObservations;
+}
+
 // 被观测到的相机数目，单目+1，双目或RGB-D则+2
 int MapPoint::Observations()
 {
@@ -219,17 +331,19 @@ int MapPoint::Observations()
  */
 void MapPoint::SetBadFlag()
 {
-    map<KeyFrame*,size_t> obs;
+    ObservationMap obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         mbBad=true;
         // 把mObservations转存到obs，obs和mObservations里存的是指针，赋值过程为浅拷贝
         obs = mObservations;
+        ClearCovisibility();
         // 把mObservations指向的内存释放，obs作为局部变量之后自动删除
         mObservations.clear();
+        mvDescDistances.clear();
     }
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationMap::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         // 告诉可以观测到该MapPoint的KeyFrame，该MapPoint被删了
@@ -264,13 +378,15 @@ void MapPoint::Replace(MapPoint* pMP)
 
     // 清除当前地图点的信息，这一段和SetBadFlag函数相同
     int nvisible, nfound;
-    map<KeyFrame*,size_t> obs;
+    ObservationMap obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         obs=mObservations;
+        ClearCovisibility();
         //清除当前地图点的原有观测
         mObservations.clear();
+        mvDescDistances.clear();
         //当前的地图点被删除了
         mbBad=true;
         //暂存当前地图点的可视次数和被找到的次数
@@ -284,7 +400,7 @@ void MapPoint::Replace(MapPoint* pMP)
     //- 将观测到当前地图的的关键帧的信息进行更新
     //; obs是this地图点的观测关系，first是被哪个关键帧观测到，second是对应于这个关键帧中特征点的索引
     //; 遍历观测到这个地图点的所有关键帧
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationMap::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         // Replace measurement in keyframe
         KeyFrame* pKF = mit->first;
@@ -364,90 +480,97 @@ float MapPoint::GetFoundRatio()
  *
  * 由于一个地图点会被许多相机观测到，因此在插入关键帧后，需要判断是否更新代表当前点的描述子 
  * 先获得当前点的所有描述子，然后计算描述子之间的两两距离，最好的描述子与其他描述子应该具有最小的距离中值
+ * 描述子和它们之间的距离在增删观测时已经缓存,这里只计算新观测带来的距离;观测没有变化时直接返回
  */
 void MapPoint::ComputeDistinctiveDescriptors()
 {
-    // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
-
-    map<KeyFrame*,size_t> observations;
-
-    // Step 1 获取该地图点所有有效的观测关键帧信息
+    // Step 1 获取该地图点所有观测关键帧,关键帧的状态要在不持有本地图点锁的情况下查询
+    vector<KeyFrame*> vpKFs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
-        if(mbBad)
+        if(mbBad || !mbDescriptorDirty)
             return;
-        observations=mObservations;
+        vpKFs.reserve(mObservations.size());
+        for(ObservationMap::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+            vpKFs.push_back(mit->first);
     }
 
-    if(observations.empty())  // 这个地图点没有被任何关键帧观测到
+    if(vpKFs.empty())  // 这个地图点没有被任何关键帧观测到
         return;
 
-    vDescriptors.reserve(observations.size());
+    // 已经被删除的关键帧,vpKFs 是有序的,所以这里也是有序的
+    vector<KeyFrame*> vpBadKFs;
+    for(size_t i=0; i<vpKFs.size(); i++)
+        if(vpKFs[i]->isBad())
+            vpBadKFs.push_back(vpKFs[i]);
 
-    // Step 2 遍历观测到该地图点的所有关键帧，对应的orb描述子，放到向量vDescriptors中
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
-    {
-        // mit->first取观测到该地图点的关键帧
-        // mit->second取该地图点在关键帧中的索引
-        KeyFrame* pKF = mit->first;
+    unique_lock<mutex> lock(mMutexFeatures);
+    if(mbBad)
+        return;
 
-        if(!pKF->isBad())       // 如果这个关键帧还是好的，说明没有被删除
-            // 取对应的描述子向量                                               
-            vDescriptors.push_back(pKF->mDescriptors.row(mit->second));    // 按照索引，寻找关键帧中对应序号的描述子 
-    }
+    // Step 2 找出属于有效关键帧的观测在 mObservations 中的位置
+    // 在上面查询关键帧状态的时候观测可能又发生了变化,这时 mbDescriptorDirty 会被重新置位,下次调用时再更新
+    mbDescriptorDirty = false;
+    vector<size_t> vValid;
+    vValid.reserve(mObservations.size());
+    for(ObservationMap::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+        if(!binary_search(vpBadKFs.begin(),vpBadKFs.end(),mit->first))
+            vValid.push_back(mit-mObservations.begin());
 
-    if(vDescriptors.empty())
+    if(vValid.empty())
         return;
 
     // Compute distances between them
-    // Step 3 计算这些描述子两两之间的距离
+    // Step 3 补全这些描述子两两之间还没有计算过的距离,描述子直接从关键帧中取
     // N表示为一共多少个描述子
-    const size_t N = vDescriptors.size();
-	
-    // 将Distances表述成一个对称的矩阵
-    // float Distances[N][N];
-	std::vector<std::vector<float> > Distances;
-	Distances.resize(N, vector<float>(N, 0));
-	for (size_t i = 0; i<N; i++)
+    const size_t N = vValid.size();
+    for(size_t i=1; i<N; i++)
     {
-        // 和自己的距离当然是0
-        Distances[i][i]=0;
-        // 计算并记录不同描述子距离
-        for(size_t j=i+1;j<N;j++)
+        const ObservationMap::value_type &obsi = *(mObservations.begin()+vValid[i]);
+        for(size_t j=0; j<i; j++)
         {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
+            uint16_t &d = mvDescDistances[TriangleIndex(vValid[i],vValid[j])];
+            if(d!=DESC_DIST_UNKNOWN)
+                continue;
+            const ObservationMap::value_type &obsj = *(mObservations.begin()+vValid[j]);
+            d = ORBmatcher::DescriptorDistance(obsi.first->mDescriptors.row(obsi.second),
+                                               obsj.first->mDescriptors.row(obsj.second));
         }
     }
 
     // Take the descriptor with least median distance to the rest
     // Step 4 选择最有代表性的描述子，它与其他描述子应该具有最小的距离中值
     int BestMedian = INT_MAX;   // 记录最小的中值
-    int BestIdx = 0;            // 最小中值对应的索引
+    size_t BestIdx = 0;         // 最小中值对应的观测位置
+    const size_t nMedian = 0.5*(N-1);
+    vector<int> vDists(N);
     for(size_t i=0;i<N;i++)
     {
         // 第i个描述子到其它所有描述子之间的距离
-        // vector<int> vDists(Distances[i],Distances[i]+N);
-		vector<int> vDists(Distances[i].begin(), Distances[i].end());
-		sort(vDists.begin(), vDists.end());
+        for(size_t j=0; j<N; j++)
+        {
+            if(j<i)
+                vDists[j] = mvDescDistances[TriangleIndex(vValid[i],vValid[j])];
+            else if(j>i)
+                vDists[j] = mvDescDistances[TriangleIndex(vValid[j],vValid[i])];
+            else
+                vDists[j] = 0;
+        }
+        nth_element(vDists.begin(), vDists.begin()+nMedian, vDists.end());
 
         // 获得中值
-        int median = vDists[0.5*(N-1)]; // 对第i个描述子，计算它和其他描述子距离的中值
+        int median = vDists[nMedian]; // 对第i个描述子，计算它和其他描述子距离的中值
         
         // 寻找最小的中值
         if(median<BestMedian)  // 对所有描述子，比较中值的大小，选择最小的那一个
         {
             BestMedian = median;
-            BestIdx = i;
+            BestIdx = vValid[i];
         }
     }
 
-    {
-        unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();       
-    }
+    const ObservationMap::value_type &best = *(mObservations.begin()+BestIdx);
+    mDescriptor = best.first->mDescriptors.row(best.second).clone();
 }
 
 // 获取当前地图点的描述子
@@ -495,7 +618,7 @@ bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 void MapPoint::UpdateNormalAndDepth()
 {
     // Step 1 获得观测到该地图点的所有关键帧、坐标等信息
-    map<KeyFrame*,size_t> observations;
+    ObservationMap observations;
     KeyFrame* pRefKF;  // 参考关键帧
     cv::Mat Pos;
     {
@@ -517,7 +640,7 @@ void MapPoint::UpdateNormalAndDepth()
     // 初始值为0向量，累加为归一化向量，最后除以总数n
     cv::Mat normal = cv::Mat::zeros(3,1,CV_32F);
     int n=0;
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(ObservationMap::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;       // 观测到这个地图点的关键帧
         cv::Mat Owi = pKF->GetCameraCenter(); // 观测到这个地图点的关键帧所在坐标系原点在世界坐标系下的位置
@@ -530,6 +653,7 @@ void MapPoint::UpdateNormalAndDepth()
     // 这个计算的是地图点在参考关键帧下的位置，对应的dist就是地图点离参考关键帧的距离（注意地图点的参考关键帧就是生成它的那个关键帧）
     cv::Mat PC = Pos - pRefKF->GetCameraCenter();                           // 参考关键帧相机指向地图点的向量（在世界坐标系下的表示）
     const float dist = cv::norm(PC);                                        // 该点到参考关键帧相机的距离
+    pRefKF->LoadFeatures();
     const int level = pRefKF->mvKeysUn[observations[pRefKF]].octave;        // 观测到该地图点的当前帧的特征点在金字塔的第几层
     const float levelScaleFactor =  pRefKF->mvScaleFactors[level];          // 当前金字塔层对应的尺度因子，scale^n，scale=1.2，n为层数
     const int nLevels = pRefKF->mnScaleLevels;                              // 金字塔总层数，默认为8
@@ -540,6 +664,7 @@ void MapPoint::UpdateNormalAndDepth()
         mfMaxDistance = dist*levelScaleFactor;                              // 观测到该点的距离上限
         mfMinDistance = mfMaxDistance/pRefKF->mvScaleFactors[nLevels-1];    // 观测到该点的距离下限
         mNormalVector = normal/n;                                           // 获得地图点平均的观测方向
+        mNormalVectorEig = Converter::toVector3f(mNormalVector);
     }
 }
 
@@ -634,6 +759,94 @@ int MapPoint::PredictScale(const float &currentDist, Frame* pF)
     return nScale;
 }
 
+/**
+ * @brief 加载地图时使用的构造函数,和正常运行时一样在mMutexPointCreation的保护下分配id,之后由Load()改成保存的id
+ */
+MapPoint::MapPoint(const long int &nFirstKFid, const long int &nFirstFrame, Map* pMap):
+    mnFirstKFid(nFirstKFid), mnFirstFrame(nFirstFrame), nObs(0), mnTrackReferenceForFrame(0),
+    mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mbDescriptorDirty(true), mpRefKF(static_cast<KeyFrame*>(NULL)),
+    mnVisible(1), mnFound(1), mbBad(false), mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap)
+{
+    unique_lock<mutex> lock(mpMap->mMutexPointCreation);
+    mnId=nNextId++;
+}
+
+// 保存地图点
+void MapPoint::Save(std::ostream &f)
+{
+    Serializer::Write(f,mnId);
+    Serializer::Write(f,mnFirstKFid);
+    Serializer::Write(f,mnFirstFrame);
+
+    {
+        unique_lock<mutex> lock(mMutexPos);
+        Serializer::WriteMat(f,mWorldPos);
+        Serializer::WriteMat(f,mNormalVector);
+    }
+
+    unique_lock<mutex> lock(mMutexFeatures);
+    Serializer::WriteMat(f,mDescriptor);
+    Serializer::Write(f,mnVisible);
+    Serializer::Write(f,mnFound);
+    Serializer::Write(f,mfMinDistance);
+    Serializer::Write(f,mfMaxDistance);
+
+    // 参考关键帧是坏的时候(还没来得及替换),用一个好的观测关键帧代替,保证读取后参考关键帧一定存在
+    KeyFrame* pRefKF = mpRefKF;
+    if(!pRefKF || pRefKF->isBad())
+    {
+        pRefKF = static_cast<KeyFrame*>(NULL);
+        for(ObservationMap::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+        {
+            if(!mit->first->isBad())
+            {
+                pRefKF = mit->first;
+                break;
+            }
+        }
+    }
+    const long int nRefKFid = pRefKF ? (long int)pRefKF->mnId : -1;
+    Serializer::Write(f,nRefKFid);
+}
+
+// 读取地图点
+MapPoint* MapPoint::Load(std::istream &f, Map* pMap, const std::map<long unsigned int, KeyFrame*> &mKFs)
+{
+    long unsigned int nId;
+    long int nFirstKFid, nFirstFrame;
+    Serializer::Read(f,nId);
+    Serializer::Read(f,nFirstKFid);
+    Serializer::Read(f,nFirstFrame);
+    if(!f.good())
+        return static_cast<MapPoint*>(NULL);
+
+    MapPoint* pMP = new MapPoint(nFirstKFid,nFirstFrame,pMap);
+    pMP->mnId = nId;
+
+    Serializer::ReadMat(f,pMP->mWorldPos);
+    Serializer::ReadMat(f,pMP->mNormalVector);
+    Serializer::ReadMat(f,pMP->mDescriptor);
+    Serializer::Read(f,pMP->mnVisible);
+    Serializer::Read(f,pMP->mnFound);
+    Serializer::Read(f,pMP->mfMinDistance);
+    Serializer::Read(f,pMP->mfMaxDistance);
+
+    long int nRefKFid;
+    Serializer::Read(f,nRefKFid);
+    map<long unsigned int, KeyFrame*>::const_iterator mit = mKFs.find(nRefKFid);
+
+    if(!f.good() || pMP->mWorldPos.rows!=3 || pMP->mNormalVector.rows!=3 || mit==mKFs.end())
+    {
+        delete pMP;
+        return static_cast<MapPoint*>(NULL);
+    }
+    pMP->mpRefKF = mit->second;
+    pMP->mWorldPosEig = Converter::toVector3f(pMP->mWorldPos);
+    pMP->mNormalVectorEig = Converter::toVector3f(pMP->mNormalVector);
+
+    return pMP;
+}
 
 
 } //namespace ORB_SLAM
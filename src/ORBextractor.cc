@@ -64,6 +64,12 @@
 #include "ORBextractor.h"
 #include <iostream>
 
+// x86-64 上 SSE2 是基本指令集,特征点方向和描述子计算使用向量化实现;其他平台使用原始的标量实现
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ORBEXTRACTOR_USE_SSE2
+#endif
+
 using namespace cv;
 using namespace std;
 
@@ -82,6 +88,68 @@ const int EDGE_THRESHOLD = 19;		///<算法生成的图像边
 //生成这个边的目的是进行图像金子塔的生成时，需要对图像进行高斯滤波处理，为了考虑到使滤波后的图像边界处的像素也能够携带有正确的图像信息，
 //这里作者就将原图像扩大了一个边。
 
+#ifdef ORBEXTRACTOR_USE_SSE2
+/**
+ * @brief 灰度质心法中图像矩的SSE2实现,和下面IC_Angle中的标量实现结果完全一致(都是整数运算)
+ * @details 图像块每一行最多31个像素,用4个8通道的16位向量表示 u = -15..16,超出圆形区域 |u|<=u_max[v] 的通道权重置0。
+ * 两行像素之和/差再用 madd 指令与权重 u 或 v 相乘并累加到32位
+ * @param[in] center    特征点中心像素的指针
+ * @param[in] step      图像每行的字节数
+ * @param[in] u_max     图像块的每一行的坐标边界
+ * @param[out] m_01     按y坐标加权的矩
+ * @param[out] m_10     按x坐标加权的矩
+ */
+static void IC_MomentsSSE2(const uchar* center, int step, const vector<int> & u_max, int &m_01, int &m_10)
+{
+    const __m128i zero = _mm_setzero_si128();
+    // 每个通道对应的u坐标
+    const __m128i u[4] = {_mm_setr_epi16(-15,-14,-13,-12,-11,-10, -9, -8),
+                          _mm_setr_epi16( -7, -6, -5, -4, -3, -2, -1,  0),
+                          _mm_setr_epi16(  1,  2,  3,  4,  5,  6,  7,  8),
+                          _mm_setr_epi16(  9, 10, 11, 12, 13, 14, 15, 16)};
+
+    __m128i acc10 = _mm_setzero_si128();
+    __m128i acc01 = _mm_setzero_si128();
+
+    for (int v = 0; v <= HALF_PATCH_SIZE; ++v)
+    {
+        const int d = u_max[v];
+        // 圆形区域内 -d<=u<=d 的通道为全1
+        const __m128i lo = _mm_set1_epi16((short)(-d-1));
+        const __m128i hi = _mm_set1_epi16((short)(d+1));
+        const __m128i wv = _mm_set1_epi16((short)v);
+
+        // 中心线下方(val_plus)和上方(val_minus)的两行,v=0时两者是同一行,只计算一次
+        const uchar* pPlus = center + v*step - HALF_PATCH_SIZE;
+        const uchar* pMinus = center - v*step - HALF_PATCH_SIZE;
+        const __m128i plus8[2] = {_mm_loadu_si128((const __m128i*)pPlus), _mm_loadu_si128((const __m128i*)(pPlus+16))};
+        const __m128i minus8[2] = {_mm_loadu_si128((const __m128i*)pMinus), _mm_loadu_si128((const __m128i*)(pMinus+16))};
+
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128i mask = _mm_and_si128(_mm_cmpgt_epi16(u[k], lo), _mm_cmplt_epi16(u[k], hi));
+            const __m128i plus = (k&1) ? _mm_unpackhi_epi8(plus8[k>>1], zero) : _mm_unpacklo_epi8(plus8[k>>1], zero);
+            if (v == 0)
+            {
+                acc10 = _mm_add_epi32(acc10, _mm_madd_epi16(plus, _mm_and_si128(u[k], mask)));
+                continue;
+            }
+            const __m128i minus = (k&1) ? _mm_unpackhi_epi8(minus8[k>>1], zero) : _mm_unpacklo_epi8(minus8[k>>1], zero);
+            // m_10 += u*(val_plus + val_minus), m_01 += v*(val_plus - val_minus)
+            acc10 = _mm_add_epi32(acc10, _mm_madd_epi16(_mm_add_epi16(plus, minus), _mm_and_si128(u[k], mask)));
+            acc01 = _mm_add_epi32(acc01, _mm_madd_epi16(_mm_sub_epi16(plus, minus), _mm_and_si128(wv, mask)));
+        }
+    }
+
+    // 水平求和
+    int buf10[4], buf01[4];
+    _mm_storeu_si128((__m128i*)buf10, acc10);
+    _mm_storeu_si128((__m128i*)buf01, acc01);
+    m_10 = buf10[0] + buf10[1] + buf10[2] + buf10[3];
+    m_01 = buf01[0] + buf01[1] + buf01[2] + buf01[3];
+}
+#endif
+
 /**
  * @brief 这个函数用于计算特征点的方向，这里是返回角度作为方向。
  * 计算特征点方向是为了使得提取的特征点具有旋转不变性。
@@ -99,6 +167,10 @@ static float IC_Angle(const Mat& image, Point2f pt,  const vector<int> & u_max)
 	//获得这个特征点所在的图像块的中心点坐标灰度值的指针center
     const uchar* center = &image.at<uchar> (cvRound(pt.y), cvRound(pt.x));
 
+#ifdef ORBEXTRACTOR_USE_SSE2
+    // 特征点都在有效图像边界以内,而金字塔图像四周扩充了EDGE_THRESHOLD的边,所以每行多读的1个像素不会越界
+    IC_MomentsSSE2(center, (int)image.step1(), u_max, m_01, m_10);
+#else
     // Treat the center line differently, v=0
 	//这条v=0中心线的计算需要特殊对待
     //后面是以中心行为对称轴，成对遍历行数，所以PATCH_SIZE必须是奇数
@@ -135,6 +207,7 @@ static float IC_Angle(const Mat& image, Point2f pt,  const vector<int> & u_max)
         //将这一行上的和按照y坐标加权
         m_01 += v * v_sum;
     }
+#endif
 
     //为了加快速度还使用了fastAtan2()函数，输出为[0,360)角度，精度为0.3°
     return fastAtan2((float)m_01, (float)m_10);
@@ -143,6 +216,7 @@ static float IC_Angle(const Mat& image, Point2f pt,  const vector<int> & u_max)
 ///乘数因子，一度对应着多少弧度
 const float factorPI = (float)(CV_PI/180.f);
 
+#ifndef ORBEXTRACTOR_USE_SSE2
 /**
  * @brief 计算ORB特征点的描述子。注意这个是全局的静态函数，只能是在本文件内被调用
  * @param[in] kpt       特征点对象
@@ -203,6 +277,51 @@ static void computeOrbDescriptor(const KeyPoint& kpt, const Mat& img, const Poin
     //为了避免和程序中的其他部分冲突在，在使用完成之后就取消这个宏定义
     #undef GET_VALUE
 }
+#else
+/**
+ * @brief computeOrbDescriptor 的SSE2实现
+ * @details 标量实现中每个采样点都要单独做一次旋转和cvRound,这里先用SSE2一次旋转4个采样点并取整,
+ * 得到512个采样点相对中心像素的偏移量,然后再统一取像素比较。_mm_cvtps_epi32 和 cvRound 一样都是四舍六入五成双
+ * @param[in] kpt       特征点对象
+ * @param[in] img       提取特征点的图像
+ * @param[in] px        采样模板的x坐标(SoA存储,512个)
+ * @param[in] py        采样模板的y坐标(SoA存储,512个)
+ * @param[out] desc     保存计算好的描述子
+ */
+static void computeOrbDescriptorSSE2(const KeyPoint& kpt, const Mat& img, const float* px, const float* py, uchar* desc)
+{
+    const float angle = (float)kpt.angle*factorPI;
+    const float a = (float)cos(angle), b = (float)sin(angle);
+
+    const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+    const int step = (int)img.step;
+
+    // 旋转后的坐标 x'= xcos(θ) - ysin(θ),  y'= xsin(θ) + ycos(θ)
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+    int CV_DECL_ALIGNED(16) offsetX[512];
+    int CV_DECL_ALIGNED(16) offsetY[512];
+    for (int i = 0; i < 512; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i);
+        _mm_store_si128((__m128i*)(offsetY + i), _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, vb), _mm_mul_ps(y, va))));
+        _mm_store_si128((__m128i*)(offsetX + i), _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, va), _mm_mul_ps(y, vb))));
+    }
+
+    int offset[512];
+    for (int i = 0; i < 512; ++i)
+        offset[i] = offsetY[i]*step + offsetX[i];
+
+    // 每个字节由8对采样点比较得到
+    const int* pOffset = offset;
+    for (int i = 0; i < 32; ++i, pOffset += 16)
+    {
+        int val = 0;
+        for (int j = 0; j < 8; ++j)
+            val |= (center[pOffset[2*j]] < center[pOffset[2*j+1]]) << j;
+        desc[i] = (uchar)val;
+    }
+}
+#endif
 
 //下面就是预先定义好的随机点集，256是指可以提取出256bit的描述子信息，每个bit由一对点比较得来；4=2*2，前面的2是需要两个点（一对点）进行比较，后面的2是一个点有两个坐标
 static int bit_pattern_31_[256*4] =
@@ -471,10 +590,18 @@ ORBextractor::ORBextractor(int _nfeatures,		//指定要提取的特征点数目
 						   float _scaleFactor,	//指定图像金字塔的缩放系数
 						   int _nlevels,		//指定图像金字塔的层数
 						   int _iniThFAST,		//指定初始的FAST特征点提取参数，可以提取出最明显的角点
-						   int _minThFAST):		//如果初始阈值没有检测到角点，降低到这个阈值提取出弱一点的角点
+						   int _minThFAST,		//如果初始阈值没有检测到角点，降低到这个阈值提取出弱一点的角点
+						   int _nThreads):		//并行处理金字塔各层的线程数
     nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-    iniThFAST(_iniThFAST), minThFAST(_minThFAST)//设置这些参数
+    iniThFAST(_iniThFAST), minThFAST(_minThFAST), mpThreadPool(NULL), mbOwnThreadPool(false)//设置这些参数
 {
+    // 调用线程自己也会参与计算，所以线程池中只需要 nThreads-1 个工作线程
+    if(_nThreads>1)
+    {
+        mpThreadPool = new ThreadPool(_nThreads-1);
+        mbOwnThreadPool = true;
+    }
+
 	//存储每层图像缩放系数的vector调整为符合图层数目的大小
     mvScaleFactor.resize(nlevels);  
 	//存储这个sigma^2，其实就是每层图像相对初始图像缩放因子的平方
@@ -573,6 +700,22 @@ ORBextractor::ORBextractor(int _nfeatures,		//指定要提取的特征点数目
 }
 
 
+// 析构函数，释放线程池
+ORBextractor::~ORBextractor()
+{
+    if(mbOwnThreadPool)
+        delete mpThreadPool;
+}
+
+// 改用外部共享的线程池
+void ORBextractor::SetThreadPool(ThreadPool* pThreadPool)
+{
+    if(mbOwnThreadPool)
+        delete mpThreadPool;
+    mpThreadPool = pThreadPool;
+    mbOwnThreadPool = false;
+}
+
 /**
  * @brief 计算特征点的方向
  * @param[in] image                 特征点所在当前金字塔的图像
@@ -1062,148 +1205,171 @@ void ORBextractor::ComputeKeyPointsOctTree(
 	//重新调整图像层数
     allKeypoints.resize(nlevels);
 
+    // 对每一层图像做处理
+    // 各层之间互不依赖，并且每层的结果存放在各自的容器中，所以有线程池时各层并行处理，结果和串行时完全一样
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nlevels, [&](int level){ ComputeKeyPointsLevel(level, allKeypoints[level]); });
+    else
+        for (int level = 0; level < nlevels; ++level)
+            ComputeKeyPointsLevel(level, allKeypoints[level]);
+}
+
+/**
+ * @brief 提取某一层金字塔图像上的FAST角点，用八叉树均匀化，并计算方向
+ * 
+ * @param[in] level         金字塔层
+ * @param[out] keypoints    这一层提取并保留下来的特征点
+ */
+void ORBextractor::ComputeKeyPointsLevel(const int level, vector<KeyPoint>& keypoints)
+{
 	//图像cell的尺寸，是个正方形，可以理解为边长in像素坐标
     const float W = 30;
 
-    // 对每一层图像做处理
-	//遍历所有图像
-    for (int level = 0; level < nlevels; ++level)
+	//计算这层图像的坐标边界， NOTICE 注意这里是坐标边界，EDGE_THRESHOLD指的应该是可以提取特征点的有效图像边界，后面会一直使用“有效图像边界“这个自创名词
+    const int minBorderX = EDGE_THRESHOLD-3;			//这里的3是因为在计算FAST特征点的时候，需要建立一个半径为3的圆
+    const int minBorderY = minBorderX;					//minY的计算就可以直接拷贝上面的计算结果了
+    const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+    const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+
+	//存储需要进行平均分配的特征点
+    vector<cv::KeyPoint> vToDistributeKeys;
+	//一般地都是过量采集，所以这里预分配的空间大小是nfeatures*10
+    vToDistributeKeys.reserve(nfeatures*10);  // 保留多大的空间
+
+	//计算进行特征点提取的图像区域尺寸
+    const float width = (maxBorderX-minBorderX);  // float形式的长和宽
+    const float height = (maxBorderY-minBorderY);
+
+	//计算网格在当前层的图像有的行数和列数，也就是分成多少个网格
+    const int nCols = width/W;  // 比如是152/30 = 5
+    const int nRows = height/W;
+	//计算每个图像网格所占的像素行数和列数。这样做应该是为了充分利用图像的像素，比如按照30分可能导致图像边缘有很大的空余
+    // 然后根据30分得到的网格数再去调整网格的数目，这样每个网格都变大一点，最后哪个网格小一点
+    const int wCell = ceil(width/nCols);   // ceil向上取整, 比如152/5 = 30.4，向上取整就是31
+    const int hCell = ceil(height/nRows);
+
+    // 每一行网格中提取到的特征点先分别保存，最后再按行的顺序合并，这样即使各行并行提取，结果的顺序也和串行时完全一样
+    vector<vector<cv::KeyPoint> > vRowKeys(nRows);
+
+	//遍历图像网格，以行为单位
+    auto detectRow = [&](int i)
     {
-		//计算这层图像的坐标边界， NOTICE 注意这里是坐标边界，EDGE_THRESHOLD指的应该是可以提取特征点的有效图像边界，后面会一直使用“有效图像边界“这个自创名词
-        const int minBorderX = EDGE_THRESHOLD-3;			//这里的3是因为在计算FAST特征点的时候，需要建立一个半径为3的圆
-        const int minBorderY = minBorderX;					//minY的计算就可以直接拷贝上面的计算结果了
-        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
-        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
-
-		//存储需要进行平均分配的特征点
-        vector<cv::KeyPoint> vToDistributeKeys;
-		//一般地都是过量采集，所以这里预分配的空间大小是nfeatures*10
-        vToDistributeKeys.reserve(nfeatures*10);  // 保留多大的空间
-
-		//计算进行特征点提取的图像区域尺寸
-        const float width = (maxBorderX-minBorderX);  // float形式的长和宽
-        const float height = (maxBorderY-minBorderY);
-
-		//计算网格在当前层的图像有的行数和列数，也就是分成多少个网格
-        const int nCols = width/W;  // 比如是152/30 = 5
-        const int nRows = height/W;
-		//计算每个图像网格所占的像素行数和列数。这样做应该是为了充分利用图像的像素，比如按照30分可能导致图像边缘有很大的空余
-        // 然后根据30分得到的网格数再去调整网格的数目，这样每个网格都变大一点，最后哪个网格小一点
-        const int wCell = ceil(width/nCols);   // ceil向上取整, 比如152/5 = 30.4，向上取整就是31
-        const int hCell = ceil(height/nRows);
-
-		//开始遍历图像网格，还是以行开始遍历的
-        for(int i=0; i<nRows; i++)
+		//计算当前网格初始行坐标
+        const float iniY =minBorderY+i*hCell;
+		//计算当前网格最大的行坐标，这里的+6=+3+3，即考虑到了多出来3是为了cell边界像素进行FAST特征点提取用
+		//前面的EDGE_THRESHOLD指的应该是提取后的特征点所在的边界，所以minBorderY是考虑了计算半径时候的图像边界
+		//目测一个图像网格的大小是25*25啊
+        float maxY = iniY+hCell+6;
+
+		//如果初始的行坐标就已经超过了有效的图像边界了，这里的“有效图像”是指原始的、可以提取FAST特征点的图像区域
+        if(iniY>=maxBorderY-3)
+			//那么就跳过这一行
+            return;
+		//如果图像的大小导致不能够正好划分出来整齐的图像网格，那么就要委屈最后一行了
+        if(maxY>maxBorderY)
+            maxY = maxBorderY;
+
+		//开始列的遍历
+        for(int j=0; j<nCols; j++)
         {
-			//计算当前网格初始行坐标
-            const float iniY =minBorderY+i*hCell;
-			//计算当前网格最大的行坐标，这里的+6=+3+3，即考虑到了多出来3是为了cell边界像素进行FAST特征点提取用
-			//前面的EDGE_THRESHOLD指的应该是提取后的特征点所在的边界，所以minBorderY是考虑了计算半径时候的图像边界
-			//目测一个图像网格的大小是25*25啊
-            float maxY = iniY+hCell+6;
-
-			//如果初始的行坐标就已经超过了有效的图像边界了，这里的“有效图像”是指原始的、可以提取FAST特征点的图像区域
-            if(iniY>=maxBorderY-3)
-				//那么就跳过这一行
+			//计算初始的列坐标
+            const float iniX =minBorderX+j*wCell;
+			//计算这列网格的最大列坐标，+6的含义和前面相同
+            float maxX = iniX+wCell+6;
+			//判断坐标是否在图像中
+			// 如果初始的列坐标就已经超过了有效的图像边界了，这里的“有效图像”是指原始的、可以提取FAST
+            //  特征点的图像区域。并且应该同前面行坐标的边界对应，都为-3
+			//!BUG  正确应该是maxBorderX-3  但是不影响运行
+            if(iniX>=maxBorderX-6)
                 continue;
-			//如果图像的大小导致不能够正好划分出来整齐的图像网格，那么就要委屈最后一行了
-            if(maxY>maxBorderY)
-                maxY = maxBorderY;
-
-			//开始列的遍历
-            for(int j=0; j<nCols; j++)
+			//如果最大坐标越界那么委屈一下
+            if(maxX>maxBorderX)
+                maxX = maxBorderX;
+
+            // FAST提取兴趣点, 自适应阈值
+			//这个向量存储这个cell中的特征点
+            vector<cv::KeyPoint> vKeysCell;
+			//调用opencv的库函数来检测FAST角点
+            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),	//待检测的图像，这里就是当前遍历到的图像块
+                 vKeysCell,			//存储角点位置的容器
+				 iniThFAST,			//检测阈值
+				 true);				//使能非极大值抑制
+
+			//如果这个图像块中使用默认的FAST检测阈值没有能够检测到角点
+            if(vKeysCell.empty())
             {
-				//计算初始的列坐标
-                const float iniX =minBorderX+j*wCell;
-				//计算这列网格的最大列坐标，+6的含义和前面相同
-                float maxX = iniX+wCell+6;
-				//判断坐标是否在图像中
-				// 如果初始的列坐标就已经超过了有效的图像边界了，这里的“有效图像”是指原始的、可以提取FAST
-                //  特征点的图像区域。并且应该同前面行坐标的边界对应，都为-3
-				//!BUG  正确应该是maxBorderX-3  但是不影响运行
-                if(iniX>=maxBorderX-6)
-                    continue;
-				//如果最大坐标越界那么委屈一下
-                if(maxX>maxBorderX)
-                    maxX = maxBorderX;
-
-                // FAST提取兴趣点, 自适应阈值
-				//这个向量存储这个cell中的特征点
-                vector<cv::KeyPoint> vKeysCell;
-				//调用opencv的库函数来检测FAST角点
-                FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),	//待检测的图像，这里就是当前遍历到的图像块
-                     vKeysCell,			//存储角点位置的容器
-					 iniThFAST,			//检测阈值
-					 true);				//使能非极大值抑制
-
-				//如果这个图像块中使用默认的FAST检测阈值没有能够检测到角点
-                if(vKeysCell.empty())
-                {
-					//那么就使用更低的阈值来进行重新检测
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),	//待检测的图像
-                         vKeysCell,		//存储角点位置的容器
-						 minThFAST,		//更低的检测阈值
-						 true);			//使能非极大值抑制
-                }
+				//那么就使用更低的阈值来进行重新检测
+                FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),	//待检测的图像
+                     vKeysCell,		//存储角点位置的容器
+					 minThFAST,		//更低的检测阈值
+					 true);			//使能非极大值抑制
+            }
 
-                //当图像cell中检测到FAST角点的时候执行下面的语句
-                if(!vKeysCell.empty())
+            //当图像cell中检测到FAST角点的时候执行下面的语句
+            if(!vKeysCell.empty())
+            {
+				//遍历其中的所有FAST角点
+                for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
                 {
-					//遍历其中的所有FAST角点
-                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                    {
-						//NOTICE 到目前为止，这些角点的坐标都是基于图像cell的，现在我们要先将其恢复到当前的【坐标边界】下的坐标
-						//这样做是因为在下面使用八叉树法整理特征点的时候将会使用得到这个坐标
-						//在后面将会被继续转换成为在当前图层的扩充图像坐标系下的坐标
-                        (*vit).pt.x += j*wCell;  // j是列
-                        (*vit).pt.y += i*hCell;  // i是行
-						//然后将其加入到”等待被分配“的特征点容器中
-                        vToDistributeKeys.push_back(*vit);
-                    }//遍历图像cell中的所有的提取出来的FAST角点，并且恢复其在整个金字塔当前层图像下的坐标
-                }//当图像cell中检测到FAST角点的时候执行下面的语句
-            }//开始遍历图像cell的列
-        }//开始遍历图像cell的行
-
-        //声明一个对当前图层的特征点的容器的引用
-        vector<KeyPoint> & keypoints = allKeypoints[level];
-		//并且调整其大小为欲提取出来的特征点个数（当然这里也是扩大了的，因为不可能所有的特征点都是在这一个图层中提取出来的）
-        keypoints.reserve(nfeatures);  // 保留多大的空间，不是调整大小
-
-        // 根据mnFeatuvector<KeyPoint> & keypoints = allKeypoints[level];resPerLevel,即该层的兴趣点数,对特征点进行剔除
-		//返回值是一个保存有特征点的vector容器，含有剔除后的保留下来的特征点
-        //得到的特征点的坐标，依旧是在当前图层下来讲的
-        keypoints = DistributeOctTree(vToDistributeKeys, 			//当前图层提取出来的特征点，也即是等待剔除的特征点
-																	//NOTICE 注意此时特征点所使用的坐标都是在“半径扩充图像”下的
-									  minBorderX, maxBorderX,		//当前图层图像的边界，而这里的坐标却都是在“边缘扩充图像”下的
-                                      minBorderY, maxBorderY,
-									  mnFeaturesPerLevel[level], 	//希望保留下来的当前层图像的特征点个数
-									  level);						//当前层图像所在的图层
-
-		//PATCH_SIZE是对于底层的初始图像来说的，现在要根据当前图层的尺度缩放倍数进行缩放得到缩放后的PATCH大小 和特征点的方向计算有关
-        const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
-
-        // Add border to coordinates and scale information
-		//获取剔除过程后保留下来的特征点数目
-        const int nkps = keypoints.size();
-		//然后开始遍历这些特征点，恢复其在当前图层图像坐标系下的坐标
-        for(int i=0; i<nkps ; i++)
-        {
-			//对每一个保留下来的特征点，恢复到相对于当前图层“边缘扩充图像下”的坐标系的坐标
-            keypoints[i].pt.x+=minBorderX;
-            keypoints[i].pt.y+=minBorderY;
-			//记录特征点来源的图像金字塔图层
-            keypoints[i].octave=level;    // octave：从哪一层金字塔得到此关键点
-			//记录计算方向的patch，缩放后对应的大小， 又被称作为特征点半径
-            keypoints[i].size = scaledPatchSize;  // size：该关键点邻域直径大小
-        }
+					//NOTICE 到目前为止，这些角点的坐标都是基于图像cell的，现在我们要先将其恢复到当前的【坐标边界】下的坐标
+					//这样做是因为在下面使用八叉树法整理特征点的时候将会使用得到这个坐标
+					//在后面将会被继续转换成为在当前图层的扩充图像坐标系下的坐标
+                    (*vit).pt.x += j*wCell;  // j是列
+                    (*vit).pt.y += i*hCell;  // i是行
+					//然后将其加入到”等待被分配“的特征点容器中
+                    vRowKeys[i].push_back(*vit);
+                }//遍历图像cell中的所有的提取出来的FAST角点，并且恢复其在整个金字塔当前层图像下的坐标
+            }//当图像cell中检测到FAST角点的时候执行下面的语句
+        }//开始遍历图像cell的列
+    };//遍历图像cell的行
+
+    // 第0层图像最大，提取耗时最多，所以再按网格行并行。其他层已经在层之间并行了
+    if(level==0 && mpThreadPool)
+        mpThreadPool->ParallelFor(nRows, detectRow);
+    else
+        for(int i=0; i<nRows; i++)
+            detectRow(i);
+
+    //按行的顺序合并所有网格中的特征点
+    for(int i=0; i<nRows; i++)
+        vToDistributeKeys.insert(vToDistributeKeys.end(), vRowKeys[i].begin(), vRowKeys[i].end());
+
+	//并且调整其大小为欲提取出来的特征点个数（当然这里也是扩大了的，因为不可能所有的特征点都是在这一个图层中提取出来的）
+    keypoints.reserve(nfeatures);  // 保留多大的空间，不是调整大小
+
+    // 根据mnFeatuvector<KeyPoint> & keypoints = allKeypoints[level];resPerLevel,即该层的兴趣点数,对特征点进行剔除
+	//返回值是一个保存有特征点的vector容器，含有剔除后的保留下来的特征点
+    //得到的特征点的坐标，依旧是在当前图层下来讲的
+    keypoints = DistributeOctTree(vToDistributeKeys, 			//当前图层提取出来的特征点，也即是等待剔除的特征点
+																//NOTICE 注意此时特征点所使用的坐标都是在“半径扩充图像”下的
+								  minBorderX, maxBorderX,		//当前图层图像的边界，而这里的坐标却都是在“边缘扩充图像”下的
+                                  minBorderY, maxBorderY,
+								  mnFeaturesPerLevel[level], 	//希望保留下来的当前层图像的特征点个数
+								  level);						//当前层图像所在的图层
+
+	//PATCH_SIZE是对于底层的初始图像来说的，现在要根据当前图层的尺度缩放倍数进行缩放得到缩放后的PATCH大小 和特征点的方向计算有关
+    const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
+
+    // Add border to coordinates and scale information
+	//获取剔除过程后保留下来的特征点数目
+    const int nkps = keypoints.size();
+	//然后开始遍历这些特征点，恢复其在当前图层图像坐标系下的坐标
+    for(int i=0; i<nkps ; i++)
+    {
+		//对每一个保留下来的特征点，恢复到相对于当前图层“边缘扩充图像下”的坐标系的坐标
+        keypoints[i].pt.x+=minBorderX;
+        keypoints[i].pt.y+=minBorderY;
+		//记录特征点来源的图像金字塔图层
+        keypoints[i].octave=level;    // octave：从哪一层金字塔得到此关键点
+		//记录计算方向的patch，缩放后对应的大小， 又被称作为特征点半径
+        keypoints[i].size = scaledPatchSize;  // size：该关键点邻域直径大小
     }
 
     // compute orientations
-    //然后计算这些特征点的方向信息，注意这里还是分层计算的
-    for (int level = 0; level < nlevels; ++level)
-        computeOrientation(mvImagePyramid[level],	//对应的图层的图像
-						   allKeypoints[level], 	//这个图层中提取并保留下来的特征点容器
-						   umax);					//以及PATCH的横坐标边界
+    //然后计算这些特征点的方向信息
+    computeOrientation(mvImagePyramid[level],	//对应的图层的图像
+					   keypoints, 				//这个图层中提取并保留下来的特征点容器
+					   umax);					//以及PATCH的横坐标边界
 }
 
 
@@ -1536,6 +1702,19 @@ static void computeDescriptors(const Mat& image, vector<KeyPoint>& keypoints, Ma
 	//清空保存描述子信息的容器
     descriptors = Mat::zeros((int)keypoints.size(), 32, CV_8UC1); //keypoints行，32列，每一行表示一个特征点的描述子
 
+#ifdef ORBEXTRACTOR_USE_SSE2
+    // 把采样模板转成SoA存储的浮点数,本层所有特征点共用
+    float CV_DECL_ALIGNED(16) px[512];
+    float CV_DECL_ALIGNED(16) py[512];
+    for (size_t i = 0; i < 512; i++)
+    {
+        px[i] = (float)pattern[i].x;
+        py[i] = (float)pattern[i].y;
+    }
+
+    for (size_t i = 0; i < keypoints.size(); i++)
+        computeOrbDescriptorSSE2(keypoints[i], image, px, py, descriptors.ptr((int)i));
+#else
 	//开始遍历特征点
     for (size_t i = 0; i < keypoints.size(); i++)
 		//计算这个特征点的描述子
@@ -1543,6 +1722,7 @@ static void computeDescriptors(const Mat& image, vector<KeyPoint>& keypoints, Ma
 							 image, 					//以及其图像
 							 &pattern[0], 				//随机点集的首地址
 							 descriptors.ptr((int)i));	//提取出来的描述子的保存位置，存在第i行
+#endif
 }
 
 /**
@@ -1610,19 +1790,22 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
     _keypoints.reserve(nkeypoints);
 
 	//因为遍历是一层一层进行的，但是描述子那个矩阵是存储整个图像金字塔中特征点的描述子，所以在这里设置了Offset变量来保存“寻址”时的偏移量，
-	//辅助进行在总描述子mat中的定位
-    int offset = 0;
-	//开始遍历每一层图像
-    for (int level = 0; level < nlevels; ++level)
+	//辅助进行在总描述子mat中的定位。这里先把每层的偏移量算出来，这样各层就可以独立地（并行地）计算描述子
+    vector<int> vLevelOffsets(nlevels,0);
+    for (int level = 1; level < nlevels; ++level)
+        vLevelOffsets[level] = vLevelOffsets[level-1] + (int)allKeypoints[level-1].size();
+
+    // 对某一层图像进行高斯模糊、计算描述子、并把特征点坐标恢复到第0层图像的坐标系下
+    auto describeLevel = [&](int level)
     {
 		//获取在allKeypoints中当前层特征点容器的句柄
         vector<KeyPoint>& keypoints = allKeypoints[level];
 		//本层的特征点数
         int nkeypointsLevel = (int)keypoints.size();
 
-		//如果特征点数目为0，跳出本次循环，继续下一层金字塔
+		//如果特征点数目为0，继续下一层金字塔
         if(nkeypointsLevel==0)
-            continue;
+            return;
 
         // preprocess the resized image 
         //  Step 5 对图像进行高斯模糊
@@ -1639,6 +1822,7 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
 
         // Compute the descriptors 计算描述子
 		// desc存储当前图层的描述子
+        const int offset = vLevelOffsets[level];
         Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);  // 这样结果也是引用，指向同一块内存
 		// Step 6 计算高斯模糊后图像的描述子
         computeDescriptors(workingMat, 	//高斯模糊之后的图层图像
@@ -1646,9 +1830,6 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
 						   desc, 		//存储计算之后的描述子
 						   pattern);	//随机采样模板
 
-		// 更新偏移量的值 
-        offset += nkeypointsLevel;
-
         // Scale keypoint coordinates
 		// Step 6 对非第0层图像中的特征点的坐标恢复到第0层图像（原图像）的坐标系下
         // ? 得到所有层特征点在第0层里的坐标放到_keypoints里面
@@ -1663,14 +1844,21 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
 				// 特征点本身直接乘缩放倍数就可以了
                 keypoint->pt *= scale;
         }
-        
-        // And add the keypoints to the output
-        // 将keypoints中内容插入到_keypoints 的末尾
-        // keypoint其实是对allkeypoints中每层图像中特征点的引用，这样allkeypoints中的所有特征点在这里被转存到输出的_keypoints
-        _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
-        // 注意这里必须使用insert，因为为了程序加速前面使用reserve为vector保留了内存空间，如果
-        // 这里使用push_back的话，那么会在前面保留的空间末尾继续插入，这样就失去目的了。
-    }
+    };
+
+    // 各层写入的是描述子矩阵中互不重叠的行，可以并行
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nlevels, describeLevel);
+    else
+        for (int level = 0; level < nlevels; ++level)
+            describeLevel(level);
+
+    // And add the keypoints to the output
+    // 按层的顺序将keypoints中内容插入到_keypoints 的末尾，和描述子矩阵中的顺序一一对应
+    // 注意这里必须使用insert，因为为了程序加速前面使用reserve为vector保留了内存空间，如果
+    // 这里使用push_back的话，那么会在前面保留的空间末尾继续插入，这样就失去目的了。
+    for (int level = 0; level < nlevels; ++level)
+        _keypoints.insert(_keypoints.end(), allKeypoints[level].begin(), allKeypoints[level].end());
 }
 
 /**
@@ -39,6 +39,11 @@
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
 #include<stdint.h>
+#include<string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include<immintrin.h>
+#endif
 
 using namespace std;
 
@@ -77,6 +82,9 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
     // 如果 th！=1 (RGBD 相机或者刚刚进行过重定位), 需要扩大范围搜索
     const bool bFactor = th!=1.0;
 
+    // 候选点的描述子距离,在循环外定义以复用内存
+    vector<int> vDist;
+
     // Step 1 遍历有效的局部地图点
     for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
     {
@@ -114,6 +122,9 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
 
         const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
+        // 一次性批量计算地图点描述子与所有候选特征点描述子的距离
+        DescriptorDistances(MPdescriptor, F.mDescriptors, vIndices, vDist);
+
         // 最优的次优的描述子距离和index
         int bestDist=256;
         int bestLevel= -1;
@@ -123,9 +134,9 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
 
         // Get best and second matches with near keypoints
         // Step 4 寻找候选匹配点中的最佳和次佳匹配点
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
 
             // 如果Frame中的该兴趣点已经有对应的MapPoint了,则退出该次循环
             if(F.mvpMapPoints[idx])
@@ -146,10 +157,8 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
                     continue;
             }
 
-            const cv::Mat &d = F.mDescriptors.row(idx);
-
-            // 计算地图点和候选投影点的描述子距离
-            const int dist = DescriptorDistance(MPdescriptor,d);
+            // 地图点和候选投影点的描述子距离
+            const int dist = vDist[k];
             
             // 寻找描述子距离最小和次小的特征点和索引
             if(dist<bestDist)
@@ -252,11 +261,14 @@ bool ORBmatcher::CheckDistEpipolarLine(const cv::KeyPoint &kp1,const cv::KeyPoin
  * @param  pKF               关键帧
  * @param  F                 当前普通帧
  * @param  vpMapPointMatches F中地图点对应的匹配，NULL表示未匹配
+ * @param  pvMatchDistances  不为NULL时输出每个匹配的描述子距离,下标和vpMapPointMatches一致,没有匹配的为256
  * @return                   成功匹配的数量
  */
 //Done
-int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPointMatches)
+int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPointMatches, vector<int> *pvMatchDistances)
 {
+    pKF->LoadFeatures();
+
     // 获取该关键帧的地图点
     const vector<MapPoint*> vpMapPointsKF = pKF->GetMapPointMatches();
 
@@ -264,6 +276,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
     //; 这种写法是什么意思，重新设置了大小吗？
     //; CC: 这就是赋初值的意思，就相当于同时定义了这个vector的长度和默认的元素值，和数组一样。但是注意vector的长度是可以变的，这里的长度相当于预留了一个长度
     vpMapPointMatches = vector<MapPoint*>(F.N, static_cast<MapPoint*>(NULL));  
+    if(pvMatchDistances)
+        pvMatchDistances->assign(F.N, 256);
 
     // 取出关键帧的词袋特征向量
     //; FeatureVector是一个map，键是这帧图像的特征点归类的word在哪个node下，值是这个node下还有哪些特征点
@@ -379,6 +393,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
                         // pMP是关键帧中的当前特征点对应的地图点
                         // bestIdxF是当前帧中和关键帧中的当期特征点最匹配的那个特征点，把这个特征点对应的地图点设置成关键帧中的当前特征点对应的地图点
                         vpMapPointMatches[bestIdxF]=pMP;  
+                        if(pvMatchDistances)
+                            (*pvMatchDistances)[bestIdxF]=bestDist1;
 
                         // 这里的realIdxKF是当前遍历到的关键帧的特征点id
                         const cv::KeyPoint &kp = pKF->mvKeysUn[realIdxKF];
@@ -461,6 +477,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
  */
 int ORBmatcher::SearchByProjection(KeyFrame* pKF, cv::Mat Scw, const vector<MapPoint*> &vpPoints, vector<MapPoint*> &vpMatched, int th)
 {
+    pKF->LoadFeatures();
+
     // Get Calibration Parameters for later projection
     const float &fx = pKF->fx;
     const float &fy = pKF->fy;
@@ -806,6 +824,9 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
 //Done
 int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches12)
 {
+    pKF1->LoadFeatures();
+    pKF2->LoadFeatures();
+
     // Step 1 分别取出两个关键帧的特征点、BoW 向量、地图点、描述子
     const vector<cv::KeyPoint> &vKeysUn1 = pKF1->mvKeysUn;
     const DBoW2::FeatureVector &vFeatVec1 = pKF1->mFeatVec;
@@ -962,6 +983,9 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
 int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F12,
                                        vector<pair<size_t, size_t> > &vMatchedPairs, const bool bOnlyStereo)
 {
+    pKF1->LoadFeatures();
+    pKF2->LoadFeatures();
+
     const DBoW2::FeatureVector &vFeatVec1 = pKF1->mFeatVec;
     const DBoW2::FeatureVector &vFeatVec2 = pKF2->mFeatVec;
 
@@ -1188,9 +1212,27 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
  */
 int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th)
 {
+    vector<int> vnMatchedIdx;
+    SearchForFuse(pKF,vpMapPoints,vnMatchedIdx,th);
+    return FuseMatches(pKF,vpMapPoints,vnMatchedIdx);
+}
+
+/**
+ * @brief Fuse 的匹配部分,将地图点投影到关键帧中寻找最佳匹配的特征点
+ * @details 只读取关键帧和地图点,不做修改,所以对不同的关键帧可以并行调用
+ * @param[in] pKF            关键帧
+ * @param[in] vpMapPoints    待投影的地图点
+ * @param[out] vnMatchedIdx  每个地图点匹配到的特征点索引,没有匹配为-1
+ * @param[in] th             搜索窗口的阈值
+ * @return int               匹配到的地图点数目
+ */
+int ORBmatcher::SearchForFuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, vector<int> &vnMatchedIdx, const float th)
+{
+    pKF->LoadFeatures();
+
     // 取出当前帧位姿、内参、光心在世界坐标系下坐标
-    cv::Mat Rcw = pKF->GetRotation();
-    cv::Mat tcw = pKF->GetTranslation();
+    const Eigen::Matrix3f Rcw = pKF->GetRotationEigen();
+    const Eigen::Vector3f tcw = pKF->GetTranslationEigen();
 
     const float &fx = pKF->fx;
     const float &fy = pKF->fy;
@@ -1198,11 +1240,15 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
     const float &cy = pKF->cy;
     const float &bf = pKF->mbf;
 
-    cv::Mat Ow = pKF->GetCameraCenter();
+    const Eigen::Vector3f Ow = pKF->GetCameraCenterEigen();
 
-    int nFused=0;
+    int nmatches=0;
 
     const int nMPs = vpMapPoints.size();
+    vnMatchedIdx.assign(nMPs,-1);
+
+    // 候选点的描述子距离,在循环外定义以复用内存
+    vector<int> vDist;
 
     // 遍历所有的待投影地图点
     for(int i=0; i<nMPs; i++)
@@ -1217,18 +1263,18 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
             continue;
 
         // 将地图点变换到关键帧的相机坐标系下
-        cv::Mat p3Dw = pMP->GetWorldPos();
-        cv::Mat p3Dc = Rcw*p3Dw + tcw;
+        const Eigen::Vector3f p3Dw = pMP->GetWorldPosEigen();
+        const Eigen::Vector3f p3Dc = Rcw*p3Dw + tcw;
 
         // Depth must be positive
         // 深度值为负，跳过
-        if(p3Dc.at<float>(2)<0.0f)
+        if(p3Dc(2)<0.0f)
             continue;
 
         // Step 2 得到地图点投影到关键帧的图像坐标
-        const float invz = 1/p3Dc.at<float>(2);
-        const float x = p3Dc.at<float>(0)*invz;
-        const float y = p3Dc.at<float>(1)*invz;
+        const float invz = 1/p3Dc(2);
+        const float x = p3Dc(0)*invz;
+        const float y = p3Dc(1)*invz;
 
         const float u = fx*x+cx;
         const float v = fy*y+cy;
@@ -1242,8 +1288,8 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
 
         const float maxDistance = pMP->GetMaxDistanceInvariance();
         const float minDistance = pMP->GetMinDistanceInvariance();
-        cv::Mat PO = p3Dw-Ow;
-        const float dist3D = cv::norm(PO);
+        const Eigen::Vector3f PO = p3Dw-Ow;
+        const float dist3D = PO.norm();
 
         // Depth must be inside the scale pyramid of the image
         // Step 3 地图点到关键帧相机光心距离需满足在有效范围内
@@ -1252,7 +1298,7 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
 
         // Viewing angle must be less than 60 deg
         // Step 4 地图点到光心的连线与该地图点的平均观测向量之间夹角要小于60°
-        cv::Mat Pn = pMP->GetNormal();
+        const Eigen::Vector3f Pn = pMP->GetNormalEigen();
         if(PO.dot(Pn)<0.5*dist3D)
             continue;
         // 根据地图点到相机光心距离预测匹配点所在的金字塔尺度
@@ -1271,11 +1317,13 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
          // Step 6 遍历寻找最佳匹配点
         const cv::Mat dMP = pMP->GetDescriptor();
 
+        DescriptorDistances(dMP, pKF->mDescriptors, vIndices, vDist);
+
         int bestDist = 256;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)// 步骤3：遍历搜索范围内的features
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)// 步骤3：遍历搜索范围内的features
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
 
             const cv::KeyPoint &kp = pKF->mvKeysUn[idx];
 
@@ -1317,9 +1365,7 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
                     continue;
             }
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-            const int dist = DescriptorDistance(dMP,dKF);
+            const int dist = vDist[k];
             // 和投影点的描述子距离最小
             if(dist<bestDist)
             {
@@ -1328,31 +1374,60 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
             }
         }
 
+        // 最佳匹配距离要小于阈值,融合留给 FuseMatches 去做
+        if(bestDist<=TH_LOW)
+        {
+            vnMatchedIdx[i] = bestIdx;
+            nmatches++;
+        }
+    }
+
+    return nmatches;
+}
+
+/**
+ * @brief Fuse 的融合部分,按地图点的顺序把 SearchForFuse 的匹配结果融合到关键帧中
+ * @details 匹配之后地图点可能已经在其他关键帧的融合中被替换,或者已经加入了这个关键帧,所以要重新检查
+ * @param[in] pKF           关键帧
+ * @param[in] vpMapPoints   待投影的地图点
+ * @param[in] vnMatchedIdx  SearchForFuse 得到的每个地图点匹配的特征点索引
+ * @return int              更新地图点的数量
+ */
+int ORBmatcher::FuseMatches(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const vector<int> &vnMatchedIdx)
+{
+    int nFused=0;
+
+    for(size_t i=0, iend=vpMapPoints.size(); i<iend; i++)
+    {
+        const int bestIdx = vnMatchedIdx[i];
+        if(bestIdx<0)
+            continue;
+
+        MapPoint* pMP = vpMapPoints[i];
+        if(pMP->isBad() || pMP->IsInKeyFrame(pKF))
+            continue;
+
         // If there is already a MapPoint replace otherwise add new measurement
         // Step 7 找到投影点对应的最佳匹配特征点，根据是否存在地图点来融合或新增
-        // 最佳匹配距离要小于阈值
-        if(bestDist<=TH_LOW)
+        MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+        if(pMPinKF)
         {
-            MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-            if(pMPinKF)
+            // 如果最佳匹配点有对应有效地图点，选择被观测次数最多的那个替换
+            if(!pMPinKF->isBad())
             {
-                // 如果最佳匹配点有对应有效地图点，选择被观测次数最多的那个替换
-                if(!pMPinKF->isBad())
-                {
-                    if(pMPinKF->Observations()>pMP->Observations())
-                        pMP->Replace(pMPinKF);
-                    else
-                        pMPinKF->Replace(pMP);
-                }
+                if(pMPinKF->Observations()>pMP->Observations())
+                    pMP->Replace(pMPinKF);
+                else
+                    pMPinKF->Replace(pMP);
             }
-            else
-            {
-                // 如果最佳匹配点没有对应地图点，添加观测信息
-                pMP->AddObservation(pKF,bestIdx);
-                pKF->AddMapPoint(pMP,bestIdx);
-            }
-            nFused++;
         }
+        else
+        {
+            // 如果最佳匹配点没有对应地图点，添加观测信息
+            pMP->AddObservation(pKF,bestIdx);
+            pKF->AddMapPoint(pMP,bestIdx);
+        }
+        nFused++;
     }
 
     return nFused;
@@ -1371,6 +1446,8 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
  */
 int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint)
 {
+    pKF->LoadFeatures();
+
     // Get Calibration Parameters for later projection
     const float &fx = pKF->fx;
     const float &fy = pKF->fy;
@@ -1394,6 +1471,9 @@ int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoi
     // 与当前帧闭环匹配上的关键帧及其共视关键帧组成的地图点
     const int nPoints = vpPoints.size();
 
+    // 候选点的描述子距离,在循环外定义以复用内存
+    vector<int> vDist;
+
     // For each candidate MapPoint project and match
     // 遍历所有的地图点
     for(int iMP=0; iMP<nPoints; iMP++)
@@ -1465,19 +1545,19 @@ int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoi
         // Step 6 寻找最佳匹配点（没有用到次佳匹配的比例）
         const cv::Mat dMP = pMP->GetDescriptor();
 
+        DescriptorDistances(dMP, pKF->mDescriptors, vIndices, vDist);
+
         int bestDist = INT_MAX;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
             const int &kpLevel = pKF->mvKeysUn[idx].octave;
 
             if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                 continue;
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-            int dist = DescriptorDistance(dMP,dKF);
+            int dist = vDist[k];
 
             if(dist<bestDist)
             {
@@ -1526,6 +1606,9 @@ int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoi
 int ORBmatcher::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint*> &vpMatches12,
                              const float &s12, const cv::Mat &R12, const cv::Mat &t12, const float th)
 {
+    pKF1->LoadFeatures();
+    pKF2->LoadFeatures();
+
     // Step 1： 准备工作：内参，计算Sim3的逆
     const float &fx = pKF1->fx;
     const float &fy = pKF1->fy;
@@ -1827,6 +1910,13 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
     const bool bForward = tlc.at<float>(2) > CurrentFrame.mb && !bMono;     // 非单目情况，如果Z大于基线，则表示相机明显前进
     const bool bBackward = -tlc.at<float>(2) > CurrentFrame.mb && !bMono;   // 非单目情况，如果-Z小于基线，则表示相机明显后退
 
+    // 逐点投影时用Eigen形式的位姿,避免每个点都在堆上分配cv::Mat
+    const Eigen::Matrix3f &RcwEig = CurrentFrame.GetRotationEigen();
+    const Eigen::Vector3f &tcwEig = CurrentFrame.GetTranslationEigen();
+
+    // 候选点的描述子距离,在循环外定义以复用内存
+    vector<int> vDist;
+
     //  Step 3 对于前一帧的每一个地图点，通过相机投影模型，得到投影到当前帧的像素坐标
     for(int i=0; i<LastFrame.N; i++)
     {
@@ -1837,12 +1927,12 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
             if(!LastFrame.mvbOutlier[i]) // 并且这个地图点不是外点
             {
                 // 对上一帧有效的MapPoints投影到当前帧坐标系
-                cv::Mat x3Dw = pMP->GetWorldPos();  // 地图点的世界坐标
-                cv::Mat x3Dc = Rcw*x3Dw+tcw;  // 把地图点转换到当前帧的坐标系下
+                const Eigen::Vector3f x3Dw = pMP->GetWorldPosEigen();  // 地图点的世界坐标
+                const Eigen::Vector3f x3Dc = RcwEig*x3Dw+tcwEig;  // 把地图点转换到当前帧的坐标系下
 
-                const float xc = x3Dc.at<float>(0);
-                const float yc = x3Dc.at<float>(1);
-                const float invzc = 1.0/x3Dc.at<float>(2);
+                const float xc = x3Dc(0);
+                const float yc = x3Dc(1);
+                const float invzc = 1.0/x3Dc(2);
 
                 if(invzc<0)   // 转换之后深度<0，说明这个地图点在当前帧坐标系下的相机成像平面后边，不合法
                     continue;
@@ -1885,13 +1975,16 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
 
                 const cv::Mat dMP = pMP->GetDescriptor();   // 得到这个地图点对应的描述子
 
+                // 批量计算这个地图点的描述子和所有候选特征点描述子之间的距离
+                DescriptorDistances(dMP, CurrentFrame.mDescriptors, vIndices2, vDist);
+
                 int bestDist = 256;
                 int bestIdx2 = -1;
 
                 // Step 5 遍历候选匹配点，寻找距离最小的最佳匹配点 
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
                 {
-                    const size_t i2 = *vit;
+                    const size_t i2 = vIndices2[k];
 
                     // 如果该特征点已经有对应的MapPoint了,则退出该次循环
                     if(CurrentFrame.mvpMapPoints[i2])  // 这个特征点有地图点了
@@ -1907,9 +2000,7 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
                             continue;
                     }
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);  // 得到这个特征点的索引
-
-                    const int dist = DescriptorDistance(dMP,d);  // 计算这个特征点的描述子和地图点的描述子之间的距离
+                    const int dist = vDist[k];  // 这个特征点的描述子和地图点的描述子之间的距离
 
                     if(dist<bestDist)
                     {
@@ -1981,11 +2072,13 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
 //Done
 int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set<MapPoint*> &sAlreadyFound, const float th , const int ORBdist)
 {
+    pKF->LoadFeatures();
+
     int nmatches = 0;
 
-    const cv::Mat Rcw = CurrentFrame.mTcw.rowRange(0,3).colRange(0,3);
-    const cv::Mat tcw = CurrentFrame.mTcw.rowRange(0,3).col(3);
-    const cv::Mat Ow = -Rcw.t()*tcw;
+    const Eigen::Matrix3f &Rcw = CurrentFrame.GetRotationEigen();
+    const Eigen::Vector3f &tcw = CurrentFrame.GetTranslationEigen();
+    const Eigen::Vector3f &Ow = CurrentFrame.GetCameraCenterEigen();
 
     // Rotation Histogram (to check rotation consistency)
     // Step 1 建立旋转直方图，用于检测旋转一致性
@@ -1996,6 +2089,9 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
     const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
 
+    // 候选点的描述子距离,在循环外定义以复用内存
+    vector<int> vDist;
+
     // Step 2 遍历关键帧中的每个地图点，通过相机投影模型，得到投影到当前帧的像素坐标
     for(size_t i=0, iend=vpMPs.size(); i<iend; i++)
     {
@@ -2007,12 +2103,12 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
             if(!pMP->isBad() && !sAlreadyFound.count(pMP))
             {
                 //Project
-                cv::Mat x3Dw = pMP->GetWorldPos();
-                cv::Mat x3Dc = Rcw*x3Dw+tcw;
+                const Eigen::Vector3f x3Dw = pMP->GetWorldPosEigen();
+                const Eigen::Vector3f x3Dc = Rcw*x3Dw+tcw;
 
-                const float xc = x3Dc.at<float>(0);
-                const float yc = x3Dc.at<float>(1);
-                const float invzc = 1.0/x3Dc.at<float>(2);
+                const float xc = x3Dc(0);
+                const float yc = x3Dc(1);
+                const float invzc = 1.0/x3Dc(2);
 
                 const float u = CurrentFrame.fx*xc*invzc+CurrentFrame.cx;
                 const float v = CurrentFrame.fy*yc*invzc+CurrentFrame.cy;
@@ -2023,8 +2119,8 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
                     continue;
 
                 // Compute predicted scale level
-                cv::Mat PO = x3Dw-Ow;
-                float dist3D = cv::norm(PO);
+                const Eigen::Vector3f PO = x3Dw-Ow;
+                float dist3D = PO.norm();
 
                 const float maxDistance = pMP->GetMaxDistanceInvariance();
                 const float minDistance = pMP->GetMinDistanceInvariance();
@@ -2047,18 +2143,18 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
+                DescriptorDistances(dMP, CurrentFrame.mDescriptors, vIndices2, vDist);
+
                 int bestDist = 256;
                 int bestIdx2 = -1;
                 // Step 4 遍历候选匹配点，寻找距离最小的最佳匹配点 
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+                for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
                 {
-                    const size_t i2 = *vit;
+                    const size_t i2 = vIndices2[k];
                     if(CurrentFrame.mvpMapPoints[i2])
                         continue;
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                    const int dist = DescriptorDistance(dMP,d);
+                    const int dist = vDist[k];
 
                     if(dist<bestDist)
                     {
@@ -2169,23 +2265,29 @@ void ORBmatcher::ComputeThreeMaxima(vector<int>* histo, const int L, int &ind1,
 }
 
 
+namespace
+{
+
+// 一个ORB描述子是256bit,即32字节
+const size_t kDescriptorBytes = 32;
+
 // Bit set count operation from
 // Hamming distance：两个二进制串之间的汉明距离，指的是其不同位数的个数
 // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+// 标量版本,在不支持 POPCNT/AVX2 的平台上使用
+int HammingScalar(const uint8_t *pa8, const uint8_t *pb8)
 {
-    const int *pa = a.ptr<int32_t>();
-    const int *pb = b.ptr<int32_t>();
+    uint32_t pa[8], pb[8];
+    memcpy(pa, pa8, kDescriptorBytes);
+    memcpy(pb, pb8, kDescriptorBytes);
 
     int dist=0;
 
     // 8*32=256bit
-
-    for(int i=0; i<8; i++, pa++, pb++)
+    for(int i=0; i<8; i++)
     {
-        unsigned  int v = *pa ^ *pb;        // 相等为0,不等为1
+        uint32_t v = pa[i] ^ pb[i];        // 相等为0,不等为1
         // 下面的操作就是计算其中bit为1的个数了,这个操作看上面的链接就好
-        // 其实我觉得也还阔以直接使用8bit的查找表,然后做32次寻址操作就完成了;不过缺点是没有利用好CPU的字长
         v = v - ((v >> 1) & 0x55555555);
         v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
         dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
@@ -2194,4 +2296,135 @@ int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
     return dist;
 }
 
+void HammingBatchScalar(const uint8_t *pa, const uint8_t *pB, size_t step,
+                        const size_t *pIdx, size_t n, int *pDist)
+{
+    for(size_t k=0; k<n; k++)
+        pDist[k] = HammingScalar(pa, pB + (pIdx ? pIdx[k] : k)*step);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ORB_SLAM2_HAMMING_X86
+
+// SSE4.2 的 POPCNT 指令: 按64位分4段计数
+__attribute__((target("popcnt")))
+int HammingPopcnt(const uint8_t *pa8, const uint8_t *pb8)
+{
+    uint64_t pa[4], pb[4];
+    memcpy(pa, pa8, kDescriptorBytes);
+    memcpy(pb, pb8, kDescriptorBytes);
+    return __builtin_popcountll(pa[0]^pb[0]) + __builtin_popcountll(pa[1]^pb[1]) +
+           __builtin_popcountll(pa[2]^pb[2]) + __builtin_popcountll(pa[3]^pb[3]);
+}
+
+__attribute__((target("popcnt")))
+void HammingBatchPopcnt(const uint8_t *pa, const uint8_t *pB, size_t step,
+                        const size_t *pIdx, size_t n, int *pDist)
+{
+    for(size_t k=0; k<n; k++)
+        pDist[k] = HammingPopcnt(pa, pB + (pIdx ? pIdx[k] : k)*step);
+}
+
+// AVX2 版本: 一个描述子正好是一个256bit寄存器,异或后用4bit查找表(pshufb)统计每个字节的1的个数,
+// 再用 sad 指令横向累加. 查询描述子只加载一次,对N个候选复用
+__attribute__((target("avx2")))
+void HammingBatchAVX2(const uint8_t *pa, const uint8_t *pB, size_t step,
+                      const size_t *pIdx, size_t n, int *pDist)
+{
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa));
+
+    for(size_t k=0; k<n; k++)
+    {
+        const uint8_t *pb = pB + (pIdx ? pIdx[k] : k)*step;
+        const __m256i v = _mm256_xor_si256(va, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pb)));
+        const __m256i lo = _mm256_and_si256(v, lowMask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+        const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+        // 4个64位的部分和
+        const __m256i sad = _mm256_sad_epu8(cnt, zero);
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+        s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+        pDist[k] = _mm_cvtsi128_si32(s);
+    }
+}
+
+#endif
+
+typedef int (*HammingFunc)(const uint8_t*, const uint8_t*);
+typedef void (*HammingBatchFunc)(const uint8_t*, const uint8_t*, size_t, const size_t*, size_t, int*);
+
+struct HammingKernels
+{
+    HammingFunc pair;
+    HammingBatchFunc batch;
+};
+
+// 运行时检测CPU特性,选择最快的实现. 只在库加载时执行一次
+HammingKernels SelectHammingKernels()
+{
+    HammingKernels kernels = {HammingScalar, HammingBatchScalar};
+#ifdef ORB_SLAM2_HAMMING_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("popcnt"))
+    {
+        kernels.pair = HammingPopcnt;
+        kernels.batch = HammingBatchPopcnt;
+    }
+    if(__builtin_cpu_supports("avx2"))
+        kernels.batch = HammingBatchAVX2;
+#endif
+    return kernels;
+}
+
+const HammingKernels gHamming = SelectHammingKernels();
+
+} // anonymous namespace
+
+/**
+ * @brief 计算两个ORB描述子之间的汉明距离
+ * 
+ * @param[in] a     一个描述子
+ * @param[in] b     另外一个描述子
+ * @return int      描述子的汉明距离
+ */
+int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+{
+    return gHamming.pair(a.ptr<uint8_t>(), b.ptr<uint8_t>());
+}
+
+/**
+ * @brief 计算一个描述子与矩阵B中所有描述子(连续存储)的汉明距离
+ * 
+ * @param[in] a         查询描述子
+ * @param[in] B         候选描述子矩阵
+ * @param[out] pDist    输出距离
+ */
+void ORBmatcher::DescriptorDistances(const cv::Mat &a, const cv::Mat &B, int *pDist)
+{
+    if(B.empty())
+        return;
+    gHamming.batch(a.ptr<uint8_t>(), B.ptr<uint8_t>(), B.step[0], NULL, B.rows, pDist);
+}
+
+/**
+ * @brief 计算一个描述子与矩阵B中指定行的描述子的汉明距离,先收集网格中的候选点再统一计算
+ * 
+ * @param[in] a         查询描述子
+ * @param[in] B         描述子矩阵
+ * @param[in] vIndices  候选行号
+ * @param[out] vDist    输出距离,会被resize成vIndices.size()
+ */
+void ORBmatcher::DescriptorDistances(const cv::Mat &a, const cv::Mat &B,
+                                     const vector<size_t> &vIndices, vector<int> &vDist)
+{
+    vDist.resize(vIndices.size());
+    if(vIndices.empty())
+        return;
+    gHamming.batch(a.ptr<uint8_t>(), B.ptr<uint8_t>(), B.step[0], &vIndices[0], vIndices.size(), &vDist[0]);
+}
+
 } //namespace ORB_SLAM
@@ -42,6 +42,9 @@
 #include<Eigen/StdVector>
 
 #include "Converter.h"
+#include "PoseSolver.h"
+#include "ThreadPoolExecutor.h"
+#include "LocalBAWorkspace.h"
 
 #include<mutex>
 
@@ -58,15 +61,16 @@ namespace ORB_SLAM2
  * @param[in] pbStopFlag            外部控制BA结束标志
  * @param[in] nLoopKF               形成了闭环的当前关键帧的id
  * @param[in] bRobust               是否使用鲁棒核函数
+ * @param[in] pThreadPool           线程池，不为NULL时在线程池上并行线性化和计算Schur补
  */
-void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust, ThreadPool* pThreadPool)
 {
     // 获取地图中的所有关键帧
     vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
     // 获取地图中的所有地图点
     vector<MapPoint*> vpMP = pMap->GetAllMapPoints();
     // 调用GBA
-    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
+    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust, pThreadPool);
 }
 
 /**
@@ -86,19 +90,25 @@ void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopF
  * @param[in] pbStopFlag            外部控制BA结束标志
  * @param[in] nLoopKF               形成了闭环的当前关键帧的id
  * @param[in] bRobust               是否使用核函数
+ * @param[in] pThreadPool           线程池，不为NULL时在线程池上并行线性化和计算Schur补
  */
 void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
-                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust,
+                                 ThreadPool* pThreadPool)
 {
     // 不参与优化的地图点
     vector<bool> vbNotIncludedMP;
     vbNotIncludedMP.resize(vpMP.size());
 
     // Step 1 初始化g2o优化器
+    ThreadPoolExecutor executor(pThreadPool);
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
     linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
     g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+    // 有线程池时按地图点划分各条边,并行地线性化和计算Schur补
+    if(pThreadPool)
+        solver_ptr->setParallelExecutor(&executor);
     // 使用LM算法优化
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
     optimizer.setAlgorithm(solver);
@@ -143,6 +153,8 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
 
     // Set MapPoint vertices
     // Step 2.2：向优化器添加地图点作为顶点
+    // 地图点和关键帧之间观测的关系,在循环外定义以复用内存
+    ObservationMap observations;
     // 遍历地图中的所有地图点
     for(size_t i=0; i<vpMP.size(); i++)
     {
@@ -166,14 +178,14 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
         optimizer.addVertex(vPoint);
 
         // 取出地图点和关键帧之间观测的关系
-        const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        pMP->GetObservations(observations);
 
         // 边计数
         int nEdges = 0;
         //SET EDGES
         // Step 3：向优化器添加投影边（是在遍历地图点、添加地图点的顶点的时候顺便添加的）
         // 遍历观察到当前地图点的所有关键帧
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        for(ObservationMap::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
         {
 
             KeyFrame* pKF = mit->first;
@@ -183,6 +195,7 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
 
             nEdges++;
             // 取出该地图点对应该关键帧的2D特征点
+            pKF->LoadFeatures();
             const cv::KeyPoint &kpUn = pKF->mvKeysUn[mit->second];
 
             if(pKF->mvuRight[mit->second]<0)   // 右图对应的特征点值为-1，说明是单目
@@ -355,254 +368,62 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
  *         + measurement：MapPoint在当前帧中的二维位置(ul,v,ur)
  *         + InfoMatrix: invSigma2(与特征点所在的尺度有关)
  *
+ * 图中只有一个位姿顶点,所以不再用g2o搭建图,而是由PoseSolver直接求解6x6的正规方程,结果和g2o相同
+ *
  * @param   pFrame Frame
  * @return  inliers数量
  */
 int Optimizer::PoseOptimization(Frame *pFrame)
 {
-    // 该优化函数主要用于Tracking线程中：运动跟踪、参考帧跟踪、地图跟踪、重定位
-
-    // Step 1：构造g2o优化器, BlockSolver_6_3表示：位姿 _PoseDim 为6维，路标点 _LandmarkDim 是3维
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
-
-    // 输入的帧中,有效的,参与优化过程的2D-3D点对
-    int nInitialCorrespondences=0;
-
-    // Set Frame vertex
-    // Step 2：添加顶点：待优化当前帧的Tcw
-    g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
-    vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-     // 设置id
-    vSE3->setId(0);    
-    // 要优化的变量，所以不能固定
-    vSE3->setFixed(false);
-    optimizer.addVertex(vSE3);
+    // 每个线程一个求解器,观测的内存在多次调用之间重复使用
+    static thread_local PoseSolver solver;
+    solver.Reset(pFrame->fx,pFrame->fy,pFrame->cx,pFrame->cy,pFrame->mbf);
 
-    // Set MapPoint vertices
     const int N = pFrame->N;   //; N 是2D特征点个数，但是特征点不一定有对应的地图点
 
-    // for Monocular
-    vector<g2o::EdgeSE3ProjectXYZOnlyPose*> vpEdgesMono;
-    vector<size_t> vnIndexEdgeMono;
-    vpEdgesMono.reserve(N);
-    vnIndexEdgeMono.reserve(N);
-
-    // for Stereo
-    vector<g2o::EdgeStereoSE3ProjectXYZOnlyPose*> vpEdgesStereo;
-    vector<size_t> vnIndexEdgeStereo;
-    vpEdgesStereo.reserve(N);
-    vnIndexEdgeStereo.reserve(N);
-
-    // 自由度为2的卡方分布，显著性水平为0.05，对应的临界阈值5.991
-    const float deltaMono = sqrt(5.991);  
-    // 自由度为3的卡方分布，显著性水平为0.05，对应的临界阈值7.815   
-    const float deltaStereo = sqrt(7.815);     
+    // 第i个观测对应的特征点索引
+    static thread_local vector<size_t> vnIndexObservation;
+    vnIndexObservation.clear();
+    vnIndexObservation.reserve(N);
 
-    // Step 3：添加一元边
     {
-    // 锁定地图点。由于需要使用地图点来构造顶点和边,因此不希望在构造的过程中部分地图点被改写造成不一致甚至是段错误
     unique_lock<mutex> lock(MapPoint::mGlobalMutex);
 
-    // 遍历当前地图中的所有地图点
     for(int i=0; i<N; i++)
     {
         MapPoint* pMP = pFrame->mvpMapPoints[i];
-        // 如果这个地图点还存在没有被剔除掉
-        if(pMP)   //; 这个2D特征点对应有匹配的3D地图点
-        {
-            // Monocular observation
-            // 单目情况
-            if(pFrame->mvuRight[i]<0)
-            {
-                nInitialCorrespondences++;
-                pFrame->mvbOutlier[i] = false;
-
-                // 对这个地图点的观测
-                Eigen::Matrix<double,2,1> obs;
-                const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                obs << kpUn.pt.x, kpUn.pt.y;
-                // 新建单目的边，一元边，误差为观测特征点坐标减去投影点的坐标
-                g2o::EdgeSE3ProjectXYZOnlyPose* e = new g2o::EdgeSE3ProjectXYZOnlyPose();
-                // 设置边的顶点
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                e->setMeasurement(obs);
-                // 这个点的可信程度和特征点所在的图层有关
-                const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
-                // 在这里使用了鲁棒核函数
-                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                e->setRobustKernel(rk);
-                rk->setDelta(deltaMono);    // 前面提到过的卡方阈值
-
-                // 设置相机内参
-                e->fx = pFrame->fx;
-                e->fy = pFrame->fy;
-                e->cx = pFrame->cx;
-                e->cy = pFrame->cy;
-                // 地图点的空间位置,作为迭代的初始值
-                cv::Mat Xw = pMP->GetWorldPos();
-                e->Xw[0] = Xw.at<float>(0);
-                e->Xw[1] = Xw.at<float>(1);
-                e->Xw[2] = Xw.at<float>(2);
-
-                optimizer.addEdge(e);
-
-                vpEdgesMono.push_back(e);
-                vnIndexEdgeMono.push_back(i);
-            }
-            else  // Stereo observation 双目
-            {
-                nInitialCorrespondences++;
-                pFrame->mvbOutlier[i] = false;
-
-                //SET EDGE
-                // 观测多了一项右目的坐标
-                Eigen::Matrix<double,3,1> obs;// 这里和单目不同
-                const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                const float &kp_ur = pFrame->mvuRight[i];
-                obs << kpUn.pt.x, kpUn.pt.y, kp_ur;// 这里和单目不同
-                // 新建边，一元边，误差为观测特征点坐标减去投影点的坐标
-                g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();// 这里和单目不同
-
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                e->setMeasurement(obs);
-                // 置信程度主要是看左目特征点所在的图层
-                const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
-                e->setInformation(Info);
+        if(!pMP)   //; 这个2D特征点没有匹配的3D地图点
+            continue;
 
-                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                e->setRobustKernel(rk);
-                rk->setDelta(deltaStereo);
+        pFrame->mvbOutlier[i] = false;
 
-                e->fx = pFrame->fx;
-                e->fy = pFrame->fy;
-                e->cx = pFrame->cx;
-                e->cy = pFrame->cy;
-                e->bf = pFrame->mbf;
-                cv::Mat Xw = pMP->GetWorldPos();
-                e->Xw[0] = Xw.at<float>(0);
-                e->Xw[1] = Xw.at<float>(1);
-                e->Xw[2] = Xw.at<float>(2);
+        const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+        const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+        cv::Mat Xw = pMP->GetWorldPos();
+        const double X[3] = {Xw.at<float>(0), Xw.at<float>(1), Xw.at<float>(2)};
 
-                optimizer.addEdge(e);
-
-                vpEdgesStereo.push_back(e);
-                vnIndexEdgeStereo.push_back(i);
-            } // 根据单目和双目不同的相机输入执行不同的操作过程
-        }
+        if(pFrame->mvuRight[i]<0)
+            solver.AddMonoObservation(X,kpUn.pt.x,kpUn.pt.y,invSigma2);
+        else  // Stereo observation 双目
+            solver.AddStereoObservation(X,kpUn.pt.x,kpUn.pt.y,pFrame->mvuRight[i],invSigma2);
 
+        vnIndexObservation.push_back(i);
     }
     } // 离开临界区
 
-    // 如果没有足够的匹配点,那么就只好放弃了
+    const int nInitialCorrespondences = solver.NumObservations();
     if(nInitialCorrespondences<3)
         return 0;
 
-    // We perform 4 optimizations, after each optimization we classify observation as inlier/outlier
-    // At the next optimization, outliers are not included, but at the end they can be classified as inliers again.
-    // Step 4：开始优化，总共优化四次，每次优化迭代10次,每次优化后，将观测分为outlier和inlier，outlier不参与下次优化
-    // 由于每次优化后是对所有的观测进行outlier和inlier判别，因此之前被判别为outlier有可能变成inlier，反之亦然
-    // 基于卡方检验计算出的阈值（假设测量有一个像素的偏差）
-    const float chi2Mono[4]={5.991,5.991,5.991,5.991};          // 单目
-    const float chi2Stereo[4]={7.815,7.815,7.815, 7.815};       // 双目
-    const int its[4]={10,10,10,10};// 四次迭代，每次迭代的次数
-
-    // bad 的地图点个数
-    int nBad=0;
-    // 一共进行四次优化
-    for(size_t it=0; it<4; it++)
-    {
-
-        vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-        // 其实就是初始化优化器,这里的参数0就算是不填写,默认也是0,也就是只对level为0的边进行优化
-        optimizer.initializeOptimization(0);
-        // 开始优化，优化10次
-        optimizer.optimize(its[it]);
+    g2o::SE3Quat Tcw = Converter::toSE3Quat(pFrame->mTcw);
+    const int nBad = solver.Optimize(Tcw);
 
-        nBad=0;
-        // 优化结束,开始遍历参与优化的每一条误差边(单目)
-        for(size_t i=0, iend=vpEdgesMono.size(); i<iend; i++)
-        {
-            g2o::EdgeSE3ProjectXYZOnlyPose* e = vpEdgesMono[i];
-
-            const size_t idx = vnIndexEdgeMono[i];
-
-            // 如果这条误差边是来自于outlier
-            if(pFrame->mvbOutlier[idx])
-            {
-                e->computeError();    //; 为什么要手动调用一下计算误差？
-            }
+    for(size_t i=0, iend=vnIndexObservation.size(); i<iend; i++)
+        pFrame->mvbOutlier[vnIndexObservation[i]] = solver.IsOutlier(i);
 
-            // 就是error*\Omega*error,表征了这个点的误差大小(考虑置信度以后)
-            const float chi2 = e->chi2();
-
-            if(chi2>chi2Mono[it])
-            {                
-                pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);                 // 设置为outlier , level 1 对应为外点,上面的过程中我们设置其为不优化
-                nBad++;
-            }
-            else
-            {
-                pFrame->mvbOutlier[idx]=false;
-                e->setLevel(0);                 // 设置为inlier, level 0 对应为内点,上面的过程中我们就是要优化这些关系
-            }
-
-            if(it==2)
-                e->setRobustKernel(0); // 除了前两次优化需要RobustKernel以外, 其余的优化都不需要 -- 因为重投影的误差已经有明显的下降了
-        } // 对单目误差边的处理
-        // 同样的原理遍历双目的误差边
-        //; 其实对于单目来说，vpEdgesStereo就是一个空向量，所以下面的循环不会执行
-        for(size_t i=0, iend=vpEdgesStereo.size(); i<iend; i++)
-        {
-            g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = vpEdgesStereo[i];
-
-            const size_t idx = vnIndexEdgeStereo[i];
-
-            if(pFrame->mvbOutlier[idx])
-            {
-                e->computeError();
-            }
-
-            const float chi2 = e->chi2();
-
-            if(chi2>chi2Stereo[it])
-            {
-                pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
-                nBad++;
-            }
-            else
-            {                
-                e->setLevel(0);
-                pFrame->mvbOutlier[idx]=false;
-            }
-
-            if(it==2)
-                e->setRobustKernel(0);
-        } // 对双目误差边的处理
-
-        if(optimizer.edges().size()<10)
-            break;
-    } // 一共要进行四次优化
-
-    // Recover optimized pose and return number of inliers
-    // Step 5 得到优化后的当前帧的位姿
-    g2o::VertexSE3Expmap* vSE3_recov = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(0));
-    g2o::SE3Quat SE3quat_recov = vSE3_recov->estimate();
-    cv::Mat pose = Converter::toCvMat(SE3quat_recov);
+    cv::Mat pose = Converter::toCvMat(Tcw);
     pFrame->SetPose(pose);
 
-    // 并且返回内点数目
     return nInitialCorrespondences-nBad;
 }
 
@@ -626,12 +447,22 @@ int Optimizer::PoseOptimization(Frame *pFrame)
  * @param pKF        KeyFrame
  * @param pbStopFlag 是否停止优化的标志
  * @param pMap       在优化后，更新状态时需要用到Map的互斥量mMutexMapUpdate
+ * @param pThreadPool 线程池，不为NULL时在线程池上并行线性化和计算Schur补
+ * @param pWorkspace 持久化的工作空间，复用其中的优化器、顶点和边；为NULL时使用本次调用的临时工作空间
  * @note 由局部建图线程调用,对局部地图进行优化的函数
  */
-void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap)
+void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, ThreadPool* pThreadPool, LocalBAWorkspace* pWorkspace)
 {
     // 该优化函数用于LocalMapping线程的局部BA优化
 
+    // 局部建图线程传入自己持有的工作空间,在多次局部BA之间复用;没有传入时用一个临时的工作空间
+    if(!pWorkspace)
+    {
+        LocalBAWorkspace workspace;
+        LocalBundleAdjustment(pKF, pbStopFlag, pMap, pThreadPool, &workspace);
+        return;
+    }
+
     // Local KeyFrames: First Breadth Search from Current Keyframe
     // 局部关键帧
     list<KeyFrame*> lLocalKeyFrames;
@@ -683,13 +514,15 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     // Fixed Keyframes. Keyframes that see Local MapPoints but that are not Local Keyframes
     // Step 3 得到能被局部地图点观测到，但不属于局部关键帧的关键帧(二级相连)，这些二级相连关键帧在局部BA优化时不优化
     list<KeyFrame*> lFixedCameras;
+    // 观测到地图点的KF和该地图点在KF中的索引,在循环外定义以复用内存
+    ObservationMap observations;
     // 遍历局部地图中的每个地图点
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         // 观测到该地图点的KF和该地图点在KF中的索引
-        map<KeyFrame*,size_t> observations = (*lit)->GetObservations();
+        (*lit)->GetObservations(observations);
         // 遍历所有观测到该地图点的关键帧
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(ObservationMap::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -707,20 +540,12 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
 
     // Setup optimizer
     // Step 4 构造g2o优化器
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-    // LM大法好
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
-
-    // 外界设置的停止优化标志
-    // 可能在 Tracking::NeedNewKeyFrame() 里置位
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+    // 优化器(LM + BlockSolver_6_3 + LinearSolverEigen)、顶点和边都从工作空间中取
+    // 把上一次局部BA的顶点和边放回对象池
+    // 有线程池时按地图点划分各条边,并行地线性化和计算Schur补
+    // 外界设置的停止优化标志可能在 Tracking::NeedNewKeyFrame() 里置位
+    pWorkspace->Reset(pThreadPool, pbStopFlag);
+    g2o::SparseOptimizer& optimizer = pWorkspace->GetOptimizer();
 
     // 记录参与局部BA的最大关键帧mnId
     unsigned long maxKFid = 0;
@@ -730,7 +555,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<KeyFrame*>::iterator lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = pWorkspace->NewVertexSE3();
         // 设置初始优化位姿
         vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
         vSE3->setId(pKFi->mnId);
@@ -747,7 +572,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<KeyFrame*>::iterator lit=lFixedCameras.begin(), lend=lFixedCameras.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = pWorkspace->NewVertexSE3();
         vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
         vSE3->setId(pKFi->mnId);
          // 所有的这些顶点的位姿都不优化，只是为了增加约束项
@@ -791,7 +616,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     {
         // 添加顶点：MapPoint
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+        g2o::VertexSBAPointXYZ* vPoint = pWorkspace->NewVertexPoint();
         vPoint->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
         // 前面记录maxKFid的作用在这里体现
         int id = pMP->mnId+maxKFid+1;
@@ -801,17 +626,18 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         optimizer.addVertex(vPoint);
 
         // 观测到该地图点的KF和该地图点在KF中的索引
-        const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        pMP->GetObservations(observations);
 
         // Set edges
         // Step 8 在添加完了一个地图点之后, 对每一对关联的地图点和关键帧构建边
         // 遍历所有观测到当前地图点的关键帧
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(ObservationMap::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
             if(!pKFi->isBad())
             {                
+                pKFi->LoadFeatures();
                 const cv::KeyPoint &kpUn = pKFi->mvKeysUn[mit->second];
                 // 根据单目/双目两种不同的输入构造不同的误差边
                 // Monocular observation
@@ -821,7 +647,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     Eigen::Matrix<double,2,1> obs;
                     obs << kpUn.pt.x, kpUn.pt.y;
 
-                    g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+                    // 使用鲁棒核函数抑制外点，池中的边自带Huber核函数
+                    g2o::EdgeSE3ProjectXYZ* e = pWorkspace->NewEdgeMono(thHuberMono);
                     // 边的第一个顶点是地图点
                     e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
                     // 边的第一个顶点是观测到该地图点的关键帧
@@ -831,11 +658,6 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
                     e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
 
-                    // 使用鲁棒核函数抑制外点
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberMono);
-
                     e->fx = pKFi->fx;
                     e->fy = pKFi->fy;
                     e->cx = pKFi->cx;
@@ -853,7 +675,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     const float kp_ur = pKFi->mvuRight[mit->second];
                     obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                    g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+                    g2o::EdgeStereoSE3ProjectXYZ* e = pWorkspace->NewEdgeStereo(thHuberStereo);
 
                     e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
                     e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
@@ -862,10 +684,6 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberStereo);
-
                     e->fx = pKFi->fx;
                     e->fy = pKFi->fy;
                     e->cx = pKFi->cx;
@@ -923,7 +741,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                 e->setLevel(1);
             }
             // 第二阶段优化的时候就属于精求解了,所以就不使用核函数
-            e->setRobustKernel(0);
+            // 核函数归工作空间所有,只取下而不删除
+            e->releaseRobustKernel();
         }
 
         // 对于所有的双目的误差边也都进行类似的操作
@@ -940,7 +759,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                 e->setLevel(1);
             }
 
-            e->setRobustKernel(0);
+            e->releaseRobustKernel();
         }
 
         // Optimize again without the outliers
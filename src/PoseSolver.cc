@@ -0,0 +1,323 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoseSolver.h"
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Cholesky>
+
+namespace ORB_SLAM2
+{
+
+// 卡方检验阈值,自由度为2和3,置信度95%
+static const float chi2Mono[4]={5.991,5.991,5.991,5.991};
+static const float chi2Stereo[4]={7.815,7.815,7.815,7.815};
+// 每轮的迭代次数
+static const int its[4]={10,10,10,10};
+// Huber核函数的阈值,和g2o一样先存成float
+static const float deltaMono = sqrt(5.991);
+static const float deltaStereo = sqrt(7.815);
+
+PoseSolver::PoseSolver():fx(0), fy(0), cx(0), cy(0), bf(0), mbRobust(true)
+{
+    mx.setZero();
+}
+
+void PoseSolver::Reset(double fx_, double fy_, double cx_, double cy_, double bf_)
+{
+    fx = fx_;
+    fy = fy_;
+    cx = cx_;
+    cy = cy_;
+    bf = bf_;
+    mbRobust = true;
+    mvObservations.clear();
+    mx.setZero();
+}
+
+void PoseSolver::AddMonoObservation(const double Xw[3], double u, double v, double invSigma2)
+{
+    Observation o;
+    o.Xw[0] = Xw[0];
+    o.Xw[1] = Xw[1];
+    o.Xw[2] = Xw[2];
+    o.obs[0] = u;
+    o.obs[1] = v;
+    o.obs[2] = 0;
+    o.invSigma2 = invSigma2;
+    o.chi2 = 0;
+    o.bStereo = false;
+    o.bOutlier = false;
+    mvObservations.push_back(o);
+}
+
+void PoseSolver::AddStereoObservation(const double Xw[3], double u, double v, double ur, double invSigma2)
+{
+    Observation o;
+    o.Xw[0] = Xw[0];
+    o.Xw[1] = Xw[1];
+    o.Xw[2] = Xw[2];
+    o.obs[0] = u;
+    o.obs[1] = v;
+    o.obs[2] = ur;
+    o.invSigma2 = invSigma2;
+    o.chi2 = 0;
+    o.bStereo = true;
+    o.bOutlier = false;
+    mvObservations.push_back(o);
+}
+
+double PoseSolver::ComputeErrors(const g2o::SE3Quat &Tcw, bool bOutliers)
+{
+    double chi = 0;
+    for(size_t i=0, iend=mvObservations.size(); i<iend; i++)
+    {
+        Observation &o = mvObservations[i];
+        if(o.bOutlier!=bOutliers)
+            continue;
+
+        const Eigen::Vector3d Xc = Tcw.map(Eigen::Vector3d(o.Xw[0],o.Xw[1],o.Xw[2]));
+
+        if(!o.bStereo)
+        {
+            // EdgeSE3ProjectXYZOnlyPose::computeError
+            o.err[0] = o.obs[0] - (Xc[0]/Xc[2]*fx + cx);
+            o.err[1] = o.obs[1] - (Xc[1]/Xc[2]*fy + cy);
+            o.chi2 = (o.err[0]*o.err[0] + o.err[1]*o.err[1])*o.invSigma2;
+        }
+        else
+        {
+            // EdgeStereoSE3ProjectXYZOnlyPose::computeError,逆深度用的是float
+            const float invz = 1.0f/Xc[2];
+            const double u = Xc[0]*invz*fx + cx;
+            const double v = Xc[1]*invz*fy + cy;
+            o.err[0] = o.obs[0] - u;
+            o.err[1] = o.obs[1] - v;
+            o.err[2] = o.obs[2] - (u - bf*invz);
+            o.chi2 = (o.err[0]*o.err[0] + o.err[1]*o.err[1] + o.err[2]*o.err[2])*o.invSigma2;
+        }
+
+        if(bOutliers)
+            continue;
+
+        // SparseOptimizer::activeRobustChi2
+        const double delta = o.bStereo ? deltaStereo : deltaMono;
+        if(mbRobust && o.chi2>delta*delta)
+            chi += 2*sqrt(o.chi2)*delta - delta*delta;
+        else
+            chi += o.chi2;
+    }
+    return chi;
+}
+
+void PoseSolver::BuildSystem(const g2o::SE3Quat &Tcw)
+{
+    mH.setZero();
+    mb.setZero();
+
+    Eigen::Matrix<double,3,6> J;
+    for(size_t i=0, iend=mvObservations.size(); i<iend; i++)
+    {
+        const Observation &o = mvObservations[i];
+        if(o.bOutlier)
+            continue;
+
+        const Eigen::Vector3d Xc = Tcw.map(Eigen::Vector3d(o.Xw[0],o.Xw[1],o.Xw[2]));
+        const double x = Xc[0];
+        const double y = Xc[1];
+        const double invz = 1.0/Xc[2];
+        const double invz_2 = invz*invz;
+
+        // 误差对位姿扰动(旋转在前,平移在后)的雅克比,和 linearizeOplus 相同
+        J(0,0) =  x*y*invz_2 *fx;
+        J(0,1) = -(1+(x*x*invz_2)) *fx;
+        J(0,2) = y*invz *fx;
+        J(0,3) = -invz *fx;
+        J(0,4) = 0;
+        J(0,5) = x*invz_2 *fx;
+
+        J(1,0) = (1+y*y*invz_2) *fy;
+        J(1,1) = -x*y*invz_2 *fy;
+        J(1,2) = -x*invz *fy;
+        J(1,3) = 0;
+        J(1,4) = -invz *fy;
+        J(1,5) = y*invz_2 *fy;
+
+        // Huber核函数的一阶导数作为权重
+        double w = o.invSigma2;
+        const double delta = o.bStereo ? deltaStereo : deltaMono;
+        if(mbRobust && o.chi2>delta*delta)
+            w *= delta/sqrt(o.chi2);
+
+        if(!o.bStereo)
+        {
+            const Eigen::Matrix<double,2,6> J2 = J.topRows<2>();
+            mH.noalias() += w*J2.transpose()*J2;
+            mb.noalias() -= w*J2.transpose()*Eigen::Vector2d(o.err[0],o.err[1]);
+        }
+        else
+        {
+            J(2,0) = J(0,0)-bf*y*invz_2;
+            J(2,1) = J(0,1)+bf*x*invz_2;
+            J(2,2) = J(0,2);
+            J(2,3) = J(0,3);
+            J(2,4) = 0;
+            J(2,5) = J(0,5)-bf*invz_2;
+
+            mH.noalias() += w*J.transpose()*J;
+            mb.noalias() -= w*J.transpose()*Eigen::Vector3d(o.err[0],o.err[1],o.err[2]);
+        }
+    }
+}
+
+g2o::SE3Quat PoseSolver::Levenberg(g2o::SE3Quat &Tcw, int nIterations)
+{
+    // 参数和 OptimizationAlgorithmLevenberg 的默认值相同
+    const double tau = 1e-5;
+    const double goodStepUpperScale = 2./3.;
+    const double goodStepLowerScale = 1./3.;
+    const int maxTrialsAfterFailure = 10;
+
+    double lambda = 0;
+    int ni = 2;
+    int nBad = 0;
+
+    g2o::SE3Quat lastEvaluated = Tcw;
+
+    for(int iteration=0; iteration<nIterations; iteration++)
+    {
+        double currentChi = ComputeErrors(Tcw,false);
+        const double iniChi = currentChi;
+
+        BuildSystem(Tcw);
+
+        if(iteration==0)
+        {
+            lambda = tau*mH.diagonal().cwiseAbs().maxCoeff();
+            ni = 2;
+            nBad = 0;
+        }
+
+        double rho = 0;
+        int qmax = 0;
+        do
+        {
+            const g2o::SE3Quat backup = Tcw;
+
+            Matrix6d H = mH;
+            H.diagonal().array() += lambda;
+            Eigen::LDLT<Matrix6d> ldlt(H);
+            const bool ok = ldlt.isPositive();
+            // 分解失败时g2o不更新解向量,沿用上一次的解
+            if(ok)
+                mx = ldlt.solve(mb);
+
+            Tcw = g2o::SE3Quat::exp(mx)*Tcw;
+
+            double tempChi = ComputeErrors(Tcw,false);
+            lastEvaluated = Tcw;
+            if(!ok)
+                tempChi = std::numeric_limits<double>::max();
+
+            rho = currentChi-tempChi;
+            double scale = mx.dot(lambda*mx + mb);
+            scale += 1e-3;
+            rho /= scale;
+
+            if(rho>0 && std::isfinite(tempChi))
+            {
+                double alpha = 1.-pow((2*rho-1),3);
+                alpha = std::min(alpha,goodStepUpperScale);
+                const double scaleFactor = std::max(goodStepLowerScale,alpha);
+                lambda *= scaleFactor;
+                ni = 2;
+                currentChi = tempChi;
+            }
+            else
+            {
+                lambda *= ni;
+                ni *= 2;
+                Tcw = backup;
+            }
+            qmax++;
+        } while(rho<0 && qmax<maxTrialsAfterFailure);
+
+        if(qmax==maxTrialsAfterFailure || rho==0)
+            break;
+
+        if((iniChi-currentChi)*1e3<iniChi)
+            nBad++;
+        else
+            nBad = 0;
+
+        if(nBad>=3)
+            break;
+    }
+
+    return lastEvaluated;
+}
+
+int PoseSolver::Optimize(g2o::SE3Quat &Tcw)
+{
+    const g2o::SE3Quat Tcw0 = Tcw;
+    const size_t N = mvObservations.size();
+
+    int nBad = 0;
+    for(size_t it=0; it<4; it++)
+    {
+        // 每一轮都从初始位姿开始
+        Tcw = Tcw0;
+
+        size_t nInliers = 0;
+        for(size_t i=0; i<N; i++)
+            if(!mvObservations[i].bOutlier)
+                nInliers++;
+
+        // 内点的误差停留在最后一次计算误差的位姿上,外点的误差在最终位姿上重新计算
+        if(nInliers>0)
+        {
+            const g2o::SE3Quat lastEvaluated = Levenberg(Tcw,its[it]);
+            ComputeErrors(lastEvaluated,false);
+        }
+        ComputeErrors(Tcw,true);
+
+        nBad = 0;
+        for(size_t i=0; i<N; i++)
+        {
+            Observation &o = mvObservations[i];
+            const float th = o.bStereo ? chi2Stereo[it] : chi2Mono[it];
+            o.bOutlier = o.chi2>th;
+            if(o.bOutlier)
+                nBad++;
+        }
+
+        // 最后一轮不使用核函数
+        if(it==2)
+            mbRobust = false;
+
+        if(N<10)
+            break;
+    }
+
+    return nBad;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,241 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Serializer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ORB_SLAM2
+{
+
+bool Serializer::CheckAvailable(std::istream &f, uint64_t n, size_t elemSize)
+{
+    if(!f.good())
+        return false;
+
+    // 地图文件都是通过MemoryBuffer读取的,剩余的字节数可以直接得到
+    uint64_t nRemaining = 0;
+    const MemoryBuffer* pBuf = dynamic_cast<const MemoryBuffer*>(f.rdbuf());
+    if(pBuf)
+        nRemaining = pBuf->Remaining();
+    else
+    {
+        // 其它流只能定位到末尾再回来,不支持定位的流无法检查
+        const std::streampos cur = f.tellg();
+        if(cur==std::streampos(-1))
+            return true;
+        f.seekg(0,std::ios::end);
+        const std::streampos end = f.tellg();
+        f.seekg(cur);
+        if(end==std::streampos(-1) || !f.good())
+        {
+            f.setstate(std::ios::failbit);
+            return false;
+        }
+        nRemaining = static_cast<uint64_t>(end-cur);
+    }
+
+    // 用除法比较,避免 n*elemSize 溢出
+    if(elemSize>0 && n>nRemaining/elemSize)
+    {
+        f.setstate(std::ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+void Serializer::WriteMat(std::ostream &f, const cv::Mat &m)
+{
+    // 行数、列数、类型,然后逐行写入数据(矩阵不一定是连续存储的)
+    const int32_t rows = m.rows, cols = m.cols, type = m.type();
+    Write(f,rows);
+    Write(f,cols);
+    Write(f,type);
+
+    const size_t rowBytes = cols*m.elemSize();
+    for(int i=0; i<rows; i++)
+        f.write(reinterpret_cast<const char*>(m.ptr(i)), rowBytes);
+}
+
+void Serializer::ReadMat(std::istream &f, cv::Mat &m)
+{
+    int32_t rows = 0, cols = 0, type = 0;
+    Read(f,rows);
+    Read(f,cols);
+    Read(f,type);
+
+    if(!f.good() || rows<=0 || cols<=0)
+    {
+        m.release();
+        return;
+    }
+
+    // 类型不合法或者剩下的数据不够这么大的矩阵,说明文件已经损坏
+    if(CV_MAT_TYPE(type)!=type ||
+       !CheckAvailable(f,static_cast<uint64_t>(rows)*static_cast<uint64_t>(cols),CV_ELEM_SIZE(type)))
+    {
+        f.setstate(std::ios::failbit);
+        m.release();
+        return;
+    }
+
+    m.create(rows,cols,type);
+    f.read(reinterpret_cast<char*>(m.data), m.total()*m.elemSize());
+}
+
+void Serializer::WriteKeyPoints(std::ostream &f, const std::vector<cv::KeyPoint> &vKeys)
+{
+    const uint64_t n = vKeys.size();
+    Write(f,n);
+    for(size_t i=0; i<vKeys.size(); i++)
+    {
+        const cv::KeyPoint &kp = vKeys[i];
+        Write(f,kp.pt.x);
+        Write(f,kp.pt.y);
+        Write(f,kp.size);
+        Write(f,kp.angle);
+        Write(f,kp.response);
+        Write(f,kp.octave);
+        Write(f,kp.class_id);
+    }
+}
+
+void Serializer::ReadKeyPoints(std::istream &f, std::vector<cv::KeyPoint> &vKeys)
+{
+    uint64_t n = 0;
+    Read(f,n);
+    vKeys.clear();
+
+    // 每个特征点写入了5个float和2个int
+    const size_t nKeyPointSize = 5*sizeof(float)+2*sizeof(int);
+    if(!CheckAvailable(f,n,nKeyPointSize))
+        return;
+
+    vKeys.resize(n);
+    for(size_t i=0; i<n && f.good(); i++)
+    {
+        cv::KeyPoint &kp = vKeys[i];
+        Read(f,kp.pt.x);
+        Read(f,kp.pt.y);
+        Read(f,kp.size);
+        Read(f,kp.angle);
+        Read(f,kp.response);
+        Read(f,kp.octave);
+        Read(f,kp.class_id);
+    }
+}
+
+void Serializer::WriteBowVector(std::ostream &f, const DBoW2::BowVector &v)
+{
+    const uint64_t n = v.size();
+    Write(f,n);
+    for(DBoW2::BowVector::const_iterator vit=v.begin(), vend=v.end(); vit!=vend; vit++)
+    {
+        Write(f,vit->first);
+        Write(f,vit->second);
+    }
+}
+
+void Serializer::ReadBowVector(std::istream &f, DBoW2::BowVector &v)
+{
+    uint64_t n = 0;
+    Read(f,n);
+    v.clear();
+    if(!CheckAvailable(f,n,sizeof(DBoW2::WordId)+sizeof(DBoW2::WordValue)))
+        return;
+
+    // map按键值顺序写出,这里用end作为插入提示,每次插入都是常数时间
+    for(size_t i=0; i<n && f.good(); i++)
+    {
+        DBoW2::WordId wid;
+        DBoW2::WordValue value;
+        Read(f,wid);
+        Read(f,value);
+        v.insert(v.end(), DBoW2::BowVector::value_type(wid,value));
+    }
+}
+
+void Serializer::WriteFeatureVector(std::ostream &f, const DBoW2::FeatureVector &v)
+{
+    const uint64_t n = v.size();
+    Write(f,n);
+    for(DBoW2::FeatureVector::const_iterator vit=v.begin(), vend=v.end(); vit!=vend; vit++)
+    {
+        Write(f,vit->first);
+        WriteVector(f,vit->second);
+    }
+}
+
+void Serializer::ReadFeatureVector(std::istream &f, DBoW2::FeatureVector &v)
+{
+    uint64_t n = 0;
+    Read(f,n);
+    v.clear();
+    // 每一项至少有节点id和特征点个数
+    if(!CheckAvailable(f,n,sizeof(DBoW2::NodeId)+sizeof(uint64_t)))
+        return;
+
+    for(size_t i=0; i<n && f.good(); i++)
+    {
+        DBoW2::NodeId nid;
+        Read(f,nid);
+        DBoW2::FeatureVector::iterator vit = v.insert(v.end(), DBoW2::FeatureVector::value_type(nid,std::vector<unsigned int>()));
+        ReadVector(f,vit->second);
+    }
+}
+
+MappedFile::MappedFile():mpData(NULL), mnSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if(mpData)
+        munmap(const_cast<char*>(mpData), mnSize);
+}
+
+bool MappedFile::Open(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // 只读共享映射,页面在第一次访问时才从文件中读入,内存紧张时可以直接丢弃
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    mpData = (const char*)data;
+    mnSize = st.st_size;
+    return true;
+}
+
+} //namespace ORB_SLAM
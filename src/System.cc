@@ -23,11 +23,16 @@
 //包含了一些自建库
 #include "System.h"
 #include "Converter.h"		// TODO 目前还不是很明白这个是做什么的
+#include "Serializer.h"		//地图的保存和加载
 //包含共有库
 #include <thread>					//多线程
 #include <pangolin/pangolin.h>		//可视化界面
 #include <iomanip>					//主要是对cin,cout之类的一些操纵运算子
 #include <unistd.h>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <memory>
 namespace ORB_SLAM2
 {
 
@@ -40,7 +45,11 @@ System::System(const string &strVocFile,					//词典文件路径
 					 mpViewer(static_cast<Viewer*>(NULL)),		//空。。。对象指针？  TODO 
 					 mbReset(false),							//无复位标志
 					 mbActivateLocalizationMode(false),			//没有这个模式转换标志
-        			 mbDeactivateLocalizationMode(false)		//没有这个模式转换标志
+        			 mbDeactivateLocalizationMode(false),		//没有这个模式转换标志
+        			 mTrackingState(Tracking::NO_IMAGES_YET),	//还没有图像
+        			 mptTrackingPipeline(static_cast<thread*>(NULL)),	//流水线跟踪线程在第一次调用Track*Async时才启动
+        			 mbTrackingJobRunning(false),
+        			 mbFinishPipeline(false)
 {
     // Output welcome message
     cout << endl <<
@@ -76,7 +85,12 @@ System::System(const string &strVocFile,					//词典文件路径
     //建立一个新的ORB字典
     mpVocabulary = new ORBVocabulary();
     //获取字典加载状态
-    bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+    //.bin 结尾的是 tools/bin_vocabulary 转换得到的二进制字典，直接内存映射，不需要解析文本
+    bool bVocLoad;
+    if(strVocFile.size()>4 && strVocFile.compare(strVocFile.size()-4,4,".bin")==0)
+        bVocLoad = mpVocabulary->loadFromBinaryFile(strVocFile);
+    else
+        bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
     //如果加载失败，就输出调试信息
     if(!bVocLoad)
     {
@@ -91,6 +105,15 @@ System::System(const string &strVocFile,					//词典文件路径
     //Create KeyFrame Database
     mpKeyFrameDatabase = new KeyFrameDatabase(*mpVocabulary);
 
+    //Create the thread pool shared by the hot paths (stereo extraction, initialization ...)
+    //常驻的线程池，避免每帧都创建/销毁线程，同时限制整个进程中额外的并行线程数
+    //配置文件中没有 ThreadPool.nThreads 时使用 CPU核数-1，因为提交任务的线程自己也会参与计算
+    int nPoolThreads = fsSettings["ThreadPool.nThreads"];
+    if(nPoolThreads<=0)
+        nPoolThreads = std::max(1, (int)std::thread::hardware_concurrency()-1);
+    mpThreadPool = new ThreadPool(nPoolThreads);
+    cout << "Thread pool workers: " << nPoolThreads << endl;
+
     //Create the Map
     mpMap = new Map();    // 这个时候就是一个空地图
 
@@ -146,6 +169,9 @@ System::System(const string &strVocFile,					//词典文件路径
 
     //Set pointers between threads
     //设置进程间的指针
+    mpTracker->SetThreadPool(mpThreadPool);
+    mpLocalMapper->SetThreadPool(mpThreadPool);
+    mpLoopCloser->SetThreadPool(mpThreadPool);
     mpTracker->SetLocalMapper(mpLocalMapper);
     mpTracker->SetLoopClosing(mpLoopCloser);
 
@@ -169,6 +195,9 @@ cv::Mat System::TrackStereo(const cv::Mat &imLeft, 		//左侧图像
         exit(-1);
     }   
 
+    // 如果之前使用过流水线接口，先等待其中的帧跟踪完毕
+    WaitTrackingPipeline();
+
     //检查是否有运行模式的改变
     // Check mode change
     {
@@ -181,10 +210,7 @@ cv::Mat System::TrackStereo(const cv::Mat &imLeft, 		//左侧图像
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
             //运行到这里的时候，局部建图部分就真正地停止了
             //告知追踪器，现在 只有追踪工作
             mpTracker->InformOnlyTracking(true);// 定位时，只跟踪
@@ -242,6 +268,9 @@ cv::Mat System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const doub
         exit(-1);
     }    
 
+    // 如果之前使用过流水线接口，先等待其中的帧跟踪完毕
+    WaitTrackingPipeline();
+
     // Check mode change
     //检查模式改变
     {
@@ -251,10 +280,7 @@ cv::Mat System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const doub
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -297,6 +323,9 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
         exit(-1);
     }
 
+    // 如果之前使用过流水线接口，先等待其中的帧跟踪完毕
+    WaitTrackingPipeline();
+
     // Check mode change
     {
         // 独占锁，主要是为了mbActivateLocalizationMode和mbDeactivateLocalizationMode不会发生混乱
@@ -307,10 +336,7 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             // 局部地图关闭以后，只进行追踪的线程，只计算相机的位姿，没有对局部地图进行更新
             // 设置mbOnlyTracking为真
@@ -348,6 +374,190 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
     return Tcw;
 }
 
+//流水线跟踪接口：在调用线程中构造帧，在流水线跟踪线程中跟踪
+std::future<cv::Mat> System::TrackStereoAsync(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp)
+{
+    if(mSensor!=STEREO)
+    {
+        cerr << "ERROR: you called TrackStereoAsync but input sensor was not set to STEREO." << endl;
+        exit(-1);
+    }
+
+    CheckPendingRequests();
+
+    // 构造当前帧的同时，跟踪线程还在跟踪上一帧
+    cv::Mat imGray;
+    Frame frame = mpTracker->CreateFrameStereo(imLeft,imRight,timestamp,imGray);
+
+    return PushTrackingJob(frame,imGray);
+}
+
+std::future<cv::Mat> System::TrackRGBDAsync(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp)
+{
+    if(mSensor!=RGBD)
+    {
+        cerr << "ERROR: you called TrackRGBDAsync but input sensor was not set to RGBD." << endl;
+        exit(-1);
+    }
+
+    CheckPendingRequests();
+
+    cv::Mat imGray;
+    Frame frame = mpTracker->CreateFrameRGBD(im,depthmap,timestamp,imGray);
+
+    return PushTrackingJob(frame,imGray);
+}
+
+std::future<cv::Mat> System::TrackMonocularAsync(const cv::Mat &im, const double &timestamp)
+{
+    if(mSensor!=MONOCULAR)
+    {
+        cerr << "ERROR: you called TrackMonocularAsync but input sensor was not set to Monocular." << endl;
+        exit(-1);
+    }
+
+    CheckPendingRequests();
+
+    // Tracking::mState 正在被跟踪线程修改，这里使用最近一个已跟踪帧的状态来选择特征提取器
+    bool bInitializing;
+    {
+        unique_lock<mutex> lock(mMutexState);
+        bInitializing = mTrackingState==Tracking::NOT_INITIALIZED || mTrackingState==Tracking::NO_IMAGES_YET;
+    }
+
+    cv::Mat imGray;
+    Frame frame = mpTracker->CreateFrameMonocular(im,timestamp,bInitializing,imGray);
+
+    return PushTrackingJob(frame,imGray);
+}
+
+//检查模式切换和复位请求。复位会重置Frame::nNextId，所以必须在流水线清空之后、构造下一帧之前执行
+void System::CheckPendingRequests()
+{
+    bool bPending;
+    {
+        unique_lock<mutex> lock(mMutexMode);
+        bPending = mbActivateLocalizationMode || mbDeactivateLocalizationMode;
+    }
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        bPending = bPending || mbReset;
+    }
+    if(!bPending)
+        return;
+
+    WaitTrackingPipeline();
+
+    // Check mode change
+    {
+        unique_lock<mutex> lock(mMutexMode);
+        if(mbActivateLocalizationMode)
+        {
+            mpLocalMapper->RequestStop();
+
+            // Wait until Local Mapping has effectively stopped
+            mpLocalMapper->WaitUntilStopped();
+
+            mpTracker->InformOnlyTracking(true);
+            mbActivateLocalizationMode = false;
+        }
+        if(mbDeactivateLocalizationMode)
+        {
+            mpTracker->InformOnlyTracking(false);
+            mpLocalMapper->Release();
+            mbDeactivateLocalizationMode = false;
+        }
+    }
+
+    // Check reset
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        if(mbReset)
+        {
+            mpTracker->Reset();
+            mbReset = false;
+
+            // 单目需要根据这个状态选择初始化特征提取器
+            unique_lock<mutex> lock2(mMutexState);
+            mTrackingState = mpTracker->mState;
+        }
+    }
+}
+
+//把构造好的帧放入流水线
+std::future<cv::Mat> System::PushTrackingJob(const Frame &frame, const cv::Mat &imGray)
+{
+    TrackingJob* pJob = new TrackingJob();
+    pJob->frame = frame;
+    pJob->imGray = imGray;
+    std::future<cv::Mat> result = pJob->promise.get_future();
+
+    {
+        unique_lock<mutex> lock(mMutexPipeline);
+        if(!mptTrackingPipeline)
+            mptTrackingPipeline = new thread(&System::RunTrackingPipeline, this);
+
+        // 最多只有一帧在排队，跟踪跟不上时阻塞调用线程，避免无限制地缓存帧
+        while(!mlpTrackingJobs.empty())
+            mCondPipeline.wait(lock);
+
+        mlpTrackingJobs.push_back(pJob);
+    }
+    mCondPipeline.notify_all();
+
+    return result;
+}
+
+//流水线跟踪线程：按提交顺序依次跟踪构造好的帧
+void System::RunTrackingPipeline()
+{
+    while(1)
+    {
+        TrackingJob* pJob;
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            while(mlpTrackingJobs.empty() && !mbFinishPipeline)
+                mCondPipeline.wait(lock);
+
+            // 请求退出时先把队列中剩下的帧跟踪完
+            if(mlpTrackingJobs.empty())
+                return;
+
+            pJob = mlpTrackingJobs.front();
+            mlpTrackingJobs.pop_front();
+            mbTrackingJobRunning = true;
+        }
+        // 队列空出来了，调用线程可以放入下一帧
+        mCondPipeline.notify_all();
+
+        cv::Mat Tcw = mpTracker->TrackFrame(pJob->frame,pJob->imGray);
+
+        {
+            unique_lock<mutex> lock(mMutexState);
+            mTrackingState = mpTracker->mState;
+            mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
+            mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+        }
+
+        pJob->promise.set_value(Tcw);
+        delete pJob;
+
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbTrackingJobRunning = false;
+        }
+        mCondPipeline.notify_all();
+    }
+}
+
+//等待流水线中所有的帧都跟踪完毕
+void System::WaitTrackingPipeline()
+{
+    unique_lock<mutex> lock(mMutexPipeline);
+    while(!mlpTrackingJobs.empty() || mbTrackingJobRunning)
+        mCondPipeline.wait(lock);
+}
+
 //激活定位模式
 void System::ActivateLocalizationMode()
 {
@@ -389,6 +599,19 @@ void System::Reset()
 //退出
 void System::Shutdown()
 {
+    // 先把流水线中剩下的帧跟踪完，再结束流水线跟踪线程
+    if(mptTrackingPipeline)
+    {
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbFinishPipeline = true;
+        }
+        mCondPipeline.notify_all();
+        mptTrackingPipeline->join();
+        delete mptTrackingPipeline;
+        mptTrackingPipeline = static_cast<thread*>(NULL);
+    }
+
 	//对局部建图线程和回环检测线程发送终止请求
     mpLocalMapper->RequestFinish();
     mpLoopCloser->RequestFinish();
@@ -398,17 +621,13 @@ void System::Shutdown()
     	//向查看器发送终止请求
         mpViewer->RequestFinish();
         //等到，知道真正地停止
-        while(!mpViewer->isFinished())
-            usleep(5000);
+        mpViewer->WaitUntilFinished();
     }
 
     // Wait until all thread have effectively stopped
-    while(!mpLocalMapper->isFinished() || 
-    	  !mpLoopCloser->isFinished()  || 
-    	   mpLoopCloser->isRunningGBA())			
-    {
-        usleep(5000);
-    }
+    // 回环检测线程还要等正在运行的全局BA结束
+    mpLocalMapper->WaitUntilFinished();
+    mpLoopCloser->WaitUntilFinished();
 
     if(mpViewer)
     	//如果使用了可视化的窗口查看器执行这个
@@ -612,6 +831,244 @@ void System::SaveTrajectoryKITTI(const string &filename)
     cout << endl << "trajectory saved!" << endl;
 }
 
+// 地图文件的文件头
+static const char MAP_FILE_MAGIC[8] = {'O','R','B','S','L','M','A','P'};
+static const uint32_t MAP_FILE_VERSION = 2;
+// 每个关键帧的描述子的起始位置按这个字节数对齐
+static const uint64_t MAP_FILE_ALIGNMENT = 32;
+
+//以二进制格式保存地图
+bool System::SaveMap(const string &filename)
+{
+    cout << endl << "Saving map to " << filename << " ..." << endl;
+
+    // 先写到临时文件再改名,这样即使要覆盖的文件正被LoadMap()映射着也不会被破坏
+    const string tmpname = filename + ".tmp";
+    ofstream f(tmpname.c_str(), ios::out | ios::binary);
+    if(!f.is_open())
+    {
+        cerr << "ERROR: cannot open " << tmpname << endl;
+        return false;
+    }
+
+    // 已经调用过Shutdown(),这里加锁只是为了防止误用时地图被修改
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
+    // 只保存好的关键帧和地图点,按id排序使得每次保存的文件相同
+    vector<KeyFrame*> vpAllKFs = mpMap->GetAllKeyFrames();
+    vector<KeyFrame*> vpKFs;
+    for(size_t i=0; i<vpAllKFs.size(); i++)
+        if(!vpAllKFs[i]->isBad())
+            vpKFs.push_back(vpAllKFs[i]);
+    sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
+
+    vector<MapPoint*> vpAllMPs = mpMap->GetAllMapPoints();
+    vector<MapPoint*> vpMPs;
+    for(size_t i=0; i<vpAllMPs.size(); i++)
+        if(!vpAllMPs[i]->isBad())
+            vpMPs.push_back(vpAllMPs[i]);
+    sort(vpMPs.begin(),vpMPs.end(),[](MapPoint* pMP1, MapPoint* pMP2){ return pMP1->mnId<pMP2->mnId; });
+
+    // 文件头: 标识、版本、传感器类型和字典大小,加载时用来检查。最后是对象数据的位置,写完之后再填
+    f.write(MAP_FILE_MAGIC,sizeof(MAP_FILE_MAGIC));
+    Serializer::Write(f,MAP_FILE_VERSION);
+    Serializer::Write(f,(int32_t)mSensor);
+    Serializer::Write(f,(uint64_t)mpVocabulary->size());
+    const streampos posObjectsOffset = f.tellp();
+    uint64_t nObjectsOffset = 0;
+    Serializer::Write(f,nObjectsOffset);
+
+    // 关键帧的描述子、特征点等数据块,加载时只做内存映射,用到时才读取
+    vector<uint64_t> vFeaturesBegin(vpKFs.size()), vFeaturesEnd(vpKFs.size());
+    const char zeros[MAP_FILE_ALIGNMENT] = {0};
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        const uint64_t pos = f.tellp();
+        f.write(zeros,(MAP_FILE_ALIGNMENT - pos%MAP_FILE_ALIGNMENT) % MAP_FILE_ALIGNMENT);
+        vFeaturesBegin[i] = f.tellp();
+        vpKFs[i]->SaveFeatures(f);
+        vFeaturesEnd[i] = f.tellp();
+    }
+
+    // 关键帧和地图点自身的数据,以及它们之间的关系,加载时全部读取
+    nObjectsOffset = f.tellp();
+    Serializer::Write(f,(uint64_t)vpKFs.size());
+    for(size_t i=0; i<vpKFs.size(); i++)
+        vpKFs[i]->Save(f,vFeaturesBegin[i],vFeaturesEnd[i]);
+
+    Serializer::Write(f,(uint64_t)vpMPs.size());
+    for(size_t i=0; i<vpMPs.size(); i++)
+        vpMPs[i]->Save(f);
+
+    for(size_t i=0; i<vpKFs.size(); i++)
+        vpKFs[i]->SaveLinks(f);
+
+    mpMap->Save(f);
+    mpKeyFrameDatabase->Save(f);
+
+    // 下一个要分配的id
+    Serializer::Write(f,KeyFrame::nNextId);
+    Serializer::Write(f,MapPoint::nNextId);
+    Serializer::Write(f,Frame::nNextId);
+
+    f.seekp(posObjectsOffset);
+    Serializer::Write(f,nObjectsOffset);
+
+    f.close();
+    if(f.fail() || rename(tmpname.c_str(),filename.c_str())!=0)
+    {
+        cerr << "ERROR: failed writing " << filename << endl;
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    cout << "map saved: " << vpKFs.size() << " keyframes, " << vpMPs.size() << " map points" << endl;
+    return true;
+}
+
+//加载SaveMap()保存的地图
+bool System::LoadMap(const string &filename)
+{
+    cout << endl << "Loading map from " << filename << " ..." << endl;
+
+    // 整个文件只读映射,关键帧的描述子直接指向映射中的数据
+    shared_ptr<MappedFile> pMapFile = make_shared<MappedFile>();
+    if(!pMapFile->Open(filename))
+    {
+        cerr << "ERROR: cannot open " << filename << endl;
+        return false;
+    }
+
+    MemoryBuffer headerBuf(pMapFile->Data(),pMapFile->Size());
+    istream fh(&headerBuf);
+
+    char magic[sizeof(MAP_FILE_MAGIC)];
+    uint32_t nVersion = 0;
+    int32_t nSensor = -1;
+    uint64_t nVocSize = 0;
+    uint64_t nObjectsOffset = 0;
+    fh.read(magic,sizeof(magic));
+    Serializer::Read(fh,nVersion);
+    Serializer::Read(fh,nSensor);
+    Serializer::Read(fh,nVocSize);
+    Serializer::Read(fh,nObjectsOffset);
+
+    if(!fh.good() || memcmp(magic,MAP_FILE_MAGIC,sizeof(magic))!=0 || nVersion!=MAP_FILE_VERSION ||
+       nObjectsOffset>pMapFile->Size())
+    {
+        cerr << "ERROR: " << filename << " is not a map file of this version" << endl;
+        return false;
+    }
+    if(nSensor!=mSensor)
+    {
+        cerr << "ERROR: the map was saved with a different sensor type" << endl;
+        return false;
+    }
+    if(nVocSize!=(uint64_t)mpVocabulary->size())
+    {
+        cerr << "ERROR: the map was saved with a different vocabulary" << endl;
+        return false;
+    }
+
+    // 关键帧、地图点和它们之间的关系
+    MemoryBuffer buf(pMapFile->Data()+nObjectsOffset,pMapFile->Size()-nObjectsOffset);
+    istream f(&buf);
+
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
+    mpMap->clear();
+    mpKeyFrameDatabase->clear();
+
+    // 构造关键帧和地图点时会分配新的id,先记下来,加载完后恢复
+    const long unsigned int nCurrentKFid = KeyFrame::nNextId;
+    const long unsigned int nCurrentMPid = MapPoint::nNextId;
+
+    vector<KeyFrame*> vpKFs;
+    map<long unsigned int, KeyFrame*> mKFs;
+    map<long unsigned int, MapPoint*> mMPs;
+    bool bOK = true;
+
+    uint64_t nKFs = 0;
+    Serializer::Read(f,nKFs);
+    for(uint64_t i=0; bOK && i<nKFs; i++)
+    {
+        KeyFrame* pKF = KeyFrame::Load(f,mpMap,mpKeyFrameDatabase,mpVocabulary,pMapFile);
+        if(!pKF)
+        {
+            bOK = false;
+            break;
+        }
+        // 加入地图,这样失败时clear()可以释放它
+        mpMap->AddKeyFrame(pKF);
+        vpKFs.push_back(pKF);
+        mKFs[pKF->mnId] = pKF;
+    }
+
+    uint64_t nMPs = 0;
+    if(bOK)
+        Serializer::Read(f,nMPs);
+    for(uint64_t i=0; bOK && i<nMPs; i++)
+    {
+        MapPoint* pMP = MapPoint::Load(f,mpMap,mKFs);
+        if(!pMP)
+        {
+            // 参考关键帧不存在的地图点直接丢掉,流出错才是真正的失败
+            bOK = f.good();
+            continue;
+        }
+        mpMap->AddMapPoint(pMP);
+        mMPs[pMP->mnId] = pMP;
+    }
+
+    // 关系和关键帧按相同的顺序保存
+    for(size_t i=0; bOK && i<vpKFs.size(); i++)
+    {
+        vpKFs[i]->LoadLinks(f,mKFs,mMPs);
+        bOK = f.good();
+    }
+
+    long unsigned int nNextKFid = 0, nNextMPid = 0, nNextFrameId = 0;
+    if(bOK)
+    {
+        mpMap->Load(f,mKFs);
+        mpKeyFrameDatabase->Load(f,mKFs);
+
+        Serializer::Read(f,nNextKFid);
+        Serializer::Read(f,nNextMPid);
+        Serializer::Read(f,nNextFrameId);
+        bOK = f.good();
+    }
+
+    if(!bOK)
+    {
+        cerr << "ERROR: failed reading " << filename << endl;
+        mpKeyFrameDatabase->clear();
+        mpMap->clear();
+        KeyFrame::nNextId = nCurrentKFid;
+        MapPoint::nNextId = nCurrentMPid;
+        return false;
+    }
+
+    // 新创建的关键帧、地图点和帧的id要比地图中已有的都大
+    KeyFrame::nNextId = max(nNextKFid,KeyFrame::nNextId);
+    MapPoint::nNextId = max(nNextMPid,MapPoint::nNextId);
+    Frame::nNextId = max(nNextFrameId,Frame::nNextId);
+
+    // 读取关键帧时修改了Frame中和相机有关的静态变量,第一帧时用配置文件中的参数重新计算
+    Frame::mbInitialComputations = true;
+
+    // 没有观测的地图点不能用来跟踪
+    for(map<long unsigned int, MapPoint*>::iterator mit=mMPs.begin(), mend=mMPs.end(); mit!=mend; mit++)
+        if(mit->second->Observations()==0)
+            mit->second->SetBadFlag();
+
+    // 跟踪从丢失状态开始,第一帧通过重定位确定在地图中的位置
+    mpTracker->mState = Tracking::LOST;
+
+    cout << "map loaded: " << mKFs.size() << " keyframes, " << mMPs.size() << " map points" << endl;
+    return true;
+}
+
 //获取追踪器状态
 int System::GetTrackingState()
 {
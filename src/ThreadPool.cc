@@ -0,0 +1,204 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+// 当前线程所属的线程池和在池中的编号,用于把工作线程自己提交的任务放到自己的队列中
+static thread_local ThreadPool* tpCurrentPool = NULL;
+static thread_local int tnWorkerId = -1;
+
+ThreadPool::ThreadPool(int nThreads):mnNextQueue(0), mnPending(0), mbStop(false)
+{
+    for(int i=0; i<nThreads; i++)
+        mvpQueues.push_back(new WorkQueue());
+
+    for(int i=0; i<nThreads; i++)
+        mvThreads.push_back(thread(&ThreadPool::Run,this,i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> lock(mMutexSleep);
+        mbStop = true;
+    }
+    mCondSleep.notify_all();
+
+    for(size_t i=0; i<mvThreads.size(); i++)
+        mvThreads[i].join();
+
+    for(size_t i=0; i<mvpQueues.size(); i++)
+        delete mvpQueues[i];
+}
+
+int ThreadPool::GetNumThreads() const
+{
+    return mvThreads.size();
+}
+
+void ThreadPool::Push(const function<void()> &task)
+{
+    // 工作线程提交的任务放到自己的队列中,其他线程提交的任务轮流放到各个队列中
+    size_t id;
+    if(tpCurrentPool==this)
+        id = tnWorkerId;
+    else
+        id = mnNextQueue.fetch_add(1) % mvpQueues.size();
+
+    {
+        unique_lock<mutex> lock(mvpQueues[id]->mMutex);
+        mvpQueues[id]->mdTasks.push_back(task);
+    }
+
+    mnPending.fetch_add(1);
+    {
+        unique_lock<mutex> lock(mMutexSleep);
+    }
+    mCondSleep.notify_one();
+}
+
+bool ThreadPool::Pop(int id, function<void()> &task)
+{
+    const int nQueues = mvpQueues.size();
+
+    // 先从自己队列的尾部取
+    if(id>=0)
+    {
+        WorkQueue* pQueue = mvpQueues[id];
+        unique_lock<mutex> lock(pQueue->mMutex);
+        if(!pQueue->mdTasks.empty())
+        {
+            task = pQueue->mdTasks.back();
+            pQueue->mdTasks.pop_back();
+            mnPending.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // 再从其他队列的头部偷,偷最早提交的任务
+    const int start = id<0 ? 0 : id+1;
+    for(int k=0; k<nQueues; k++)
+    {
+        const int i = (start+k) % nQueues;
+        if(i==id)
+            continue;
+        WorkQueue* pQueue = mvpQueues[i];
+        unique_lock<mutex> lock(pQueue->mMutex);
+        if(!pQueue->mdTasks.empty())
+        {
+            task = pQueue->mdTasks.front();
+            pQueue->mdTasks.pop_front();
+            mnPending.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::Run(int id)
+{
+    tpCurrentPool = this;
+    tnWorkerId = id;
+
+    while(1)
+    {
+        function<void()> task;
+        if(Pop(id,task))
+        {
+            task();
+            continue;
+        }
+
+        unique_lock<mutex> lock(mMutexSleep);
+        // 析构时先把剩下的任务做完再退出
+        if(mbStop && mnPending.load()==0)
+            return;
+        while(!mbStop && mnPending.load()==0)
+            mCondSleep.wait(lock);
+    }
+}
+
+/**
+ * @brief ParallelFor 的共享状态
+ * @details 工作线程可能在 ParallelFor 返回之后才取到任务,所以状态用 shared_ptr 保存,不能放在调用者的栈上
+ */
+struct ParallelForState
+{
+    ParallelForState(int n, const function<void(int)> &f):
+        nTotal(n), nNext(0), nDone(0), func(f){}
+
+    /** @brief 不断领取下一个索引并执行,直到所有索引都被领取 */
+    void Work()
+    {
+        int i;
+        while((i = nNext.fetch_add(1)) < nTotal)
+        {
+            func(i);
+            if(nDone.fetch_add(1)+1 == nTotal)
+            {
+                unique_lock<mutex> lock(mMutexDone);
+                mCondDone.notify_all();
+            }
+        }
+    }
+
+    const int nTotal;
+    atomic<int> nNext;
+    atomic<int> nDone;
+    function<void(int)> func;
+    mutex mMutexDone;
+    condition_variable mCondDone;
+};
+
+void ThreadPool::ParallelFor(int n, const function<void(int)> &func)
+{
+    if(n<=0)
+        return;
+
+    // 没有工作线程或者只有一个索引,直接在当前线程执行
+    if(mvThreads.empty() || n==1)
+    {
+        for(int i=0; i<n; i++)
+            func(i);
+        return;
+    }
+
+    shared_ptr<ParallelForState> pState = make_shared<ParallelForState>(n,func);
+
+    // 调用线程自己也参与,所以最多只需要 n-1 个辅助任务
+    const int nHelpers = min<int>(mvThreads.size(), n-1);
+    for(int i=0; i<nHelpers; i++)
+        Push([pState](){ pState->Work(); });
+
+    pState->Work();
+
+    // 所有索引都已经被领取,等待其他线程把正在执行的索引做完
+    unique_lock<mutex> lock(pState->mMutexDone);
+    while(pState->nDone.load() < n)
+        pState->mCondDone.wait(lock);
+}
+
+} //namespace ORB_SLAM
@@ -46,6 +46,7 @@
 #include <iostream>
 #include <cmath>
 #include <mutex>
+#include <atomic>
 
 
 using namespace std;
@@ -80,6 +81,7 @@ Tracking::Tracking(
         mpORBVocabulary(pVoc),          
         mpKeyFrameDB(pKFDB), 
         mpInitializer(static_cast<Initializer*>(NULL)),     //暂时给地图初始化器设置为空指针
+        mpThreadPool(static_cast<ThreadPool*>(NULL)),       //线程池由System创建后再设置
         mpSystem(pSys), 
         mpViewer(NULL),                                     //注意可视化的查看器是可选的，因为ORB-SLAM2最后是被编译成为一个库，所以对方人拿过来用的时候也应该有权力说我不要可视化界面（何况可视化界面也要占用不少的CPU资源）
         mpFrameDrawer(pFrameDrawer),
@@ -170,6 +172,9 @@ Tracking::Tracking(
     int fIniThFAST = fSettings["ORBextractor.iniThFAST"];
     // 如果默认阈值提取不出足够fast特征点，则使用最小阈值 8
     int fMinThFAST = fSettings["ORBextractor.minThFAST"];
+    // 并行处理金字塔各层的线程数，配置文件中没有这一项时为0，即串行提取
+    int nExtractorThreads = fSettings["ORBextractor.nThreads"];
+    mbParallelExtraction = nExtractorThreads>1;
 
     // tracking过程都会用到mpORBextractorLeft作为特征点提取器
     mpORBextractorLeft = new ORBextractor(
@@ -177,15 +182,16 @@ Tracking::Tracking(
         fScaleFactor,
         nLevels,
         fIniThFAST,
-        fMinThFAST);
+        fMinThFAST,
+        nExtractorThreads);
 
     // 如果是双目，tracking过程中还会用用到mpORBextractorRight作为右目特征点提取器
     if(sensor==System::STEREO)
-        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nExtractorThreads);
 
     // 在单目初始化的时候，会用mpIniORBextractor来作为特征点提取器
     if(sensor==System::MONOCULAR)
-        mpIniORBextractor = new ORBextractor(2*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpIniORBextractor = new ORBextractor(2*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST,nExtractorThreads);
 
     cout << endl  << "ORB Extractor Parameters: " << endl;
     cout << "- Number of Features: " << nFeatures << endl;
@@ -193,6 +199,8 @@ Tracking::Tracking(
     cout << "- Scale Factor: " << fScaleFactor << endl;
     cout << "- Initial Fast Threshold: " << fIniThFAST << endl;
     cout << "- Minimum Fast Threshold: " << fMinThFAST << endl;
+    if(nExtractorThreads>1)
+        cout << "- Extraction Threads: " << nExtractorThreads << endl;
 
     if(sensor==System::STEREO || sensor==System::RGBD)
     {
@@ -232,6 +240,22 @@ void Tracking::SetViewer(Viewer *pViewer)
     mpViewer=pViewer;
 }
 
+//设置线程池
+void Tracking::SetThreadPool(ThreadPool *pThreadPool)
+{
+    mpThreadPool=pThreadPool;
+
+    // 需要并行提取特征点时，特征点提取器也改用这个共享的线程池，从而限制整个进程的并行线程数
+    if(mbParallelExtraction)
+    {
+        mpORBextractorLeft->SetThreadPool(pThreadPool);
+        if(mSensor==System::STEREO)
+            mpORBextractorRight->SetThreadPool(pThreadPool);
+        if(mSensor==System::MONOCULAR)
+            mpIniORBextractor->SetThreadPool(pThreadPool);
+    }
+}
+
 
 
 // 输入左右目图像，可以为RGB、BGR、RGBA、GRAY
@@ -243,41 +267,62 @@ cv::Mat Tracking::GrabImageStereo(
     const cv::Mat &imRectRight,     //右侧图像
     const double &timestamp)        //时间戳
 {
-    mImGray = imRectLeft;
+    // Step 1 ：转换为灰度图像并构造Frame
+    mCurrentFrame = CreateFrameStereo(imRectLeft,imRectRight,timestamp,mImGray);
+
+    // Step 2 ：跟踪
+    Track();
+
+    //返回位姿
+    return mCurrentFrame.mTcw.clone();
+}
+
+/**
+ * @brief 将双目图像转为灰度图像并构造Frame，不进行跟踪
+ * 
+ * @param[in] imRectLeft    左目图像
+ * @param[in] imRectRight   右目图像
+ * @param[in] timestamp     时间戳
+ * @param[out] imGray       左目灰度图像
+ * @return Frame            构造好的双目帧
+ */
+Frame Tracking::CreateFrameStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, cv::Mat &imGray)
+{
+    imGray = imRectLeft;
     cv::Mat imGrayRight = imRectRight;
 
     // step 1 ：将RGB或RGBA图像转为灰度图像
-    if(mImGray.channels()==3)
+    if(imGray.channels()==3)
     {
         if(mbRGB)
         {
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
+            cvtColor(imGray,imGray,CV_RGB2GRAY);
             cvtColor(imGrayRight,imGrayRight,CV_RGB2GRAY);
         }
         else
         {
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
+            cvtColor(imGray,imGray,CV_BGR2GRAY);
             cvtColor(imGrayRight,imGrayRight,CV_BGR2GRAY);
         }
     }
     // 这里考虑得十分周全,甚至连四通道的图像都考虑到了
-    else if(mImGray.channels()==4)
+    else if(imGray.channels()==4)
     {
         if(mbRGB)
         {
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
+            cvtColor(imGray,imGray,CV_RGBA2GRAY);
             cvtColor(imGrayRight,imGrayRight,CV_RGBA2GRAY);
         }
         else
         {
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+            cvtColor(imGray,imGray,CV_BGRA2GRAY);
             cvtColor(imGrayRight,imGrayRight,CV_BGRA2GRAY);
         }
     }
 
     // Step 2 ：构造Frame
-    mCurrentFrame = Frame(
-        mImGray,                //左目图像
+    return Frame(
+        imGray,                 //左目图像
         imGrayRight,            //右目图像
         timestamp,              //时间戳
         mpORBextractorLeft,     //左目特征提取器
@@ -286,13 +331,8 @@ cv::Mat Tracking::GrabImageStereo(
         mK,                     //内参矩阵
         mDistCoef,              //去畸变参数
         mbf,                    //基线长度
-        mThDepth);              //远点,近点的区分阈值
-
-    // Step 3 ：跟踪
-    Track();
-
-    //返回位姿
-    return mCurrentFrame.mTcw.clone();
+        mThDepth,               //远点,近点的区分阈值
+        mpThreadPool);          //线程池,用来同时提取左右目图像的特征点
 }
 
 
@@ -305,23 +345,44 @@ cv::Mat Tracking::GrabImageRGBD(
     const cv::Mat &imD,             //深度图像
     const double &timestamp)        //时间戳
 {
-    mImGray = imRGB;
+    // 步骤1：转换为灰度图像、深度图转换为真实尺度并构造Frame
+    mCurrentFrame = CreateFrameRGBD(imRGB,imD,timestamp,mImGray);
+
+    // 步骤2：跟踪
+    Track();
+
+    //返回当前帧的位姿
+    return mCurrentFrame.mTcw.clone();
+}
+
+/**
+ * @brief 将RGBD图像转为灰度图像、将深度图转为真实尺度并构造Frame，不进行跟踪
+ * 
+ * @param[in] imRGB         彩色图像
+ * @param[in] imD           深度图像
+ * @param[in] timestamp     时间戳
+ * @param[out] imGray       灰度图像
+ * @return Frame            构造好的RGBD帧
+ */
+Frame Tracking::CreateFrameRGBD(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp, cv::Mat &imGray)
+{
+    imGray = imRGB;
     cv::Mat imDepth = imD;
 
     // step 1：将RGB或RGBA图像转为灰度图像
-    if(mImGray.channels()==3)
+    if(imGray.channels()==3)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
+            cvtColor(imGray,imGray,CV_RGB2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
+            cvtColor(imGray,imGray,CV_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(imGray.channels()==4)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
+            cvtColor(imGray,imGray,CV_RGBA2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+            cvtColor(imGray,imGray,CV_BGRA2GRAY);
     }
 
     // step 2 ：将深度相机的disparity转为Depth , 也就是转换成为真正尺度下的深度
@@ -337,8 +398,8 @@ cv::Mat Tracking::GrabImageRGBD(
             mDepthMapFactor);   //缩放系数
 
     // 步骤3：构造Frame
-    mCurrentFrame = Frame(
-        mImGray,                //灰度图像
+    return Frame(
+        imGray,                 //灰度图像
         imDepth,                //深度图像
         timestamp,              //时间戳
         mpORBextractorLeft,     //ORB特征提取器
@@ -347,12 +408,6 @@ cv::Mat Tracking::GrabImageRGBD(
         mDistCoef,              //相机的去畸变参数
         mbf,                    //相机基线*相机焦距
         mThDepth);              //内外点区分深度阈值
-
-    // 步骤4：跟踪
-    Track();
-
-    //返回当前帧的位姿
-    return mCurrentFrame.mTcw.clone();
 }
 
 /**
@@ -363,36 +418,60 @@ cv::Mat Tracking::GrabImageRGBD(
  * @param[in] timestamp 时间戳
  * @return cv::Mat 
  * 
- * Step 1 ：将彩色图像转为灰度图像
- * Step 2 ：构造Frame
- * Step 3 ：跟踪
+ * Step 1 ：将彩色图像转为灰度图像，构造Frame
+ * Step 2 ：跟踪
  */
 cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im,const double &timestamp)
 {
-    mImGray = im;
+    // Step 1 ：构造Frame，其中最重要的就是建立图像金字塔，提取FAST角点，并且计算对应的ORB描述子
+    //判断该帧是不是初始化，没有成功初始化的前一个状态就是NO_IMAGES_YET
+    mCurrentFrame = CreateFrameMonocular(
+        im,
+        timestamp,
+        mState==NOT_INITIALIZED || mState==NO_IMAGES_YET,
+        mImGray);
+
+    // Step 2 ：跟踪
+    Track();
+
+    //返回当前帧的位姿
+    return mCurrentFrame.mTcw.clone();      // 注意这里为什么要返回一个clone?
+}
+
+/**
+ * @brief 将单目图像转为灰度图像并构造Frame，不进行跟踪
+ * 
+ * @param[in] im            单目图像
+ * @param[in] timestamp     时间戳
+ * @param[in] bInitializing 是否处于初始化阶段，初始化阶段使用提取2倍特征点的初始化提取器
+ * @param[out] imGray       灰度图像
+ * @return Frame            构造好的单目帧
+ */
+Frame Tracking::CreateFrameMonocular(const cv::Mat &im, const double &timestamp, const bool bInitializing, cv::Mat &imGray)
+{
+    imGray = im;
 
     // Step 1 ：将彩色图像转为灰度图像
     //若图片是3、4通道的，还需要转化成灰度图
-    if(mImGray.channels()==3)
+    if(imGray.channels()==3)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
+            cvtColor(imGray,imGray,CV_RGB2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
+            cvtColor(imGray,imGray,CV_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(imGray.channels()==4)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
+            cvtColor(imGray,imGray,CV_RGBA2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+            cvtColor(imGray,imGray,CV_BGRA2GRAY);
     }
 
-    // Step 2 ：构造Frame，其中最重要的就是建立图像金字塔，提取FAST角点，并且计算对应的ORB描述子
-    //判断该帧是不是初始化
-    if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET) //没有成功初始化的前一个状态就是NO_IMAGES_YET
-        mCurrentFrame = Frame(   
-            mImGray,
+    // Step 2 ：构造Frame
+    if(bInitializing)
+        return Frame(
+            imGray,
             timestamp,
             mpIniORBextractor,      //初始化ORB特征点提取器会提取2倍的指定特征点数目
             mpORBVocabulary,
@@ -401,8 +480,8 @@ cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im,const double &timestamp)
             mbf,
             mThDepth);
     else
-        mCurrentFrame = Frame(
-            mImGray,
+        return Frame(
+            imGray,
             timestamp,
             mpORBextractorLeft,     //正常运行的时的ORB特征点提取器，提取指定数目特征点
             mpORBVocabulary,
@@ -410,12 +489,24 @@ cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im,const double &timestamp)
             mDistCoef,
             mbf,
             mThDepth);
+}
+
+/**
+ * @brief 跟踪一个已经构造好的帧，用于System的流水线跟踪接口
+ * @details Frame的构造(特征提取、双目匹配)可以在其他线程中提前完成，这里只执行Track()
+ * 
+ * @param[in] frame     已经构造好的帧
+ * @param[in] imGray    该帧的灰度图像，用于帧绘制器显示
+ * @return cv::Mat      世界坐标系到该帧相机坐标系的变换矩阵
+ */
+cv::Mat Tracking::TrackFrame(const Frame &frame, const cv::Mat &imGray)
+{
+    mImGray = imGray;
+    mCurrentFrame = frame;
 
-    // Step 3 ：跟踪
     Track();
 
-    //返回当前帧的位姿
-    return mCurrentFrame.mTcw.clone();      // 注意这里为什么要返回一个clone?
+    return mCurrentFrame.mTcw.clone();
 }
 
 
@@ -792,10 +883,10 @@ void Tracking::Track()
         mlFrameTimes.push_back(mCurrentFrame.mTimeStamp);
         mlbLost.push_back(mState==LOST);
     }
-    else
+    else if(!mlRelativeFramePoses.empty())
     {
         // This can happen if tracking is lost
-        // 如果跟踪失败，则相对位姿使用上一次值
+        // 如果跟踪失败，则相对位姿使用上一次值。加载地图后还没有重定位成功时没有上一次的值,不记录
         mlRelativeFramePoses.push_back(mlRelativeFramePoses.back());
         mlpReferences.push_back(mlpReferences.back());
         mlFrameTimes.push_back(mlFrameTimes.back());
@@ -935,7 +1026,7 @@ void Tracking::MonocularInitialization()
                 delete mpInitializer;
 
             // 由当前帧构造初始器 sigma:1.0 iterations:200
-            mpInitializer =  new Initializer(mCurrentFrame,1.0,200);
+            mpInitializer =  new Initializer(mCurrentFrame,1.0,200,mpThreadPool);
 
             // 初始化为-1 表示没有任何匹配。这里面存储的是匹配的点的id
             fill(mvIniMatches.begin(),mvIniMatches.end(),-1);
@@ -1115,7 +1206,7 @@ void Tracking::CreateInitialMapMonocular()
     // Step 4 全局BA优化，同时优化所有位姿和三维点
     //; 注意看传入的变量，是地图，也就是说优化的时候直接优化地图就可以，因为地图中就包括关键帧和地图点，这就包括了BA优化中的所有变量
     //; 进行GBA的时候固定第0帧的位姿，优化其他位姿
-    Optimizer::GlobalBundleAdjustemnt(mpMap,20);
+    Optimizer::GlobalBundleAdjustemnt(mpMap,20,NULL,0,true,mpThreadPool);
 
     // Set median depth to 1
     // Step 5 取场景的中值深度，用于尺度归一化 
@@ -1989,6 +2080,8 @@ void Tracking::UpdateLocalKeyFrames()
     // Each map point vote for the keyframes in which it has been observed
     // Step 1：遍历当前帧的地图点，记录所有能观测到当前帧地图点的关键帧
     map<KeyFrame*,int> keyframeCounter;
+    // 在循环外定义,复用内存
+    ObservationMap observations;
     for(int i=0; i<mCurrentFrame.N; i++)
     {
         if(mCurrentFrame.mvpMapPoints[i])
@@ -1997,9 +2090,9 @@ void Tracking::UpdateLocalKeyFrames()
             if(!pMP->isBad())
             {
                 // 得到观测到该地图点的关键帧和该地图点在关键帧中的索引
-                const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+                pMP->GetObservations(observations);
                 // 由于一个地图点可以被多个关键帧观测到,因此对于每一次观测,都对观测到这个地图点的关键帧进行累计投票
-                for(map<KeyFrame*,size_t>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
+                for(ObservationMap::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
                     // 这里的操作非常精彩！
                     // map[key] = value，当要插入的键存在时，会覆盖键对应的原来的值。如果键不存在，则添加一组键值对
                     // it->first 是地图点看到的关键帧，同一个关键帧看到的地图点会累加到该关键帧计数
@@ -2123,6 +2216,8 @@ void Tracking::UpdateLocalKeyFrames()
     {
         mpReferenceKF = pKFmax;
         mCurrentFrame.mpReferenceKF = mpReferenceKF;
+        // 参考关键帧可能是从地图文件加载的,下一帧跟踪参考关键帧时要用到它的特征点
+        mpReferenceKF->LoadFeatures();
     }
 }
 
@@ -2157,195 +2252,192 @@ bool Tracking::Relocalization()
 
     // We perform first an ORB matching with each candidate
     // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
     //每个关键帧的解算器
-    vector<PnPsolver*> vpPnPsolvers;
-    vpPnPsolvers.resize(nKFs);
+    vector<PnPsolver*> vpPnPsolvers(nKFs, static_cast<PnPsolver*>(NULL));
 
     //每个关键帧和当前帧中特征点的匹配关系
     vector<vector<MapPoint*> > vvpMapPointMatches;
     vvpMapPointMatches.resize(nKFs);
     
-    //放弃某个关键帧的标记
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
-
-    //有效的候选关键帧数目
-    int nCandidates=0;
+    //放弃某个关键帧的标记,会在多个线程中同时写入不同的元素,所以不用 vector<bool>
+    vector<char> vbDiscarded(nKFs, 0);
 
     // Step 3：遍历所有的候选关键帧，通过词袋进行快速匹配，用匹配结果初始化PnP Solver
-    for(int i=0; i<nKFs; i++)
+    // 每个候选关键帧只写入自己的匹配结果和解算器，有线程池时并行处理
+    auto setupCandidate = [&](int i)
     {
         KeyFrame* pKF = vpCandidateKFs[i];
         if(pKF->isBad())
-            vbDiscarded[i] = true;
-        else
         {
-            // 当前帧和候选关键帧用BoW进行快速匹配，匹配结果记录在vvpMapPointMatches，nmatches表示匹配的数目
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            // 如果和当前帧的匹配数小于15,那么只能放弃这个关键帧
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
-                continue;
-            }
-            else
-            {
-                // 如果匹配数目够用，用匹配结果初始化EPnPsolver
-                // 为什么用EPnP? 因为计算复杂度低，精度高
-                PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(
-                    0.99,   //用于计算RANSAC迭代次数理论值的概率
-                    10,     //最小内点数, 但是要注意在程序中实际上是min(给定最小内点数,最小集,内点数理论值),不一定使用这个
-                    300,    //最大迭代次数
-                    4,      //最小集(求解这个问题在一次采样中所需要采样的最少的点的个数,对于Sim3是3,EPnP是4),参与到最小内点数的确定过程中
-                    0.5,    //这个是表示(最小内点数/样本总数);实际上的RANSAC正常退出的时候所需要的最小内点数其实是根据这个量来计算得到的
-                    5.991); // 自由度为2的卡方检验的阈值,程序中还会根据特征点所在的图层对这个阈值进行缩放
-                vpPnPsolvers[i] = pSolver;   // 对每个关键帧，都得到了一个Pnpsolver，把这个加入到数组中
-                nCandidates++;
-            }
+            vbDiscarded[i] = 1;
+            return;
         }
-    }
+
+        // 当前帧和候选关键帧用BoW进行快速匹配，匹配结果记录在vvpMapPointMatches，nmatches表示匹配的数目
+        // 同时记下每个匹配的描述子距离,给PnP的PROSAC采样排序用
+        ORBmatcher matcher(0.75,true);
+        vector<int> vMatchDistances;
+        int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i],&vMatchDistances);
+        // 如果和当前帧的匹配数小于15,那么只能放弃这个关键帧
+        if(nmatches<15)
+        {
+            vbDiscarded[i] = 1;
+            return;
+        }
+
+        // 如果匹配数目够用，用匹配结果初始化EPnPsolver
+        // 为什么用EPnP? 因为计算复杂度低，精度高
+        PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
+        pSolver->SetRansacParameters(
+            0.99,   //用于计算RANSAC迭代次数理论值的概率
+            10,     //最小内点数, 但是要注意在程序中实际上是min(给定最小内点数,最小集,内点数理论值),不一定使用这个
+            300,    //最大迭代次数
+            4,      //最小集(求解这个问题在一次采样中所需要采样的最少的点的个数,对于Sim3是3,EPnP是4),参与到最小内点数的确定过程中
+            0.5,    //这个是表示(最小内点数/样本总数);实际上的RANSAC正常退出的时候所需要的最小内点数其实是根据这个量来计算得到的
+            5.991); // 自由度为2的卡方检验的阈值,程序中还会根据特征点所在的图层对这个阈值进行缩放
+        // 描述子距离小的匹配优先采样,坏模型用SPRT提前放弃
+        pSolver->SetGuidedSampling(vMatchDistances);
+        vpPnPsolvers[i] = pSolver;   // 对每个关键帧，都得到了一个Pnpsolver，把这个加入到数组中
+    };
+
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nKFs, setupCandidate);
+    else
+        for(int i=0; i<nKFs; i++)
+            setupCandidate(i);
+
+    //有效的候选关键帧数目
+    int nCandidates=0;
+    for(int i=0; i<nKFs; i++)
+        if(!vbDiscarded[i])
+            nCandidates++;
 
     // Alternatively perform some iterations of P4P RANSAC
     // Until we found a camera pose supported by enough inliers
     // 这里的 P4P RANSAC是Epnp，每次迭代需要4个点
     // 是否已经找到相匹配的关键帧的标志
     bool bMatch = false;
-    ORBmatcher matcher2(0.9,true);
 
     // Step 4: 通过一系列操作,直到找到能够匹配上的关键帧
     // 为什么搞这么复杂？答：是担心误闭环
-    while(nCandidates>0 && !bMatch)
+    if(mpThreadPool && nCandidates>1)
     {
-        //遍历当前所有的候选关键帧
-        for(int i=0; i<nKFs; i++)
+        // 有线程池时每个候选关键帧在各自的线程中一直迭代RANSAC,直到成功或者没有迭代次数;
+        // 每个候选关键帧在当前帧的拷贝上优化,有一个成功后其他候选关键帧在下一轮迭代前停止
+        std::atomic<bool> bFound(false);
+        std::mutex mutexFound;
+        int nFoundIdx = -1;
+        // 成功的结果先保存在这里,所有线程结束后再写回当前帧,因为其他线程可能还在拷贝当前帧
+        cv::Mat TcwFound;
+        vector<MapPoint*> vpMapPointsFound;
+        vector<bool> vbOutlierFound;
+
+        auto solveCandidate = [&](int i)
         {
-            // 忽略放弃的
             if(vbDiscarded[i])
-                continue;
-    
-            //内点标记
-            vector<bool> vbInliers;     
-            
-            //内点数
-            int nInliers;
-            
-            // 表示RANSAC已经没有更多的迭代次数可用 -- 也就是说数据不够好，RANSAC也已经尽力了。。。
-            bool bNoMore;
-
-            // Step 4.1：通过EPnP算法估计姿态，迭代5次
+                return;
+
+            Frame F(mCurrentFrame);
             PnPsolver* pSolver = vpPnPsolvers[i];
-            cv::Mat Tcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
 
-            // If Ransac reachs max. iterations discard keyframe
-            // bNoMore 为true 表示已经超过了RANSAC最大迭代次数，就放弃当前关键帧
-            if(bNoMore)
+            while(!bFound.load())
             {
-                vbDiscarded[i]=true;
-                nCandidates--;
-            }
+                vector<bool> vbInliers;
+                int nInliers;
+                bool bNoMore;
 
-            // If a Camera Pose is computed, optimize
-            if(!Tcw.empty())
-            {
-                //  Step 4.2：如果EPnP 计算出了位姿，对内点进行BA优化
-                Tcw.copyTo(mCurrentFrame.mTcw);
-                
-                // EPnP 里RANSAC后的内点的集合
-                set<MapPoint*> sFound;
+                // Step 4.1：通过EPnP算法估计姿态，迭代5次
+                cv::Mat Tcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
 
-                const int np = vbInliers.size();
-                //遍历所有内点
-                for(int j=0; j<np; j++)
+                // If a Camera Pose is computed, optimize
+                // Step 4.2 ~ 4.4：如果EPnP 计算出了位姿，优化位姿并补充匹配点
+                if(!Tcw.empty() &&
+                   RefineRelocalization(F,vpCandidateKFs[i],Tcw,vbInliers,vvpMapPointMatches[i])>=50)
                 {
-                    if(vbInliers[j])
+                    // 只保留最先成功的候选关键帧的结果
+                    unique_lock<mutex> lock(mutexFound);
+                    if(nFoundIdx<0)
                     {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
+                        nFoundIdx = i;
+                        TcwFound = F.mTcw.clone();
+                        vpMapPointsFound.swap(F.mvpMapPoints);
+                        vbOutlierFound.swap(F.mvbOutlier);
+                        bFound = true;
                     }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
+                    return;
                 }
 
-                // 只优化位姿,不优化地图点的坐标，返回的是内点的数量
-                //; 注意这里优化之后会把当前帧的位姿直接更新
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                // If Ransac reachs max. iterations discard keyframe
+                // bNoMore 为true 表示已经超过了RANSAC最大迭代次数，就放弃当前关键帧
+                if(bNoMore)
+                    return;
+            }
+        };
 
-                // 如果优化之后的内点数目不多，跳过了当前候选关键帧,继续使用下一个候选关键帧进行重定位
-                if(nGood<10)
+        mpThreadPool->ParallelFor(nKFs, solveCandidate);
+
+        if(nFoundIdx>=0)
+        {
+            mCurrentFrame.SetPose(TcwFound);
+            mCurrentFrame.mvpMapPoints.swap(vpMapPointsFound);
+            mCurrentFrame.mvbOutlier.swap(vbOutlierFound);
+            bMatch = true;
+        }
+    }
+    else
+    {
+        while(nCandidates>0 && !bMatch)
+        {
+            //遍历当前所有的候选关键帧
+            for(int i=0; i<nKFs; i++)
+            {
+                // 忽略放弃的
+                if(vbDiscarded[i])
                     continue;
+        
+                //内点标记
+                vector<bool> vbInliers;     
+                
+                //内点数
+                int nInliers;
+                
+                // 表示RANSAC已经没有更多的迭代次数可用 -- 也就是说数据不够好，RANSAC也已经尽力了。。。
+                bool bNoMore;
 
-                // 删除外点对应的地图点
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+                // Step 4.1：通过EPnP算法估计姿态，迭代5次
+                PnPsolver* pSolver = vpPnPsolvers[i];
+                cv::Mat Tcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                // Step 4.3：如果内点较少，则通过投影的方式对之前未匹配的点进行匹配，再进行优化求解
-                // 前面的匹配关系是用词袋匹配过程得到的
-                if(nGood<50)
+                // If Ransac reachs max. iterations discard keyframe
+                // bNoMore 为true 表示已经超过了RANSAC最大迭代次数，就放弃当前关键帧
+                if(bNoMore)
                 {
-                    // 通过投影的方式将关键帧中未匹配的地图点投影到当前帧中, 生成新的匹配
-                    int nadditional = matcher2.SearchByProjection(
-                        mCurrentFrame,          //当前帧
-                        vpCandidateKFs[i],      //关键帧
-                        sFound,                 //已经找到的地图点集合，不会用于这次的投影匹配
-                        10,                     //窗口阈值，会乘以金字塔尺度
-                        100);                   //匹配的ORB描述子距离应该小于这个阈值
-
-                    // 如果通过投影过程新增了比较多的匹配特征点对
-                    if(nadditional+nGood>=50)
-                    {
-                        // 根据投影匹配的结果，再次采用3D-2D pnp BA优化位姿
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
-
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        // Step 4.4：如果BA后内点数还是比较少(<50)但是还不至于太少(>30)，可以挽救一下, 最后垂死挣扎 
-                        // 重新执行上一步 4.3的过程，只不过使用更小的搜索窗口
-                        // 这里的位姿已经使用了更多的点进行了优化,应该更准，所以使用更小的窗口搜索
-                        if(nGood>30 && nGood<50)
-                        {
-                            // 用更小窗口、更严格的描述子阈值，重新进行投影搜索匹配
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(
-                                mCurrentFrame,          //当前帧
-                                vpCandidateKFs[i],      //候选的关键帧
-                                sFound,                 //已经找到的地图点，不会用于PNP
-                                3,                      //新的窗口阈值，会乘以金字塔尺度
-                                64);                    //匹配的ORB描述子距离应该小于这个阈值
-
-                            // Final optimization
-                            // 如果成功挽救回来，匹配数目达到要求，最后BA优化一下
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
-                                //更新地图点
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
-                            //如果还是不能够满足就放弃了
-                        }
-                    }
+                    vbDiscarded[i]=1;
+                    nCandidates--;
                 }
 
-                // If the pose is supported by enough inliers stop ransacs and continue
-                // 如果对于当前的候选关键帧已经有足够的内点(50个)了,那么就认为重定位成功
-                if(nGood>=50)
+                // If a Camera Pose is computed, optimize
+                if(!Tcw.empty())
                 {
-                    bMatch = true;
-                    // 只要有一个候选关键帧重定位成功，就退出循环，不考虑其他候选关键帧了
-                    break;
+                    // Step 4.2 ~ 4.4：如果EPnP 计算出了位姿，优化位姿并补充匹配点
+                    int nGood = RefineRelocalization(mCurrentFrame,vpCandidateKFs[i],Tcw,vbInliers,vvpMapPointMatches[i]);
+
+                    // If the pose is supported by enough inliers stop ransacs and continue
+                    // 如果对于当前的候选关键帧已经有足够的内点(50个)了,那么就认为重定位成功
+                    if(nGood>=50)
+                    {
+                        bMatch = true;
+                        // 只要有一个候选关键帧重定位成功，就退出循环，不考虑其他候选关键帧了
+                        break;
+                    }
                 }
-            }
-        }//一直运行,知道已经没有足够的关键帧,或者是已经有成功匹配上的关键帧
+            }//一直运行,知道已经没有足够的关键帧,或者是已经有成功匹配上的关键帧
+        }
     }
 
+    for(int i=0; i<nKFs; i++)
+        delete vpPnPsolvers[i];
+
     // 折腾了这么久还是没有匹配上，重定位失败
     if(!bMatch)
     {
@@ -2360,6 +2452,102 @@ bool Tracking::Relocalization()
     }
 }
 
+/*
+ * @brief 用一个候选关键帧的EPnP结果优化帧的位姿,内点不够时再用投影匹配补充匹配点
+ */
+int Tracking::RefineRelocalization(Frame &F, KeyFrame* pKF, const cv::Mat &Tcw, const vector<bool> &vbInliers,
+                                   const vector<MapPoint*> &vpMapPointMatches)
+{
+    //  Step 4.2：如果EPnP 计算出了位姿，对内点进行BA优化
+    F.SetPose(Tcw);
+
+    // EPnP 里RANSAC后的内点的集合
+    set<MapPoint*> sFound;
+
+    const int np = vbInliers.size();
+    //遍历所有内点
+    for(int j=0; j<np; j++)
+    {
+        if(vbInliers[j])
+        {
+            F.mvpMapPoints[j]=vpMapPointMatches[j];
+            sFound.insert(vpMapPointMatches[j]);
+        }
+        else
+            F.mvpMapPoints[j]=NULL;
+    }
+
+    // 只优化位姿,不优化地图点的坐标，返回的是内点的数量
+    //; 注意这里优化之后会把帧的位姿直接更新
+    int nGood = Optimizer::PoseOptimization(&F);
+
+    // 如果优化之后的内点数目不多，跳过了当前候选关键帧,继续使用下一个候选关键帧进行重定位
+    if(nGood<10)
+        return nGood;
+
+    // 删除外点对应的地图点
+    for(int io =0; io<F.N; io++)
+        if(F.mvbOutlier[io])
+            F.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+
+    // If few inliers, search by projection in a coarse window and optimize again
+    // Step 4.3：如果内点较少，则通过投影的方式对之前未匹配的点进行匹配，再进行优化求解
+    // 前面的匹配关系是用词袋匹配过程得到的
+    if(nGood<50)
+    {
+        ORBmatcher matcher2(0.9,true);
+
+        // 通过投影的方式将关键帧中未匹配的地图点投影到当前帧中, 生成新的匹配
+        int nadditional = matcher2.SearchByProjection(
+            F,                      //当前帧
+            pKF,                    //关键帧
+            sFound,                 //已经找到的地图点集合，不会用于这次的投影匹配
+            10,                     //窗口阈值，会乘以金字塔尺度
+            100);                   //匹配的ORB描述子距离应该小于这个阈值
+
+        // 如果通过投影过程新增了比较多的匹配特征点对
+        if(nadditional+nGood>=50)
+        {
+            // 根据投影匹配的结果，再次采用3D-2D pnp BA优化位姿
+            nGood = Optimizer::PoseOptimization(&F);
+
+            // If many inliers but still not enough, search by projection again in a narrower window
+            // the camera has been already optimized with many points
+            // Step 4.4：如果BA后内点数还是比较少(<50)但是还不至于太少(>30)，可以挽救一下, 最后垂死挣扎 
+            // 重新执行上一步 4.3的过程，只不过使用更小的搜索窗口
+            // 这里的位姿已经使用了更多的点进行了优化,应该更准，所以使用更小的窗口搜索
+            if(nGood>30 && nGood<50)
+            {
+                // 用更小窗口、更严格的描述子阈值，重新进行投影搜索匹配
+                sFound.clear();
+                for(int ip =0; ip<F.N; ip++)
+                    if(F.mvpMapPoints[ip])
+                        sFound.insert(F.mvpMapPoints[ip]);
+                nadditional =matcher2.SearchByProjection(
+                    F,                      //当前帧
+                    pKF,                    //候选的关键帧
+                    sFound,                 //已经找到的地图点，不会用于PNP
+                    3,                      //新的窗口阈值，会乘以金字塔尺度
+                    64);                    //匹配的ORB描述子距离应该小于这个阈值
+
+                // Final optimization
+                // 如果成功挽救回来，匹配数目达到要求，最后BA优化一下
+                if(nGood+nadditional>=50)
+                {
+                    nGood = Optimizer::PoseOptimization(&F);
+                    //更新地图点
+                    for(int io =0; io<F.N; io++)
+                        if(F.mvbOutlier[io])
+                            F.mvpMapPoints[io]=NULL;
+                }
+                //如果还是不能够满足就放弃了
+            }
+        }
+    }
+
+    return nGood;
+}
+
 //整个追踪线程执行复位操作
 void Tracking::Reset()
 {
@@ -2368,8 +2556,7 @@ void Tracking::Reset()
     if(mpViewer)
     {
         mpViewer->RequestStop();
-        while(!mpViewer->isStopped())
-            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        mpViewer->WaitUntilStopped();
     }
     cout << "System Reseting" << endl;
 
@@ -234,13 +234,10 @@ void Viewer::Run()
         //如果有停止更新的请求
         if(Stop())
         {
-            //就不再绘图了,并且在这里每隔三秒检查一下是否结束
+            //就不再绘图了,阻塞在这里直到 Release() 把我们唤醒
+            unique_lock<mutex> lock(mMutexWakeUp);
             while(isStopped())
-            {
-				//usleep(3000);
-				std::this_thread::sleep_for(std::chrono::milliseconds(3));
-
-            }
+                mCondWakeUp.wait(lock);
         }
 
         //满足的时候退出这个线程循环,这里应该是查看终止请求
@@ -269,8 +266,11 @@ bool Viewer::CheckFinish()
 //设置变量:当前进程已经结束
 void Viewer::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    WakeUp();
 }
 
 //判断当前进程是否已经结束
@@ -298,27 +298,54 @@ bool Viewer::isStopped()
 //当前查看器停止更新
 bool Viewer::Stop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    unique_lock<mutex> lock2(mMutexFinish);
-
-    if(mbFinishRequested)
-        return false;
-    else if(mbStopRequested)
     {
+        unique_lock<mutex> lock(mMutexStop);
+        unique_lock<mutex> lock2(mMutexFinish);
+
+        if(mbFinishRequested || !mbStopRequested)
+            return false;
+
         mbStopped = true;
         mbStopRequested = false;
-        return true;
     }
-
-    return false;
-
+    // 通知在 WaitUntilStopped() 中等待的线程
+    WakeUp();
+    return true;
 }
 
 //释放查看器进程,因为如果停止查看器的话,查看器进程会处于死循环状态.这个就是为了释放那个标志
 void Viewer::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopped = false;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopped = false;
+    }
+    WakeUp();
+}
+
+//阻塞等待查看器暂停更新
+void Viewer::WaitUntilStopped()
+{
+    unique_lock<mutex> lock(mMutexWakeUp);
+    while(!isStopped())
+        mCondWakeUp.wait(lock);
+}
+
+//阻塞等待查看器进程结束
+void Viewer::WaitUntilFinished()
+{
+    unique_lock<mutex> lock(mMutexWakeUp);
+    while(!isFinished())
+        mCondWakeUp.wait(lock);
+}
+
+//先获取再释放 mMutexWakeUp,保证等待的线程不会错过这次通知
+void Viewer::WakeUp()
+{
+    {
+        unique_lock<mutex> lock(mMutexWakeUp);
+    }
+    mCondWakeUp.notify_all();
 }
 
 }
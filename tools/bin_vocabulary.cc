@@ -0,0 +1,77 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include<iostream>
+#include<chrono>
+#include<cstdio>
+
+#include"ORBVocabulary.h"
+
+using namespace std;
+
+// 将文本格式的ORB字典转换为二进制格式，二进制字典可以被System直接内存映射，启动时不需要再解析文本
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        cerr << endl << "Usage: ./bin_vocabulary path_to_text_vocabulary path_to_binary_vocabulary" << endl;
+        return 1;
+    }
+
+    const string strTextFile = argv[1];
+    const string strBinFile = argv[2];
+
+    ORB_SLAM2::ORBVocabulary voc;
+
+    cout << "Loading text vocabulary " << strTextFile << " ..." << endl;
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    if(!voc.loadFromTextFile(strTextFile))
+    {
+        cerr << "Failed to open at: " << strTextFile << endl;
+        return 1;
+    }
+    chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+    cout << "Loaded " << voc.size() << " words in "
+         << chrono::duration_cast<chrono::duration<double> >(t2 - t1).count() << " s" << endl;
+
+    // 先写到临时文件再重命名，正在映射旧文件的进程不会读到写了一半的数据
+    const string strTmpFile = strBinFile + ".tmp";
+    if(!voc.saveToBinaryFile(strTmpFile) || rename(strTmpFile.c_str(), strBinFile.c_str()) != 0)
+    {
+        cerr << "Failed to write binary vocabulary at: " << strBinFile << endl;
+        remove(strTmpFile.c_str());
+        return 1;
+    }
+
+    // 重新加载一次，检查写出的文件是否正确
+    ORB_SLAM2::ORBVocabulary vocBin;
+    t1 = chrono::steady_clock::now();
+    if(!vocBin.loadFromBinaryFile(strBinFile) || vocBin.size() != voc.size())
+    {
+        cerr << "Binary vocabulary check failed: " << strBinFile << endl;
+        return 1;
+    }
+    t2 = chrono::steady_clock::now();
+    cout << "Saved " << strBinFile << " (loads in "
+         << chrono::duration_cast<chrono::duration<double> >(t2 - t1).count() << " s)" << endl;
+
+    return 0;
+}